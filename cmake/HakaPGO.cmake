@@ -0,0 +1,123 @@
+# HakaPGO.cmake - drives the profile-guided + link-time optimized build.
+#
+# Run through the haka_pgo target (see CMakeLists.txt), which passes:
+#   HAKA_SOURCE_DIR      project source tree
+#   HAKA_WORK_DIR        scratch directory for the sub-builds and report
+#   HAKA_DEPS_DIR        FetchContent directory of the parent build (reused, no re-download)
+#   HAKA_GENERATOR       CMake generator of the parent build
+#   HAKA_CXX_COMPILER    compiler of the parent build
+#   HAKA_CXX_COMPILER_ID "GNU" or "Clang"
+#   HAKA_PGO_DURATION    seconds of load for training and for each benchmark
+#
+# Steps:
+#   1. Release build (baseline, also provides haka_load)
+#   2. Instrumented build, trained with haka_load
+#   3. Profiles merged (Clang only; GCC reads its .gcda files directly)
+#   4. Same build tree reconfigured with the profile + LTO and rebuilt
+#   5. Baseline and optimized binaries benchmarked with the same workload
+
+cmake_minimum_required(VERSION 3.15)
+
+set(release_dir  "${HAKA_WORK_DIR}/release")
+set(pgo_dir      "${HAKA_WORK_DIR}/build")      # Instrumented and optimized builds share object paths
+set(profile_dir  "${HAKA_WORK_DIR}/profiles")
+set(results_file "${HAKA_WORK_DIR}/results.txt")
+set(report_file  "${HAKA_WORK_DIR}/report.txt")
+set(load_tool    "${release_dir}/haka_load")
+
+function(haka_pgo_run)
+  execute_process(COMMAND ${ARGN} RESULT_VARIABLE rc)
+  if(NOT rc EQUAL 0)
+    string(REPLACE ";" " " cmd "${ARGN}")
+    message(FATAL_ERROR "HakaPGO: command failed (${rc}): ${cmd}")
+  endif()
+endfunction()
+
+function(haka_pgo_configure build_dir)
+  haka_pgo_run(${CMAKE_COMMAND} -S ${HAKA_SOURCE_DIR} -B ${build_dir}
+    -G ${HAKA_GENERATOR}
+    -DCMAKE_BUILD_TYPE=Release
+    -DCMAKE_CXX_COMPILER=${HAKA_CXX_COMPILER}
+    -DFETCHCONTENT_BASE_DIR=${HAKA_DEPS_DIR}
+    -DHAKA_PGO_PROFILE_DIR=${profile_dir}
+    ${ARGN})
+endfunction()
+
+function(haka_pgo_build build_dir)
+  haka_pgo_run(${CMAKE_COMMAND} --build ${build_dir} --parallel)
+endfunction()
+
+# Runs haka_load against a binary; haka_load starts the server in its build
+# directory (so ./public resolves) and stops it with SIGINT afterwards.
+function(haka_pgo_load build_dir label)
+  haka_pgo_run(${CMAKE_COMMAND} -E env "LLVM_PROFILE_FILE=${profile_dir}/haka-%p.profraw"
+    ${load_tool}
+      --spawn ${build_dir}/haka_example
+      --cwd ${build_dir}
+      --connections 16
+      --duration ${HAKA_PGO_DURATION}
+      --label ${label}
+      ${ARGN})
+endfunction()
+
+message(STATUS "HakaPGO: [1/5] Release baseline")
+haka_pgo_configure(${release_dir} -DHAKA_PGO=OFF -DHAKA_ENABLE_LTO=OFF)
+haka_pgo_build(${release_dir})
+
+message(STATUS "HakaPGO: [2/5] Instrumented build and training run")
+file(REMOVE_RECURSE ${profile_dir})
+file(MAKE_DIRECTORY ${profile_dir})
+haka_pgo_configure(${pgo_dir} -DHAKA_PGO=GENERATE -DHAKA_ENABLE_LTO=OFF)
+haka_pgo_build(${pgo_dir})
+haka_pgo_load(${pgo_dir} training)
+
+message(STATUS "HakaPGO: [3/5] Merging profiles")
+if(HAKA_CXX_COMPILER_ID MATCHES "Clang")
+  get_filename_component(compiler_dir ${HAKA_CXX_COMPILER} DIRECTORY)
+  find_program(LLVM_PROFDATA NAMES llvm-profdata HINTS ${compiler_dir} REQUIRED)
+  file(GLOB raw_profiles "${profile_dir}/*.profraw")
+  if(NOT raw_profiles)
+    message(FATAL_ERROR "HakaPGO: training produced no .profraw files in ${profile_dir}")
+  endif()
+  haka_pgo_run(${LLVM_PROFDATA} merge -output=${profile_dir}/haka.profdata ${raw_profiles})
+else()
+  file(GLOB_RECURSE gcda_files "${profile_dir}/*.gcda")
+  if(NOT gcda_files)
+    message(FATAL_ERROR "HakaPGO: training produced no .gcda files in ${profile_dir}")
+  endif()
+endif()
+
+message(STATUS "HakaPGO: [4/5] PGO + LTO rebuild")
+haka_pgo_configure(${pgo_dir} -DHAKA_PGO=USE -DHAKA_ENABLE_LTO=ON)
+haka_pgo_build(${pgo_dir})
+
+message(STATUS "HakaPGO: [5/5] Benchmark")
+file(REMOVE ${results_file})
+haka_pgo_load(${release_dir} release --report ${results_file})
+haka_pgo_load(${pgo_dir} pgo-lto --report ${results_file})
+
+file(READ ${results_file} results)
+string(REGEX MATCH "label=release [^\n]* rps=([0-9]+)" _ "${results}")
+set(release_rps ${CMAKE_MATCH_1})
+string(REGEX MATCH "label=pgo-lto [^\n]* rps=([0-9]+)" _ "${results}")
+set(pgo_rps ${CMAKE_MATCH_1})
+
+if(release_rps AND pgo_rps)
+  math(EXPR change_permille "(${pgo_rps} - ${release_rps}) * 1000 / ${release_rps}")
+  # Split off the sign: integer division truncates towards zero, so -0.5%
+  # would otherwise print as 0.5%.
+  set(change_sign "")
+  if(change_permille LESS 0)
+    set(change_sign "-")
+    math(EXPR change_permille "-${change_permille}")
+  endif()
+  math(EXPR change_whole "${change_permille} / 10")
+  math(EXPR change_frac "${change_permille} % 10")
+  set(summary "Throughput: release ${release_rps} req/s, pgo+lto ${pgo_rps} req/s (${change_sign}${change_whole}.${change_frac}%)")
+else()
+  set(summary "Could not parse benchmark results")
+endif()
+
+file(WRITE ${report_file} "Haka PGO + LTO report\n\n${results}\n${summary}\n\nOptimized binary: ${pgo_dir}/haka_example\n")
+message(STATUS "HakaPGO: ${summary}")
+message(STATUS "HakaPGO: report written to ${report_file}")
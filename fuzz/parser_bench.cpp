@@ -0,0 +1,119 @@
+// haka_parser_bench: request-head parsing throughput, Haka::RequestParser
+// against the reference parser the fuzzer compares it with.
+//
+//   haka_parser_bench fuzz/corpus [--seconds 2] [--chunk 0]
+//
+// Every file under the given paths is one request. Each round parses the
+// whole corpus (scan + parse_head, on a fresh copy of the bytes since the
+// target is normalized in place). --chunk N feeds the parser N bytes per
+// scan() to measure the incremental path; 0 hands it whole requests.
+
+#include "haka/parser.hpp"
+#include "reference_parser.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+struct Result {
+    double seconds = 0;
+    std::size_t requests = 0;
+    std::size_t bytes = 0;
+};
+
+template <typename ParseOne>
+Result run(const std::vector<std::string>& corpus, double seconds, ParseOne parse_one) {
+    Result result;
+    std::size_t checksum = 0;
+    auto start = Clock::now();
+    auto deadline = start + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(seconds));
+    do {
+        for (const std::string& input : corpus) {
+            checksum += parse_one(input);
+            result.bytes += input.size();
+        }
+        result.requests += corpus.size();
+    } while (Clock::now() < deadline);
+    result.seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    if (checksum == 1) std::puts(""); // Keep the work observable
+    return result;
+}
+
+void report(const char* name, const Result& result) {
+    std::printf("%-10s %9.1f MB/s %9.2f M req/s\n", name, result.bytes / result.seconds / 1e6,
+                result.requests / result.seconds / 1e6);
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    std::vector<std::string> corpus;
+    double seconds = 2.0;
+    std::size_t chunk = 0;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--seconds" && i + 1 < argc) {
+            seconds = std::atof(argv[++i]);
+        } else if (arg == "--chunk" && i + 1 < argc) {
+            chunk = static_cast<std::size_t>(std::atol(argv[++i]));
+        } else {
+            std::vector<std::filesystem::path> files;
+            if (std::filesystem::is_directory(arg)) {
+                for (const auto& entry : std::filesystem::directory_iterator(arg)) {
+                    if (entry.is_regular_file()) files.push_back(entry.path());
+                }
+            } else {
+                files.emplace_back(arg);
+            }
+            for (const auto& path : files) {
+                std::ifstream file(path, std::ios::binary);
+                corpus.emplace_back(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+            }
+        }
+    }
+    if (corpus.empty()) {
+        std::fprintf(stderr, "usage: haka_parser_bench <corpus dir or files>... [--seconds S] [--chunk N]\n");
+        return 1;
+    }
+    std::size_t total = 0;
+    for (const std::string& input : corpus) total += input.size();
+    std::printf("corpus: %zu requests, %zu bytes; %s\n", corpus.size(), total,
+                chunk == 0 ? "whole requests" : ("scan() every " + std::to_string(chunk) + " bytes").c_str());
+
+    Haka::ParserLimits limits;
+    Result haka = run(corpus, seconds, [&](const std::string& input) -> std::size_t {
+        Haka::RequestParser parser(limits);
+        std::string buffer;
+        Haka::ParseStatus status = Haka::ParseStatus::Incomplete;
+        if (chunk == 0) {
+            buffer = input;
+            status = parser.scan(buffer);
+        } else {
+            buffer.reserve(input.size());
+            for (std::size_t offset = 0; offset < input.size() && status == Haka::ParseStatus::Incomplete; offset += chunk) {
+                buffer.append(input, offset, chunk);
+                status = parser.scan(buffer);
+            }
+        }
+        if (status != Haka::ParseStatus::HeadComplete) return 0;
+        Haka::Request request;
+        parser.parse_head(buffer, request);
+        return request.headers.size();
+    });
+    Result reference = run(corpus, seconds, [&](const std::string& input) -> std::size_t {
+        return HakaFuzz::reference_parse(input, limits).headers.size();
+    });
+    report("haka", haka);
+    report("reference", reference);
+    std::printf("speedup    %9.2fx\n", (haka.bytes / haka.seconds) / (reference.bytes / reference.seconds));
+    return 0;
+}
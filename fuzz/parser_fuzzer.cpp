@@ -0,0 +1,193 @@
+// Differential fuzzer for Haka::RequestParser.
+//
+// Every input is parsed twice: by the real parser, fed in randomly sized
+// chunks the way Connection feeds it socket reads, and by the plain
+// reference in reference_parser.hpp, which sees the whole input at once.
+// Any disagreement (status, method, path, query, headers, body offset,
+// Content-Length) aborts with both results printed. Each input runs with
+// the default limits and with tiny ones, so the 414/431 paths get exercised
+// too.
+//
+// With Clang this is a libFuzzer target:
+//
+//   haka_parser_fuzzer -max_len=4096 fuzz/corpus
+//
+// Built with HAKA_FUZZ_STANDALONE (other compilers) it has its own main()
+// that replays files and directories, then mutates them for a while:
+//
+//   haka_parser_fuzzer fuzz/corpus [--iterations N]
+
+#include "haka/parser.hpp"
+#include "reference_parser.hpp"
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+namespace {
+
+using Haka::ParserLimits;
+using Haka::ParseStatus;
+
+constexpr ParserLimits kDefaultLimits{};
+constexpr ParserLimits kTinyLimits{32, 96, 4, 64};
+
+// splitmix64; the chunking is derived from the input so runs are reproducible.
+uint64_t next_random(uint64_t& state) {
+    uint64_t z = (state += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+uint64_t input_seed(const std::string& input) {
+    uint64_t hash = 1469598103934665603ULL; // FNV-1a
+    for (unsigned char c : input) hash = (hash ^ c) * 1099511628211ULL;
+    return hash;
+}
+
+[[noreturn]] void mismatch(const char* what, const std::string& input, const ParserLimits& limits, const std::string& haka,
+                           const std::string& reference) {
+    std::fprintf(stderr, "parser mismatch on %s (limits %zu/%zu/%zu/%zu)\n  haka:      %s\n  reference: %s\n  input (%zu bytes): ",
+                 what, limits.max_request_line, limits.max_header_bytes, limits.max_header_count, limits.max_body_size,
+                 haka.c_str(), reference.c_str(), input.size());
+    for (unsigned char c : input) {
+        if (c >= 0x20 && c < 0x7F && c != '\\') std::fputc(c, stderr);
+        else std::fprintf(stderr, "\\x%02x", c);
+    }
+    std::fputc('\n', stderr);
+    std::abort();
+}
+
+void check(const std::string& input, const ParserLimits& limits, uint64_t seed) {
+    HakaFuzz::ReferenceResult expected = HakaFuzz::reference_parse(input, limits);
+
+    // Feed the input in chunks of 1..64 bytes (sometimes the rest at once).
+    Haka::RequestParser parser(limits);
+    std::string buffer;
+    ParseStatus status = ParseStatus::Incomplete;
+    std::size_t offset = 0;
+    while (offset < input.size()) {
+        uint64_t r = next_random(seed);
+        std::size_t chunk = (r & 7) == 0 ? input.size() - offset : 1 + static_cast<std::size_t>((r >> 3) % 64);
+        chunk = std::min(chunk, input.size() - offset);
+        buffer.append(input, offset, chunk);
+        offset += chunk;
+        status = parser.scan(buffer);
+        if (status != ParseStatus::Incomplete) break;
+    }
+    // Connection stops reading once the head is complete, but the reference
+    // sees everything; the rest only matters as body bytes.
+    buffer.append(input, offset, std::string::npos);
+
+    Haka::Request request;
+    if (status == ParseStatus::HeadComplete) {
+        if (parser.body_start() != expected.body_start) {
+            mismatch("body offset", input, limits, std::to_string(parser.body_start()), std::to_string(expected.body_start));
+        }
+        status = parser.parse_head(buffer, request);
+    }
+    if (status != expected.status) {
+        mismatch("status", input, limits, Haka::parse_status_name(status), Haka::parse_status_name(expected.status));
+    }
+    if (status == ParseStatus::BadTarget && parser.path_status() != expected.path_status) {
+        mismatch("path status", input, limits, Haka::path_status_name(parser.path_status()),
+                 Haka::path_status_name(expected.path_status));
+    }
+    if (status != ParseStatus::Complete) return;
+
+    if (request.method != expected.method) mismatch("method", input, limits, request.method, expected.method);
+    if (request.path != expected.path) mismatch("path", input, limits, request.path, expected.path);
+    if (request.query != expected.query) mismatch("query", input, limits, request.query, expected.query);
+    if (parser.content_length() != expected.content_length) {
+        mismatch("Content-Length", input, limits, std::to_string(parser.content_length()), std::to_string(expected.content_length));
+    }
+    if (parser.malformed_lines() != expected.malformed_lines) {
+        mismatch("malformed lines", input, limits, std::to_string(parser.malformed_lines()), std::to_string(expected.malformed_lines));
+    }
+    if (request.headers.size() != expected.headers.size()) {
+        mismatch("header count", input, limits, std::to_string(request.headers.size()), std::to_string(expected.headers.size()));
+    }
+    for (const auto& [name, value] : expected.headers) {
+        auto it = request.headers.find(name);
+        if (it == request.headers.end()) mismatch("header", input, limits, "(missing " + name + ")", name + ": " + value);
+        if (it->second != value) mismatch("header", input, limits, name + ": " + it->second, name + ": " + value);
+    }
+}
+
+} // namespace
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size) {
+    std::string input(reinterpret_cast<const char*>(data), size);
+    uint64_t seed = input_seed(input);
+    check(input, kDefaultLimits, seed);
+    check(input, kTinyLimits, seed);
+    return 0;
+}
+
+#if defined(HAKA_FUZZ_STANDALONE)
+
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <vector>
+
+namespace {
+
+// Byte-level mutations biased towards the characters the parser cares about.
+std::string mutate(std::string input, uint64_t& state) {
+    static const char kInteresting[] = {'\r', '\n', ' ', ':', '/', '.', '%', '?', '\0', '\t', '0', '9', 'A', '\xC3', '\xED', '\xFF'};
+    int edits = 1 + static_cast<int>(next_random(state) % 4);
+    for (int i = 0; i < edits; ++i) {
+        uint64_t r = next_random(state);
+        std::size_t at = input.empty() ? 0 : static_cast<std::size_t>((r >> 8) % (input.size() + 1));
+        char byte = (r & 0x10) ? kInteresting[(r >> 40) % sizeof(kInteresting)] : static_cast<char>(r >> 48);
+        switch (r % 5) {
+            case 0: input.insert(at, 1, byte); break;
+            case 1: if (at < input.size()) input[at] = byte; break;
+            case 2: if (at < input.size()) input.erase(at, 1 + (r >> 56) % 8); break;
+            case 3: input.insert(at, (r >> 52) % 2 ? "\r\n" : "%2e%2E/"); break;
+            case 4: if (at < input.size()) input.insert(at, input.substr(at, 1 + (r >> 56) % 32)); break;
+        }
+    }
+    return input;
+}
+
+void add_file(const std::filesystem::path& path, std::vector<std::string>& corpus) {
+    std::ifstream file(path, std::ios::binary);
+    corpus.emplace_back(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    std::vector<std::string> corpus;
+    long iterations = 200000;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--iterations" && i + 1 < argc) {
+            iterations = std::atol(argv[++i]);
+        } else if (std::filesystem::is_directory(arg)) {
+            for (const auto& entry : std::filesystem::directory_iterator(arg)) {
+                if (entry.is_regular_file()) add_file(entry.path(), corpus);
+            }
+        } else {
+            add_file(arg, corpus);
+        }
+    }
+    if (corpus.empty()) corpus.emplace_back("GET / HTTP/1.1\r\nHost: localhost\r\n\r\n");
+
+    for (const std::string& input : corpus) {
+        LLVMFuzzerTestOneInput(reinterpret_cast<const uint8_t*>(input.data()), input.size());
+    }
+    uint64_t state = 42;
+    for (long i = 0; i < iterations; ++i) {
+        std::string input = mutate(corpus[next_random(state) % corpus.size()], state);
+        LLVMFuzzerTestOneInput(reinterpret_cast<const uint8_t*>(input.data()), input.size());
+    }
+    std::printf("%zu corpus inputs and %ld mutations: parser and reference agree\n", corpus.size(), iterations);
+    return 0;
+}
+
+#endif // HAKA_FUZZ_STANDALONE
@@ -0,0 +1,244 @@
+#ifndef HAKA_FUZZ_REFERENCE_PARSER_HPP
+#define HAKA_FUZZ_REFERENCE_PARSER_HPP
+
+// A deliberately plain re-implementation of Haka::RequestParser (and of
+// normalize_request_target) for differential fuzzing. It sees the whole
+// input at once, copies freely and takes no shortcuts, so it is easy to
+// check against the rules documented in haka/parser.hpp and haka/path.hpp.
+// If it and the real parser disagree on any input, one of them is wrong.
+
+#include "haka/parser.hpp" // For ParserLimits, ParseStatus, PathStatus
+
+#include <algorithm>
+#include <cctype>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace HakaFuzz {
+
+using Haka::ParserLimits;
+using Haka::ParseStatus;
+using Haka::PathStatus;
+
+struct ReferenceResult {
+    ParseStatus status = ParseStatus::Incomplete;
+    PathStatus path_status = PathStatus::Ok;
+    std::string method;
+    std::string path;
+    std::string query;
+    std::unordered_map<std::string, std::string> headers;
+    std::size_t body_start = 0;
+    std::size_t content_length = 0;
+    std::size_t malformed_lines = 0;
+};
+
+inline std::string reference_lower(std::string s) {
+    std::transform(s.begin(), s.end(), s.begin(), [](unsigned char c) {
+        return c < 0x80 ? static_cast<char>(std::tolower(c)) : static_cast<char>(c);
+    });
+    return s;
+}
+
+// Decodes code points one at a time (Unicode table 3-7).
+inline bool reference_utf8(const std::string& s) {
+    std::size_t i = 0;
+    while (i < s.size()) {
+        unsigned char c = static_cast<unsigned char>(s[i]);
+        uint32_t cp = 0;
+        std::size_t n = 0;
+        if (c < 0x80) {
+            ++i;
+            continue;
+        } else if ((c & 0xE0) == 0xC0) {
+            cp = c & 0x1F;
+            n = 1;
+        } else if ((c & 0xF0) == 0xE0) {
+            cp = c & 0x0F;
+            n = 2;
+        } else if ((c & 0xF8) == 0xF0) {
+            cp = c & 0x07;
+            n = 3;
+        } else {
+            return false;
+        }
+        if (i + n >= s.size()) return false; // Truncated sequence
+        for (std::size_t k = 1; k <= n; ++k) {
+            unsigned char cc = static_cast<unsigned char>(s[i + k]);
+            if ((cc & 0xC0) != 0x80) return false;
+            cp = (cp << 6) | (cc & 0x3F);
+        }
+        static const uint32_t min_for_length[] = {0, 0x80, 0x800, 0x10000};
+        if (cp < min_for_length[n]) return false;       // Overlong
+        if (cp >= 0xD800 && cp <= 0xDFFF) return false; // Surrogate
+        if (cp > 0x10FFFF) return false;
+        i += n + 1;
+    }
+    return true;
+}
+
+inline PathStatus reference_normalize(const std::string& target, std::string& path, std::string& query) {
+    if (target == "*") {
+        path = "*";
+        return PathStatus::Ok;
+    }
+    if (target.empty() || target[0] != '/') return PathStatus::BadTarget;
+
+    std::string raw = target;
+    std::size_t mark = target.find('?');
+    if (mark != std::string::npos) {
+        raw = target.substr(0, mark);
+        query = target.substr(mark + 1);
+    }
+
+    std::string decoded;
+    for (std::size_t i = 0; i < raw.size(); ++i) {
+        if (raw[i] == '\0') return PathStatus::BadTarget;
+        if (raw[i] != '%') {
+            decoded += raw[i];
+            continue;
+        }
+        if (i + 2 >= raw.size() || !std::isxdigit(static_cast<unsigned char>(raw[i + 1])) ||
+            !std::isxdigit(static_cast<unsigned char>(raw[i + 2]))) {
+            return PathStatus::BadEncoding;
+        }
+        int byte = std::stoi(raw.substr(i + 1, 2), nullptr, 16);
+        if (byte < 0x20 || byte == 0x7f) return PathStatus::EncodedControl;
+        decoded += static_cast<char>(byte);
+        i += 2;
+    }
+    if (!reference_utf8(decoded)) return PathStatus::BadUtf8;
+
+    // Split on '/', keep a stack of segments.
+    std::vector<std::string> segments;
+    bool trailing_slash = false;
+    std::string segment;
+    std::istringstream in(decoded.substr(1));
+    std::vector<std::string> pieces;
+    while (std::getline(in, segment, '/')) pieces.push_back(segment);
+    if (decoded.size() > 1 && decoded.back() == '/') pieces.push_back("");
+    if (pieces.empty()) pieces.push_back("");
+    for (const std::string& piece : pieces) {
+        if (piece.empty() || piece == ".") {
+            trailing_slash = true;
+        } else if (piece == "..") {
+            if (segments.empty()) return PathStatus::Traversal;
+            segments.pop_back();
+            trailing_slash = true;
+        } else {
+            segments.push_back(piece);
+            trailing_slash = false;
+        }
+    }
+    path.clear();
+    for (const std::string& s : segments) path += "/" + s;
+    if (trailing_slash || segments.empty()) path += "/";
+    return PathStatus::Ok;
+}
+
+/**
+ * @brief Parses `input` as everything a connection received, the way
+ * RequestParser::scan followed by RequestParser::parse_head would.
+ */
+inline ReferenceResult reference_parse(const std::string& input, const ParserLimits& limits) {
+    ReferenceResult result;
+
+    std::size_t line_end = input.find("\r\n");
+    if (line_end == std::string::npos) {
+        // The last byte might be the first half of the CRLF.
+        std::size_t seen = input.size();
+        if (!input.empty() && input.back() == '\r') seen -= 1;
+        result.status = seen > limits.max_request_line ? ParseStatus::RequestLineTooLong : ParseStatus::Incomplete;
+        return result;
+    }
+    if (line_end > limits.max_request_line) {
+        result.status = ParseStatus::RequestLineTooLong;
+        return result;
+    }
+    std::size_t head_end = input.find("\r\n\r\n");
+    std::size_t head_bytes = (head_end == std::string::npos ? input.size() : head_end + 4) - (line_end + 2);
+    if (head_bytes > limits.max_header_bytes) {
+        result.status = ParseStatus::HeaderBytesTooLarge;
+        return result;
+    }
+    if (head_end == std::string::npos) {
+        result.status = ParseStatus::Incomplete;
+        return result;
+    }
+    result.body_start = head_end + 4;
+
+    std::string line = input.substr(0, line_end);
+    std::size_t first = line.find(' ');
+    if (first == std::string::npos || first == 0) {
+        result.status = ParseStatus::BadRequestLine;
+        return result;
+    }
+    std::size_t second = line.find(' ', first + 1);
+    if (second == std::string::npos || second == first + 1) {
+        result.status = ParseStatus::BadRequestLine;
+        return result;
+    }
+    result.method = line.substr(0, first);
+    result.path_status = reference_normalize(line.substr(first + 1, second - first - 1), result.path, result.query);
+    if (result.path_status != PathStatus::Ok) {
+        result.status = ParseStatus::BadTarget;
+        return result;
+    }
+
+    std::istringstream block(input.substr(line_end + 2, head_end - line_end));
+    std::string field;
+    std::size_t count = 0;
+    std::vector<std::string> lengths;
+    bool chunked = false;
+    while (std::getline(block, field, '\n')) {
+        if (field == "\r") break;
+        ++count;
+        if (count > limits.max_header_count) {
+            result.status = ParseStatus::TooManyHeaders;
+            return result;
+        }
+        if (!field.empty() && field.back() == '\r') field.pop_back();
+        std::size_t colon = field.find(':');
+        if (colon == std::string::npos) {
+            ++result.malformed_lines;
+            continue;
+        }
+        std::string name = field.substr(0, colon);
+        std::string value = field.substr(colon + 1);
+        std::size_t start = value.find_first_not_of(" \t");
+        value = start == std::string::npos ? "" : value.substr(start);
+        std::string lower = reference_lower(name);
+        if (lower == "content-length") lengths.push_back(value);
+        if (lower == "transfer-encoding" && !value.empty()) chunked = true;
+        result.headers[lower] = value;
+    }
+    if (chunked) {
+        result.status = ParseStatus::UnsupportedTransferEncoding;
+        return result;
+    }
+    for (std::size_t i = 0; i < lengths.size(); ++i) {
+        std::string digits = lengths[i];
+        std::size_t last = digits.find_last_not_of(" \t");
+        digits = last == std::string::npos ? "" : digits.substr(0, last + 1);
+        bool ok = !digits.empty() && digits.size() <= 18 &&
+                  std::all_of(digits.begin(), digits.end(), [](char c) { return c >= '0' && c <= '9'; });
+        std::size_t length = ok ? static_cast<std::size_t>(std::stoull(digits)) : 0;
+        if (!ok || (i > 0 && length != result.content_length)) {
+            result.status = ParseStatus::BadContentLength;
+            return result;
+        }
+        result.content_length = length;
+    }
+    if (result.content_length > limits.max_body_size) {
+        result.status = ParseStatus::BodyTooLarge;
+        return result;
+    }
+    result.status = ParseStatus::Complete;
+    return result;
+}
+
+} // namespace HakaFuzz
+
+#endif // HAKA_FUZZ_REFERENCE_PARSER_HPP
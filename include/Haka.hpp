@@ -11,9 +11,41 @@
 // Include the router for defining request handlers and static files
 #include "haka/router.hpp"
 
+// Include the handler scheduler, metrics registry and tracer used by the server
+#include "haka/scheduler.hpp"
+#include "haka/metrics.hpp"
+#include "haka/tracing.hpp"
+
+// Include the session store behind Request::session()
+#include "haka/session.hpp"
+
+// Include the in-process pub/sub bus (Server::bus)
+#include "haka/bus.hpp"
+
+// Include the periodic task scheduler (Server::every)
+#include "haka/periodic.hpp"
+
 // Include the server class for running the HTTP server
 #include "haka/server.hpp"
 
+// Include the optional HTTP/3 listener (built with -DHAKA_ENABLE_HTTP3=ON)
+#include "haka/http3.hpp"
+
+// Include the optional JWT bearer authentication (built with -DHAKA_ENABLE_JWT=ON)
+#include "haka/jwt.hpp"
+
+// Include the optional request body decompression (built with -DHAKA_ENABLE_ZLIB=ON)
+#include "haka/inflate.hpp"
+
+// Include the optional zstd dictionary response compression (built with -DHAKA_ENABLE_ZSTD=ON)
+#include "haka/zstd.hpp"
+
+// Include the cross-process shared-memory cache (POSIX only)
+#include "haka/shared_cache.hpp"
+
+// Include the open file cache for static files (POSIX only)
+#include "haka/open_file_cache.hpp"
+
 // Optional: You could add using directives here if you want users
 // to be able to use Haka components without the Haka:: prefix,
 // but it's generally better practice to require the namespace.
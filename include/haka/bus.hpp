@@ -0,0 +1,356 @@
+#ifndef HAKA_BUS_HPP
+#define HAKA_BUS_HPP
+
+// External library includes (Asio for executors)
+#define ASIO_STANDALONE
+#include <asio.hpp>
+
+// Project includes
+#include "haka/core.hpp"    // For log_message
+#include "haka/metrics.hpp" // For append_metric
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace Haka {
+
+/**
+ * @brief A message published on the bus. Every subscriber of the topic sees
+ * the same instance; it is shared by reference count, never copied.
+ */
+struct BusMessage {
+    std::string topic;
+    std::string payload;
+};
+
+/**
+ * @brief Settings for Bus.
+ */
+struct BusConfig {
+    // Messages a mailbox delivers per turn on its executor before it yields
+    // (re-posts itself) so other work on that thread is not starved.
+    std::size_t batch_limit = 256;
+};
+
+namespace detail {
+
+/**
+ * @brief Intrusive multi-producer single-consumer queue (Vyukov). push() is
+ * wait-free for producers; pop() is only called by the owning executor.
+ */
+template <typename Node>
+class MpscQueue {
+public:
+    inline MpscQueue() : head_(&stub_), tail_(&stub_) {}
+
+    inline void push(Node* node) {
+        node->next.store(nullptr, std::memory_order_relaxed);
+        Node* prev = head_.exchange(node, std::memory_order_acq_rel);
+        prev->next.store(node, std::memory_order_release);
+    }
+
+    // Returns nullptr when empty, or when a producer is between its two
+    // stores (the node becomes visible on a later pop).
+    inline Node* pop() {
+        Node* tail = tail_;
+        Node* next = tail->next.load(std::memory_order_acquire);
+        if (tail == &stub_) {
+            if (!next) return nullptr;
+            tail_ = next;
+            tail = next;
+            next = next->next.load(std::memory_order_acquire);
+        }
+        if (next) {
+            tail_ = next;
+            return tail;
+        }
+        if (tail != head_.load(std::memory_order_acquire)) return nullptr;
+        push(&stub_);
+        next = tail->next.load(std::memory_order_acquire);
+        if (next) {
+            tail_ = next;
+            return tail;
+        }
+        return nullptr;
+    }
+
+    inline bool empty() const {
+        Node* tail = tail_;
+        return tail == &stub_ && tail->next.load(std::memory_order_acquire) == nullptr;
+    }
+
+private:
+    alignas(64) std::atomic<Node*> head_; // Producers
+    alignas(64) Node* tail_;              // Consumer
+    Node stub_;
+};
+
+} // namespace detail
+
+/**
+ * @brief Topic-based publish/subscribe between threads of the process, e.g.,
+ * a handler on a worker thread invalidating a cache owned by the io thread
+ * or by an HTTP/3 worker. Callbacks always run on the executor the
+ * subscriber named, so subscriber state needs no locking.
+ *
+ * Each executor gets one mailbox: a lock-free MPSC queue plus a flag saying
+ * whether a drain is already posted. A publish pushes one node per mailbox
+ * and posts to the executor only if the mailbox was idle, so a burst of
+ * messages costs one wake-up per thread and is delivered as a batch. The
+ * subscription table is an immutable snapshot swapped on (un)subscribe, so
+ * publishing never waits for the subscribe mutex or a table rebuild. It is
+ * not lock-free: std::atomic<std::shared_ptr> guards the snapshot's
+ * refcount with a short internal lock in libstdc++ and MSVC.
+ */
+class Bus {
+public:
+    using Callback = std::function<void(const BusMessage&)>;
+
+    /**
+     * @brief Handle returned by subscribe(). Unsubscribes when destroyed;
+     * call release() to keep the subscription for the bus's lifetime.
+     */
+    class Subscription {
+    public:
+        Subscription() = default;
+        inline Subscription(Bus* bus, uint64_t id) : bus_(bus), id_(id) {}
+        inline Subscription(Subscription&& other) noexcept : bus_(std::exchange(other.bus_, nullptr)), id_(other.id_) {}
+        inline Subscription& operator=(Subscription&& other) noexcept {
+            if (this != &other) {
+                reset();
+                bus_ = std::exchange(other.bus_, nullptr);
+                id_ = other.id_;
+            }
+            return *this;
+        }
+        inline ~Subscription() { reset(); }
+
+        // Stops delivery. Messages already queued for it are dropped.
+        inline void reset() {
+            if (bus_) std::exchange(bus_, nullptr)->unsubscribe(id_);
+        }
+
+        // Detaches the handle; the subscription lasts as long as the bus.
+        inline void release() { bus_ = nullptr; }
+
+    private:
+        Bus* bus_ = nullptr;
+        uint64_t id_ = 0;
+    };
+
+    inline explicit Bus(BusConfig config = {}) : config_(config), table_(std::make_shared<const Table>()) {}
+
+    // Executors must no longer run the bus's handlers (e.g., their io_context is stopped).
+    inline ~Bus() {
+        for (const auto& mailbox : mailboxes_) mailbox->discard();
+    }
+
+    Bus(const Bus&) = delete;
+    Bus& operator=(const Bus&) = delete;
+
+    /**
+     * @brief Subscribes to a topic.
+     * @param topic The topic name (exact match).
+     * @param executor Where the callback runs (e.g., an io_context's executor).
+     * @param callback Called once per message, on `executor`.
+     * @return A handle that unsubscribes when destroyed.
+     */
+    inline Subscription subscribe(const std::string& topic, asio::any_io_executor executor, Callback callback) {
+        std::lock_guard<std::mutex> lock(subscribe_mutex_);
+        auto subscriber = std::make_shared<Subscriber>();
+        subscriber->id = ++next_id_;
+        subscriber->topic = topic;
+        subscriber->callback = std::move(callback);
+        subscriber->mailbox = mailbox_for(executor);
+        subscribers_.emplace(subscriber->id, subscriber);
+        rebuild();
+        return Subscription(this, subscriber->id);
+    }
+
+    /**
+     * @brief Publishes a message to every subscriber of its topic. Callable
+     * from any thread; returns without waiting for delivery.
+     * @param topic The topic name.
+     * @param payload The message body.
+     * @return The number of executors the message was queued for.
+     */
+    inline std::size_t publish(std::string topic, std::string payload) {
+        std::shared_ptr<const Table> table = table_.load(std::memory_order_acquire);
+        auto it = table->find(topic);
+        published_.fetch_add(1, std::memory_order_relaxed);
+        if (it == table->end()) return 0;
+        auto message = std::make_shared<const BusMessage>(BusMessage{std::move(topic), std::move(payload)});
+        for (const auto& target : it->second) {
+            target.mailbox->push(new Node{{}, target.subscribers, message});
+        }
+        return it->second.size();
+    }
+
+    /**
+     * @brief Appends bus counters in Prometheus text format.
+     * @param out The buffer to append to.
+     */
+    inline void collect_metrics(std::string& out) const {
+        out += "# TYPE haka_bus_published_total counter\n";
+        append_metric(out, "haka_bus_published_total", "", published_.load(std::memory_order_relaxed));
+        out += "# TYPE haka_bus_delivered_total counter\n";
+        append_metric(out, "haka_bus_delivered_total", "", delivered_.load(std::memory_order_relaxed));
+        out += "# TYPE haka_bus_batches_total counter\n";
+        append_metric(out, "haka_bus_batches_total", "", batches_.load(std::memory_order_relaxed));
+    }
+
+private:
+    class Mailbox;
+
+    struct Subscriber {
+        uint64_t id = 0;
+        std::string topic;
+        Callback callback;
+        std::shared_ptr<Mailbox> mailbox;
+        std::atomic<bool> active{true};
+    };
+
+    // The subscribers of one topic that live on one mailbox's executor.
+    using SubscriberList = std::vector<std::shared_ptr<Subscriber>>;
+
+    struct Node {
+        std::atomic<Node*> next{nullptr};
+        std::shared_ptr<const SubscriberList> subscribers;
+        std::shared_ptr<const BusMessage> message;
+    };
+
+    struct Target {
+        std::shared_ptr<Mailbox> mailbox;
+        std::shared_ptr<const SubscriberList> subscribers;
+    };
+
+    using Table = std::unordered_map<std::string, std::vector<Target>>;
+
+    /**
+     * @brief Queue of deliveries for one executor. Drained on that executor
+     * in batches; at most one drain is posted at a time.
+     */
+    class Mailbox : public std::enable_shared_from_this<Mailbox> {
+    public:
+        inline Mailbox(Bus& bus, asio::any_io_executor executor) : bus_(bus), executor_(std::move(executor)) {}
+
+        inline ~Mailbox() {
+            discard();
+        }
+
+        // Drops undelivered messages (their nodes reference this mailbox's subscribers).
+        inline void discard() {
+            while (Node* node = queue_.pop()) delete node;
+        }
+
+        inline const asio::any_io_executor& executor() const { return executor_; }
+
+        inline void push(Node* node) {
+            queue_.push(node);
+            if (!scheduled_.exchange(true, std::memory_order_acq_rel)) {
+                asio::post(executor_, [self = shared_from_this()]() { self->drain(); });
+            }
+        }
+
+    private:
+        inline void drain() {
+            std::size_t delivered = 0;
+            std::size_t batch = 0;
+            while (batch < bus_.config_.batch_limit) {
+                Node* node = queue_.pop();
+                if (!node) {
+                    // Idle again. The exchange synchronizes with any producer that saw
+                    // us scheduled and skipped posting, so its node is visible below.
+                    scheduled_.exchange(false, std::memory_order_acq_rel);
+                    if (queue_.empty() || scheduled_.exchange(true, std::memory_order_acq_rel)) break;
+                    continue;
+                }
+                for (const auto& subscriber : *node->subscribers) {
+                    if (!subscriber->active.load(std::memory_order_acquire)) continue;
+                    try {
+                        subscriber->callback(*node->message);
+                    } catch (const std::exception& e) {
+                        log_message("ERROR", fmt::format("Bus subscriber for '{}' threw: {}", node->message->topic, e.what()));
+                    }
+                    ++delivered;
+                }
+                delete node;
+                ++batch;
+            }
+            if (batch == bus_.config_.batch_limit) {
+                // Still scheduled: yield to other handlers on this executor, then continue.
+                asio::post(executor_, [self = shared_from_this()]() { self->drain(); });
+            }
+            bus_.delivered_.fetch_add(delivered, std::memory_order_relaxed);
+            bus_.batches_.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        Bus& bus_;
+        asio::any_io_executor executor_;
+        detail::MpscQueue<Node> queue_;
+        std::atomic<bool> scheduled_{false}; // A drain is posted or running
+    };
+
+    // Called with subscribe_mutex_ held.
+    inline std::shared_ptr<Mailbox> mailbox_for(const asio::any_io_executor& executor) {
+        for (const auto& mailbox : mailboxes_) {
+            if (mailbox->executor() == executor) return mailbox;
+        }
+        mailboxes_.push_back(std::make_shared<Mailbox>(*this, executor));
+        return mailboxes_.back();
+    }
+
+    inline void unsubscribe(uint64_t id) {
+        std::lock_guard<std::mutex> lock(subscribe_mutex_);
+        auto it = subscribers_.find(id);
+        if (it == subscribers_.end()) return;
+        it->second->active.store(false, std::memory_order_release);
+        subscribers_.erase(it);
+        rebuild();
+    }
+
+    // Publishes a new table snapshot. Called with subscribe_mutex_ held.
+    inline void rebuild() {
+        std::unordered_map<std::string, std::vector<std::pair<std::shared_ptr<Mailbox>, SubscriberList>>> grouped;
+        for (const auto& [id, subscriber] : subscribers_) {
+            auto& targets = grouped[subscriber->topic];
+            auto target = targets.begin();
+            while (target != targets.end() && target->first != subscriber->mailbox) ++target;
+            if (target == targets.end()) {
+                targets.emplace_back(subscriber->mailbox, SubscriberList{});
+                target = std::prev(targets.end());
+            }
+            target->second.push_back(subscriber);
+        }
+        auto table = std::make_shared<Table>();
+        for (auto& [topic, targets] : grouped) {
+            auto& out = (*table)[topic];
+            for (auto& [mailbox, list] : targets) {
+                out.push_back(Target{mailbox, std::make_shared<const SubscriberList>(std::move(list))});
+            }
+        }
+        table_.store(std::move(table), std::memory_order_release);
+    }
+
+    BusConfig config_;
+    std::atomic<std::shared_ptr<const Table>> table_; // Not lock-free; held only while copying the pointer
+    std::mutex subscribe_mutex_;                       // Serializes (un)subscribe only
+    std::unordered_map<uint64_t, std::shared_ptr<Subscriber>> subscribers_;
+    std::vector<std::shared_ptr<Mailbox>> mailboxes_;
+    uint64_t next_id_ = 0;
+    std::atomic<uint64_t> published_{0};
+    std::atomic<uint64_t> delivered_{0};
+    std::atomic<uint64_t> batches_{0};
+};
+
+} // namespace Haka
+
+#endif // HAKA_BUS_HPP
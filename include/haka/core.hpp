@@ -13,12 +13,25 @@
 #include <chrono>       // For system clock
 #include <functional>   // For std::function
 #include <exception>    // For std::exception
+#include <stop_token>   // For cooperative handler cancellation
+#include <string_view>  // For header lookups
+#include <algorithm>    // For std::equal
+#include <cctype>       // For std::tolower
+#include <array>        // For RequestId storage
+#include <cstdint>      // For fixed-width integers
+#include <atomic>       // For request ID thread numbering
+#include <random>       // For the request ID boot nonce
+#include <memory>       // For Request::claims
 
 // External library includes
 #define FMT_HEADER_ONLY // Define this if you are using fmt as a header-only library
 #include <fmt/core.h>
 #include <fmt/color.h>
 
+// Project includes
+#include "haka/trace_context.hpp" // For Request::trace
+#include "haka/memory_budget.hpp" // For accounting file reads
+
 // Include struct_json for JSON serialization (needed for Response::JSON template)
 #include <ylt/struct_json/json_writer.h>
 
@@ -28,10 +41,56 @@ namespace Haka
     class Request;
     class Response;
     class Server; // Needed for RouteHandler alias
+    class JwtClaims; // Defined in haka/jwt.hpp (HAKA_ENABLE_JWT)
+    class Session;      // Defined in haka/session.hpp
+    class SessionStore;
 
     // Global flag to enable debug logging
     inline bool enable_debug_logging = false; // Default is false
 
+    namespace detail {
+
+    inline char ascii_lower(char c) {
+        return c >= 'A' && c <= 'Z' ? static_cast<char>(c | 0x20) : c;
+    }
+
+    inline bool iequals(std::string_view a, std::string_view b) {
+        if (a.size() != b.size()) return false;
+        for (std::size_t i = 0; i < a.size(); ++i) {
+            if (ascii_lower(a[i]) != ascii_lower(b[i])) return false;
+        }
+        return true;
+    }
+
+    } // namespace detail
+
+    /**
+     * @brief Case-insensitive, transparent hash for header names, so a
+     * lookup by std::string_view needs no temporary std::string.
+     */
+    struct HeaderNameHash {
+        using is_transparent = void;
+        inline std::size_t operator()(std::string_view name) const noexcept {
+            uint64_t h = 0xcbf29ce484222325ULL; // FNV-1a over the lower-cased name
+            for (char c : name) {
+                h ^= static_cast<unsigned char>(detail::ascii_lower(c));
+                h *= 0x100000001b3ULL;
+            }
+            return static_cast<std::size_t>(h);
+        }
+    };
+
+    struct HeaderNameEqual {
+        using is_transparent = void;
+        inline bool operator()(std::string_view a, std::string_view b) const noexcept {
+            return detail::iequals(a, b);
+        }
+    };
+
+    // Request headers by name. The parser stores names lower-cased; lookups
+    // ignore case either way.
+    using HeaderMap = std::unordered_map<std::string, std::string, HeaderNameHash, HeaderNameEqual>;
+
     /**
      * @brief Helper to guess MIME type based on file extension.
      * @param file_path The file path to analyze.
@@ -53,9 +112,100 @@ namespace Haka
         return "application/octet-stream"; // Default binary type
     }
 
+    /**
+     * @brief Identifies one request in logs and across services. Stored in
+     * a fixed buffer so taking, generating and logging it never allocates.
+     */
+    class RequestId {
+    public:
+        static constexpr std::size_t kMaxSize = 64; // Longer incoming IDs are replaced
+
+        /**
+         * @brief Adopts an ID supplied by the client or an upstream proxy.
+         * @param value The header value.
+         * @return false (leaving the ID unchanged) if the value is empty, too
+         * long, or contains characters outside [A-Za-z0-9._:-].
+         */
+        inline bool assign(std::string_view value) {
+            if (value.empty() || value.size() > kMaxSize) return false;
+            for (char c : value) {
+                if (!(std::isalnum(static_cast<unsigned char>(c)) || c == '-' || c == '_' || c == '.' || c == ':')) {
+                    return false;
+                }
+            }
+            std::copy(value.begin(), value.end(), chars_.begin());
+            size_ = static_cast<uint8_t>(value.size());
+            return true;
+        }
+
+        /**
+         * @brief Generates a new ID: a per-thread counter combined with the
+         * thread's number and a nonce drawn at startup, scrambled by a
+         * bijective mix so IDs are unique within the process and unlikely to
+         * repeat across restarts. No locks, no syscalls.
+         * @return A 16-character hex ID.
+         */
+        static inline RequestId generate() {
+            static const uint64_t boot_nonce = [] {
+                std::random_device rd;
+                return static_cast<uint64_t>(rd()) << 32 | rd();
+            }();
+            static std::atomic<uint64_t> next_thread{0};
+            thread_local const uint64_t thread_bits = next_thread.fetch_add(1, std::memory_order_relaxed) << 40;
+            thread_local uint64_t counter = 0;
+
+            uint64_t z = (thread_bits | (counter++ & ((uint64_t{1} << 40) - 1))) ^ boot_nonce;
+            // splitmix64 finalizer (a bijection, so distinct inputs give distinct IDs)
+            z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+            z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+            z ^= z >> 31;
+
+            static constexpr char digits[] = "0123456789abcdef";
+            RequestId id;
+            for (int i = 15; i >= 0; --i) {
+                id.chars_[static_cast<std::size_t>(i)] = digits[z & 0x0f];
+                z >>= 4;
+            }
+            id.size_ = 16;
+            return id;
+        }
+
+        inline std::string_view view() const { return {chars_.data(), size_}; }
+        inline bool empty() const { return size_ == 0; }
+
+    private:
+        std::array<char, kMaxSize> chars_{};
+        uint8_t size_ = 0;
+    };
+
+    // Request ID of the work the current thread is doing, prefixed to its log lines.
+    inline thread_local const RequestId* current_request_id = nullptr;
+
+    /**
+     * @brief Tags every log_message on this thread with a request's ID for
+     * as long as it is in scope. Restores the previous ID when destroyed.
+     */
+    class LogContext {
+    public:
+        inline explicit LogContext(const RequestId& id)
+            : previous_(current_request_id)
+        {
+            current_request_id = id.empty() ? nullptr : &id;
+        }
+        inline ~LogContext() {
+            current_request_id = previous_;
+        }
+        LogContext(const LogContext&) = delete;
+        LogContext& operator=(const LogContext&) = delete;
+
+    private:
+        const RequestId* previous_;
+    };
+
     /**
      * @brief Basic logging function using fmt library for formatted output.
      * Only prints DEBUG level messages if enable_debug_logging is true.
+     * Lines written inside a LogContext carry that request's ID.
      * @param level The log level (e.g., "INFO", "DEBUG", "ERROR").
      * @param message The message to log.
      */
@@ -69,6 +219,9 @@ namespace Haka
         auto in_time_t = std::chrono::system_clock::to_time_t(now);
         std::stringstream ss;
         ss << std::put_time(std::localtime(&in_time_t), "%Y-%m-%d %H:%M:%S");
+        if (current_request_id) {
+            ss << "] [" << current_request_id->view();
+        }
 
         if (level == "ERROR") {
             fmt::print(fg(fmt::color::red), "[{}] [{}] {}\n", ss.str(), level, message);
@@ -91,9 +244,84 @@ namespace Haka
     {
     public:
         std::string method;     // HTTP method (GET, POST, etc.)
-        std::string path;       // Request URL path
-        std::unordered_map<std::string, std::string> headers; // HTTP headers
-        // TODO: Add members for request body, query parameters, form data, etc.
+        std::string path;       // Request URL path, percent-decoded and normalized
+        std::string query;      // Raw query string after '?', still percent-encoded
+        HeaderMap headers;      // HTTP headers, names lower-cased
+        std::string remote_address; // Client IP address as seen by the server
+        std::string body;       // Request body (Content-Length delimited)
+        // TODO: Add members for query parameters, form data, etc.
+
+        // Point in time after which nobody is waiting for the response.
+        // time_point::max() means the request has no deadline.
+        std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::time_point::max();
+        // Stop is requested on this source when the deadline passes.
+        std::stop_source cancellation;
+        // Taken from the incoming X-Request-Id header (ServerConfig::request_id_header)
+        // or generated; echoed in the response and tagged on the request's log lines.
+        RequestId id;
+        // W3C trace context; use trace.traceparent() when calling downstream
+        // services. Only filled in when tracing is enabled.
+        TraceContext trace;
+        // Verified token claims, set by an authentication filter such as
+        // jwt_bearer(); null on routes without one.
+        std::shared_ptr<const JwtClaims> claims;
+        // Set by the server when sessions are enabled (Server::sessions);
+        // use session() to reach the request's session.
+        SessionStore* session_store = nullptr;
+
+        /**
+         * @brief Token a long-running handler can poll (or attach a
+         * std::stop_callback to) to notice that its deadline has passed.
+         * @return The request's stop token.
+         */
+        inline std::stop_token stop_token() const {
+            return cancellation.get_token();
+        }
+
+        /**
+         * @brief Checks whether the request has been cancelled.
+         * @return true once the deadline has passed and a 504 has been sent.
+         */
+        inline bool cancelled() const {
+            return cancellation.stop_requested();
+        }
+
+        /**
+         * @brief Looks up a header by name, ignoring case.
+         * @param name The header name (e.g., "Content-Type").
+         * @return The header value, or an empty view if it is not present.
+         */
+        inline std::string_view header(std::string_view name) const {
+            auto it = headers.find(name);
+            return it != headers.end() ? std::string_view(it->second) : std::string_view{};
+        }
+
+        /**
+         * @brief Looks up a cookie from the Cookie header.
+         * @param name The cookie name.
+         * @return The cookie value, or an empty view if it is not present.
+         */
+        inline std::string_view cookie(std::string_view name) const {
+            std::string_view cookies = header("Cookie");
+            while (!cookies.empty()) {
+                std::size_t end = cookies.find(';');
+                std::string_view pair = cookies.substr(0, end);
+                cookies = end == std::string_view::npos ? std::string_view{} : cookies.substr(end + 1);
+                while (!pair.empty() && pair.front() == ' ') pair.remove_prefix(1);
+                std::size_t eq = pair.find('=');
+                if (eq != std::string_view::npos && pair.substr(0, eq) == name) {
+                    return pair.substr(eq + 1);
+                }
+            }
+            return {};
+        }
+
+        /**
+         * @brief Gets the client's session, creating one (and its cookie) on
+         * first use. Defined in haka/session.hpp.
+         * @return The session, shared with the client's concurrent requests.
+         */
+        inline Session& session() const;
 
         /**
          * @brief Checks if the request path starts with a given prefix.
@@ -118,6 +346,12 @@ namespace Haka
             }
             return path;
         }
+
+    private:
+        friend class SessionStore;
+
+        // Resolved lazily by session(), so requests that never use it cost nothing.
+        mutable std::shared_ptr<Session> session_;
     };
 
     /**
@@ -143,6 +377,11 @@ namespace Haka
         int status_code = 200;  // HTTP status code
         std::unordered_map<std::string, std::string> headers; // HTTP headers
         std::string body;       // Response body
+        // Set-Cookie values, one header line each (`headers` holds one value per name).
+        std::vector<std::string> cookies;
+        // Preformatted "Name: value\r\n" lines sent after `headers`, owned by
+        // whoever set it (e.g., a CorsPolicy). Avoids rebuilding fixed headers per request.
+        const std::string* header_block = nullptr;
 
         /**
          * @brief Default constructor - sets default content type to text/plain.
@@ -211,6 +450,16 @@ namespace Haka
             std::streamsize size = file.tellg();
             file.seekg(0, std::ios::beg);
 
+            MemoryReservation reading(MemorySubsystem::Files);
+            if (!reading.try_grow(static_cast<std::size_t>(size))) {
+                log_message("WARN", fmt::format("Not enough memory budget to serve {} ({} bytes)", file_path, size));
+                status_code = 503;
+                body = "Service Unavailable";
+                headers["Content-Type"] = "text/plain";
+                headers["Retry-After"] = "1";
+                return false;
+            }
+
             body.resize(size);
             if (!file.read(&body[0], size)) {
                 log_message("ERROR", fmt::format("Error reading file: {}", file_path));
@@ -248,9 +497,12 @@ namespace Haka
                 case 403: response_stream << "Forbidden"; break;
                 case 404: response_stream << "Not Found"; break;
                 case 405: response_stream << "Method Not Allowed"; break;
+                case 413: response_stream << "Payload Too Large"; break;
+                case 415: response_stream << "Unsupported Media Type"; break;
                 case 500: response_stream << "Internal Server Error"; break;
                 case 501: response_stream << "Not Implemented"; break;
                 case 503: response_stream << "Service Unavailable"; break;
+                case 504: response_stream << "Gateway Timeout"; break;
                 default: response_stream << "Unknown Status"; break;
             }
             response_stream << "\r\n";
@@ -259,6 +511,13 @@ namespace Haka
             {
                 response_stream << header.first << ": " << header.second << "\r\n";
             }
+            for (const auto& cookie : cookies)
+            {
+                response_stream << "Set-Cookie: " << cookie << "\r\n";
+            }
+            if (header_block) {
+                response_stream << *header_block;
+            }
 
             response_stream << "Content-Length: " << body.size() << "\r\n";
             response_stream << "\r\n";
@@ -272,6 +531,10 @@ namespace Haka
     // Type alias for a function that handles a request and prepares a response
     using RouteHandler = std::function<void(const Request&, Response&)>;
 
+    // Runs before a route's handler (e.g., authentication). It may annotate the
+    // request; returning false skips the handler and sends the response as filled in.
+    using RouteFilter = std::function<bool(Request&, Response&)>;
+
 
 } // namespace Haka
 
@@ -0,0 +1,159 @@
+#ifndef HAKA_CORS_HPP
+#define HAKA_CORS_HPP
+
+#include <chrono>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace Haka {
+
+/**
+ * @brief Cross-origin settings for a router or route group.
+ */
+struct CorsConfig {
+    // Origins allowed to call (e.g., "https://app.example.com"), or "*" for any.
+    std::vector<std::string> allow_origins{"*"};
+    std::vector<std::string> allow_methods{"GET", "POST", "PUT", "PATCH", "DELETE"};
+    std::vector<std::string> allow_headers{"Content-Type", "Authorization"};
+    // Response headers scripts may read besides the CORS-safelisted ones.
+    std::vector<std::string> expose_headers{};
+    // Allow cookies and HTTP auth. Needs explicit origins, not "*".
+    bool allow_credentials = false;
+    // How long browsers may cache a preflight (Chromium caps this at 2 hours).
+    std::chrono::seconds max_age{7200};
+};
+
+/**
+ * @brief A CORS configuration compiled into ready-to-send bytes. Preflight
+ * responses are serialized in full when the policy is registered, and the
+ * headers for actual responses are interned per origin, so answering a
+ * request only costs a hash lookup on its Origin header.
+ */
+class CorsPolicy {
+public:
+    struct Entry {
+        std::string preflight_headers; // Header lines of the preflight answer
+        std::string preflight;         // Complete HTTP/1.1 204 response
+        std::string response_headers;  // Header lines added to actual responses
+    };
+
+    /**
+     * @param config The settings to compile.
+     * @throws std::invalid_argument if credentials are allowed for any origin
+     * ("*"), which browsers reject.
+     */
+    inline explicit CorsPolicy(const CorsConfig& config) {
+        bool any = false;
+        for (const auto& origin : config.allow_origins) {
+            any |= origin == "*";
+        }
+        if (any && config.allow_credentials) {
+            throw std::invalid_argument("CORS: allow_credentials requires explicit origins, not \"*\"");
+        }
+        if (any) {
+            any_origin_ = std::make_unique<Entry>(compile("*", config));
+        } else {
+            for (const auto& origin : config.allow_origins) {
+                origins_.emplace(origin, compile(origin, config));
+            }
+            vary_headers_ = "Vary: Origin\r\n";
+        }
+        rejected_preflight_ =
+            "HTTP/1.1 403 Forbidden\r\nVary: Origin\r\nContent-Type: text/plain\r\nContent-Length: 25\r\n"
+            "Connection: close\r\n\r\nCORS origin not allowed.\n";
+    }
+
+    /**
+     * @brief Looks up the compiled headers for a request's Origin.
+     * @param origin The Origin header value.
+     * @return The entry, or nullptr if the origin is not allowed (or empty).
+     */
+    inline const Entry* find(std::string_view origin) const {
+        if (origin.empty()) return nullptr;
+        if (any_origin_) return any_origin_.get();
+        auto it = origins_.find(origin);
+        return it == origins_.end() ? nullptr : &it->second;
+    }
+
+    /**
+     * @brief The header lines for an actual response to this origin: its
+     * CORS headers, or only "Vary: Origin" when the policy lists explicit
+     * origins and this one is not allowed (or absent), so shared caches
+     * never hand one origin's response to another.
+     * @return The lines, or nullptr if none are needed.
+     */
+    inline const std::string* response_headers(std::string_view origin) const {
+        if (const Entry* entry = find(origin)) return &entry->response_headers;
+        return any_origin_ ? nullptr : &vary_headers_;
+    }
+
+    /**
+     * @brief The complete response to a preflight from this origin: a 204
+     * with the CORS headers, or a 403 if the origin is not allowed.
+     */
+    inline std::string_view preflight(std::string_view origin) const {
+        const Entry* entry = find(origin);
+        return entry ? std::string_view(entry->preflight) : std::string_view(rejected_preflight_);
+    }
+
+    /**
+     * @brief Whether a request is a CORS preflight (OPTIONS with
+     * Access-Control-Request-Method), as opposed to a plain OPTIONS.
+     */
+    static inline bool is_preflight(std::string_view method, std::string_view request_method_header) {
+        return method == "OPTIONS" && !request_method_header.empty();
+    }
+
+private:
+    struct StringHash {
+        using is_transparent = void;
+        inline std::size_t operator()(std::string_view s) const { return std::hash<std::string_view>{}(s); }
+    };
+
+    static inline std::string join(const std::vector<std::string>& items) {
+        std::string out;
+        for (const auto& item : items) {
+            if (!out.empty()) out += ", ";
+            out += item;
+        }
+        return out;
+    }
+
+    static inline Entry compile(const std::string& origin, const CorsConfig& config) {
+        Entry entry;
+        std::string common = "Access-Control-Allow-Origin: " + origin + "\r\n";
+        if (config.allow_credentials) common += "Access-Control-Allow-Credentials: true\r\n";
+        if (origin != "*") common += "Vary: Origin\r\n"; // Caches must key on Origin
+
+        entry.preflight_headers = common;
+        if (!config.allow_methods.empty()) {
+            entry.preflight_headers += "Access-Control-Allow-Methods: " + join(config.allow_methods) + "\r\n";
+        }
+        if (!config.allow_headers.empty()) {
+            entry.preflight_headers += "Access-Control-Allow-Headers: " + join(config.allow_headers) + "\r\n";
+        }
+        entry.preflight_headers += "Access-Control-Max-Age: " + std::to_string(config.max_age.count()) + "\r\n";
+        entry.preflight = "HTTP/1.1 204 No Content\r\n" + entry.preflight_headers + "Content-Length: 0\r\nConnection: close\r\n\r\n";
+
+        entry.response_headers = common;
+        if (!config.expose_headers.empty()) {
+            entry.response_headers += "Access-Control-Expose-Headers: " + join(config.expose_headers) + "\r\n";
+        }
+        return entry;
+    }
+
+    std::unique_ptr<Entry> any_origin_; // Set when "*" is allowed
+    std::unordered_map<std::string, Entry, StringHash, std::equal_to<>> origins_;
+    std::string rejected_preflight_;
+    std::string vary_headers_; // Sent to origins that get no CORS headers
+};
+
+} // namespace Haka
+
+#endif // HAKA_CORS_HPP
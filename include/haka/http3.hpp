@@ -0,0 +1,788 @@
+#ifndef HAKA_HTTP3_HPP
+#define HAKA_HTTP3_HPP
+
+// HTTP/3 support is optional: it needs the vendored quiche library
+// (third_party/quiche) and is enabled with -DHAKA_ENABLE_HTTP3=ON, which
+// defines HAKA_ENABLE_HTTP3. The UDP batching below is Linux-specific.
+#if defined(HAKA_ENABLE_HTTP3) && defined(__linux__)
+
+// Project includes
+#include "haka/core.hpp"   // For Request, Response, log_message
+#include "haka/server.hpp" // For Server (routing, scheduler, Alt-Svc)
+#include "haka/path.hpp"   // For normalize_request_target
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <charconv>
+#include <chrono>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/udp.h>
+#include <sys/socket.h>
+
+#include <quiche.h>
+
+#ifndef UDP_SEGMENT
+#define UDP_SEGMENT 103 // GSO: send one large buffer as equal-size datagrams
+#endif
+#ifndef UDP_GRO
+#define UDP_GRO 104     // GRO: receive coalesced datagrams with their segment size
+#endif
+
+namespace Haka {
+
+/**
+ * @brief Settings for the HTTP/3 listener.
+ */
+struct Http3Config {
+    unsigned short port = 8443;           // UDP port to listen on
+    std::string cert_file;                // PEM certificate chain
+    std::string key_file;                 // PEM private key
+    std::size_t workers = std::max(1u, std::thread::hardware_concurrency()); // One socket + thread per core
+    std::chrono::milliseconds idle_timeout{30000};
+    std::chrono::seconds alt_svc_max_age{86400}; // How long clients may remember the Alt-Svc entry
+};
+
+/**
+ * @brief HTTP/3 over QUIC listener that serves the same Router and handlers
+ * as the TCP Server.
+ *
+ * Every worker owns a UDP socket bound to the same port with SO_REUSEPORT,
+ * its own io_context and thread, and the QUIC connections it accepted. The
+ * first byte of each connection ID the server issues is the owning worker's
+ * index, so a packet the kernel delivers to the wrong socket (after a NAT
+ * rebinding, say) is handed to the right worker instead of being dropped.
+ * Datagrams are read with recvmmsg + UDP GRO and written with sendmmsg +
+ * UDP GSO, so a busy socket costs a few syscalls per batch, not per packet.
+ *
+ * Handlers run on the Server's scheduler exactly like TCP requests. Request
+ * bodies are not read yet; DATA frames are drained and discarded.
+ */
+class Http3Listener {
+public:
+    /**
+     * @brief Creates the QUIC configuration and advertises HTTP/3 on the
+     * TCP server through Alt-Svc.
+     * @param server The server whose routes are served.
+     * @param host Address to bind the UDP sockets to.
+     * @param config Listener settings.
+     * @throws std::runtime_error if the certificate or key cannot be loaded.
+     */
+    inline Http3Listener(Server& server, const std::string& host, Http3Config config)
+        : server_(server), host_(host), config_(std::move(config))
+    {
+        quic_config_ = quiche_config_new(QUICHE_PROTOCOL_VERSION);
+        if (!quic_config_) {
+            throw std::runtime_error("HTTP/3: failed to create QUIC config");
+        }
+        if (quiche_config_load_cert_chain_from_pem_file(quic_config_, config_.cert_file.c_str()) < 0 ||
+            quiche_config_load_priv_key_from_pem_file(quic_config_, config_.key_file.c_str()) < 0) {
+            quiche_config_free(quic_config_);
+            throw std::runtime_error(fmt::format("HTTP/3: failed to load certificate '{}' / key '{}'",
+                                                 config_.cert_file, config_.key_file));
+        }
+        quiche_config_set_application_protos(quic_config_,
+            reinterpret_cast<const uint8_t*>(QUICHE_H3_APPLICATION_PROTOCOL),
+            sizeof(QUICHE_H3_APPLICATION_PROTOCOL) - 1);
+        quiche_config_set_max_idle_timeout(quic_config_, static_cast<uint64_t>(config_.idle_timeout.count()));
+        quiche_config_set_max_recv_udp_payload_size(quic_config_, kMaxDatagramSize);
+        quiche_config_set_max_send_udp_payload_size(quic_config_, kMaxDatagramSize);
+        quiche_config_set_initial_max_data(quic_config_, 10 * 1024 * 1024);
+        quiche_config_set_initial_max_stream_data_bidi_local(quic_config_, 1024 * 1024);
+        quiche_config_set_initial_max_stream_data_bidi_remote(quic_config_, 1024 * 1024);
+        quiche_config_set_initial_max_stream_data_uni(quic_config_, 1024 * 1024);
+        quiche_config_set_initial_max_streams_bidi(quic_config_, 100);
+        quiche_config_set_initial_max_streams_uni(quic_config_, 100);
+
+        h3_config_ = quiche_h3_config_new();
+        config_.workers = std::clamp<std::size_t>(config_.workers, 1, 255);
+
+        server_.advertise_alt_svc(fmt::format("h3=\":{}\"; ma={}", config_.port, config_.alt_svc_max_age.count()));
+    }
+
+    inline ~Http3Listener() {
+        stop();
+        workers_.clear();
+        if (h3_config_) quiche_h3_config_free(h3_config_);
+        if (quic_config_) quiche_config_free(quic_config_);
+    }
+
+    Http3Listener(const Http3Listener&) = delete;
+    Http3Listener& operator=(const Http3Listener&) = delete;
+
+    /**
+     * @brief Binds the per-core sockets and starts the worker threads.
+     */
+    inline void start() {
+        for (std::size_t i = 0; i < config_.workers; ++i) {
+            workers_.push_back(std::make_unique<Worker>(*this, static_cast<uint8_t>(i)));
+        }
+        for (auto& worker : workers_) {
+            worker->start();
+        }
+        log_message("INFO", fmt::format("HTTP/3 listening on udp://{}:{} with {} workers", host_, config_.port, workers_.size()));
+    }
+
+    /**
+     * @brief Stops the workers; open QUIC connections are dropped.
+     */
+    inline void stop() {
+        for (auto& worker : workers_) {
+            worker->stop();
+        }
+    }
+
+private:
+    static constexpr std::size_t kMaxDatagramSize = 1350;
+    static constexpr std::size_t kConnIdLen = 16;   // First byte routes to the owning worker
+    static constexpr std::size_t kRecvBatch = 32;   // Datagrams per recvmmsg
+    static constexpr std::size_t kGroBufferSize = 65535;
+    static constexpr std::size_t kMaxGsoSegments = 44; // 44 * 1350 fits a 64 KiB GSO buffer
+
+    class Worker;
+
+    // State of one request stream.
+    struct Stream {
+        Request request;
+        MemoryReservation body_reservation{MemorySubsystem::RequestBuffers};
+        std::shared_ptr<Response> response;
+        std::string pending_body;     // Body bytes quiche has not accepted yet
+        std::size_t body_offset = 0;
+        bool dispatched = false;
+        bool response_ready = false;  // The handler finished; headers go out when quiche takes them
+        bool headers_sent = false;
+    };
+
+    // One QUIC connection owned by a worker.
+    struct QuicConnection {
+        quiche_conn* conn = nullptr;
+        quiche_h3_conn* h3 = nullptr;
+        std::array<uint8_t, kConnIdLen> cid{};
+        std::string odcid;            // Client-chosen DCID, also mapped until the handshake switches IDs
+        sockaddr_storage peer{};
+        socklen_t peer_len = 0;
+        std::unique_ptr<asio::steady_timer> timer;
+        std::unordered_map<uint64_t, Stream> streams;
+
+        inline ~QuicConnection() {
+            if (h3) quiche_h3_conn_free(h3);
+            if (conn) quiche_conn_free(conn);
+        }
+    };
+
+    // How scheduler completions reach a worker. Handlers may finish after
+    // the worker is gone (the listener is destroyed before the Server's
+    // scheduler joins), so they post through this and Worker::stop() clears it.
+    struct WorkerHandle {
+        std::mutex mutex;
+        Worker* worker = nullptr;
+    };
+
+    class Worker {
+    public:
+        inline Worker(Http3Listener& owner, uint8_t index)
+            : owner_(owner), index_(index), socket_(io_), rng_(std::random_device{}()),
+              handle_(std::make_shared<WorkerHandle>())
+        {
+            handle_->worker = this;
+            auto endpoint = asio::ip::udp::endpoint(asio::ip::make_address(owner_.host_), owner_.config_.port);
+            socket_.open(endpoint.protocol());
+            int one = 1;
+            ::setsockopt(socket_.native_handle(), SOL_SOCKET, SO_REUSEPORT, &one, sizeof(one));
+            gro_ = ::setsockopt(socket_.native_handle(), SOL_UDP, UDP_GRO, &one, sizeof(one)) == 0;
+            socket_.bind(endpoint);
+            socket_.non_blocking(true);
+            local_len_ = sizeof(local_);
+            ::getsockname(socket_.native_handle(), reinterpret_cast<sockaddr*>(&local_), &local_len_);
+            gso_ = true; // Cleared on the first EIO/EINVAL from a GSO send
+            log_message("DEBUG", fmt::format("HTTP/3 worker {} bound (GRO {})", index_, gro_ ? "on" : "off"));
+        }
+
+        inline ~Worker() {
+            stop();
+        }
+
+        inline void start() {
+            wait_readable();
+            thread_ = std::thread([this] { io_.run(); });
+        }
+
+        inline void stop() {
+            {
+                // Completions arriving from now on are dropped.
+                std::lock_guard<std::mutex> lock(handle_->mutex);
+                handle_->worker = nullptr;
+            }
+            io_.stop();
+            if (thread_.joinable()) thread_.join();
+        }
+
+        // Packets for connections owned by this worker that arrived on another socket.
+        inline void post_packet(std::vector<uint8_t> packet, sockaddr_storage from, socklen_t from_len) {
+            asio::post(io_, [this, packet = std::move(packet), from, from_len]() mutable {
+                handle_packet(packet.data(), packet.size(), from, from_len);
+                flush();
+            });
+        }
+
+    private:
+        inline void wait_readable() {
+            socket_.async_wait(asio::ip::udp::socket::wait_read, [this](asio::error_code ec) {
+                if (ec) return;
+                read_batch();
+                flush();
+                wait_readable();
+            });
+        }
+
+        /**
+         * @brief Drains the socket with recvmmsg, splitting GRO-coalesced
+         * buffers back into datagrams.
+         */
+        inline void read_batch() {
+            static thread_local std::vector<uint8_t> storage(kRecvBatch * kGroBufferSize);
+            std::array<mmsghdr, kRecvBatch> msgs{};
+            std::array<iovec, kRecvBatch> iovs{};
+            std::array<sockaddr_storage, kRecvBatch> addrs{};
+            std::array<std::array<char, CMSG_SPACE(sizeof(int))>, kRecvBatch> controls{};
+
+            for (;;) {
+                for (std::size_t i = 0; i < kRecvBatch; ++i) {
+                    iovs[i] = {storage.data() + i * kGroBufferSize, kGroBufferSize};
+                    msgs[i].msg_hdr = {};
+                    msgs[i].msg_hdr.msg_name = &addrs[i];
+                    msgs[i].msg_hdr.msg_namelen = sizeof(sockaddr_storage);
+                    msgs[i].msg_hdr.msg_iov = &iovs[i];
+                    msgs[i].msg_hdr.msg_iovlen = 1;
+                    msgs[i].msg_hdr.msg_control = controls[i].data();
+                    msgs[i].msg_hdr.msg_controllen = controls[i].size();
+                }
+                int received = ::recvmmsg(socket_.native_handle(), msgs.data(), kRecvBatch, MSG_DONTWAIT, nullptr);
+                if (received <= 0) return; // EAGAIN: socket drained
+
+                for (int i = 0; i < received; ++i) {
+                    std::size_t length = msgs[i].msg_len;
+                    std::size_t segment = length;
+                    for (cmsghdr* c = CMSG_FIRSTHDR(&msgs[i].msg_hdr); c; c = CMSG_NXTHDR(&msgs[i].msg_hdr, c)) {
+                        if (c->cmsg_level == SOL_UDP && c->cmsg_type == UDP_GRO) {
+                            int gso_size = 0;
+                            std::memcpy(&gso_size, CMSG_DATA(c), sizeof(gso_size));
+                            if (gso_size > 0) segment = static_cast<std::size_t>(gso_size);
+                        }
+                    }
+                    uint8_t* data = static_cast<uint8_t*>(iovs[i].iov_base);
+                    for (std::size_t offset = 0; offset < length; offset += segment) {
+                        handle_packet(data + offset, std::min(segment, length - offset),
+                                      addrs[i], msgs[i].msg_hdr.msg_namelen);
+                    }
+                }
+                if (static_cast<std::size_t>(received) < kRecvBatch) return;
+            }
+        }
+
+        inline void handle_packet(uint8_t* data, std::size_t length, const sockaddr_storage& from, socklen_t from_len) {
+            uint32_t version = 0;
+            uint8_t type = 0;
+            uint8_t scid[QUICHE_MAX_CONN_ID_LEN];
+            size_t scid_len = sizeof(scid);
+            uint8_t dcid[QUICHE_MAX_CONN_ID_LEN];
+            size_t dcid_len = sizeof(dcid);
+            uint8_t token[256];
+            size_t token_len = sizeof(token);
+            if (quiche_header_info(data, length, kConnIdLen, &version, &type, scid, &scid_len,
+                                   dcid, &dcid_len, token, &token_len) < 0) {
+                return;
+            }
+
+            std::string key(reinterpret_cast<const char*>(dcid), dcid_len);
+            auto it = connections_.find(key);
+            std::shared_ptr<QuicConnection> qc;
+            if (it != connections_.end()) {
+                qc = it->second;
+            } else {
+                // Another worker's connection ID: route the packet to its owner.
+                constexpr uint8_t kInitialPacket = 1;
+                if (type != kInitialPacket && dcid_len == kConnIdLen && dcid[0] != index_ &&
+                    dcid[0] < owner_.workers_.size()) {
+                    owner_.workers_[dcid[0]]->post_packet(std::vector<uint8_t>(data, data + length), from, from_len);
+                    return;
+                }
+                qc = accept(version, type, scid, scid_len, dcid, dcid_len, from, from_len);
+                if (!qc) return;
+            }
+
+            quiche_recv_info info{
+                const_cast<sockaddr*>(reinterpret_cast<const sockaddr*>(&from)), from_len,
+                reinterpret_cast<sockaddr*>(&local_), local_len_};
+            if (quiche_conn_recv(qc->conn, data, length, &info) < 0) {
+                return;
+            }
+            qc->peer = from;
+            qc->peer_len = from_len;
+
+            if (quiche_conn_is_established(qc->conn) || quiche_conn_is_in_early_data(qc->conn)) {
+                if (!qc->h3) {
+                    qc->h3 = quiche_h3_conn_new_with_transport(qc->conn, owner_.h3_config_);
+                }
+                if (qc->h3) poll_h3(qc);
+            }
+            dirty_.push_back(qc);
+        }
+
+        inline std::shared_ptr<QuicConnection> accept(uint32_t version, uint8_t type,
+                                                      const uint8_t* scid, size_t scid_len,
+                                                      const uint8_t* dcid, size_t dcid_len,
+                                                      const sockaddr_storage& from, socklen_t from_len) {
+            if (!quiche_version_is_supported(version)) {
+                uint8_t out[kMaxDatagramSize];
+                ssize_t written = quiche_negotiate_version(scid, scid_len, dcid, dcid_len, out, sizeof(out));
+                if (written > 0) {
+                    ::sendto(socket_.native_handle(), out, static_cast<size_t>(written), 0,
+                             reinterpret_cast<const sockaddr*>(&from), from_len);
+                }
+                return nullptr;
+            }
+            constexpr uint8_t kInitialPacket = 1;
+            if (type != kInitialPacket) return nullptr;
+
+            auto qc = std::make_shared<QuicConnection>();
+            qc->cid[0] = index_;
+            for (std::size_t i = 1; i < kConnIdLen; ++i) qc->cid[i] = static_cast<uint8_t>(rng_());
+            qc->conn = quiche_accept(qc->cid.data(), qc->cid.size(), nullptr, 0,
+                                     reinterpret_cast<sockaddr*>(&local_), local_len_,
+                                     reinterpret_cast<const sockaddr*>(&from), from_len,
+                                     owner_.quic_config_);
+            if (!qc->conn) return nullptr;
+            qc->timer = std::make_unique<asio::steady_timer>(io_);
+            qc->odcid.assign(reinterpret_cast<const char*>(dcid), dcid_len);
+            connections_[std::string(reinterpret_cast<const char*>(qc->cid.data()), qc->cid.size())] = qc;
+            connections_[qc->odcid] = qc;
+            return qc;
+        }
+
+        inline void poll_h3(const std::shared_ptr<QuicConnection>& qc) {
+            for (;;) {
+                quiche_h3_event* ev = nullptr;
+                int64_t stream_id = quiche_h3_conn_poll(qc->h3, qc->conn, &ev);
+                if (stream_id < 0) break;
+
+                auto id = static_cast<uint64_t>(stream_id);
+                switch (quiche_h3_event_type(ev)) {
+                    case QUICHE_H3_EVENT_HEADERS: {
+                        Stream& stream = qc->streams[id];
+                        stream.request.remote_address = peer_address(qc->peer);
+                        quiche_h3_event_for_each_header(ev, [](uint8_t* name, size_t name_len, uint8_t* value, size_t value_len, void* argp) -> int {
+                            Request& req = *static_cast<Request*>(argp);
+                            std::string header_name(reinterpret_cast<char*>(name), name_len);
+                            std::string header_value(reinterpret_cast<char*>(value), value_len);
+                            if (header_name == ":method") req.method = std::move(header_value);
+                            else if (header_name == ":path") req.path = std::move(header_value);
+                            else if (header_name == ":authority") req.headers["host"] = std::move(header_value);
+                            else if (!header_name.empty() && header_name[0] != ':') req.headers[std::move(header_name)] = std::move(header_value);
+                            return 0;
+                        }, &stream.request);
+                        if (quiche_h3_event_headers_has_body(ev)) {
+                            start_body(qc, id); // Dispatched on FINISHED, once the body is in
+                        } else {
+                            dispatch(qc, id);
+                        }
+                        break;
+                    }
+                    case QUICHE_H3_EVENT_DATA:
+                        receive_body(qc, id);
+                        break;
+                    case QUICHE_H3_EVENT_FINISHED: {
+                        auto it = qc->streams.find(id);
+                        if (it != qc->streams.end() && !it->second.dispatched) dispatch(qc, id);
+                        break;
+                    }
+                    case QUICHE_H3_EVENT_RESET: {
+                        auto it = qc->streams.find(id);
+                        if (it != qc->streams.end() && !it->second.dispatched) qc->streams.erase(it);
+                        break;
+                    }
+                    default:
+                        break;
+                }
+                quiche_h3_event_free(ev);
+            }
+        }
+
+        /**
+         * @brief Checks a request that announced a body. Bodies are read in
+         * full before the handler runs, as over TCP, within max_body_size and
+         * the memory budget. Encoded bodies are refused: they are only
+         * decoded on the TCP path.
+         */
+        inline void start_body(const std::shared_ptr<QuicConnection>& qc, uint64_t stream_id) {
+            Stream& stream = qc->streams[stream_id];
+            std::string_view length = stream.request.header("content-length");
+            std::size_t announced = 0;
+            std::from_chars(length.data(), length.data() + length.size(), announced);
+            std::string_view encoding = stream.request.header("content-encoding");
+            if (!encoding.empty() && !detail::iequals(encoding, "identity")) {
+                reject(qc, stream_id, 415, "Unsupported Content-Encoding");
+            } else if (announced > owner_.server_.config().max_body_size) {
+                reject(qc, stream_id, 413, "Payload Too Large");
+            }
+        }
+
+        // Appends DATA to the stream's body; drains it if the request was already answered.
+        inline void receive_body(const std::shared_ptr<QuicConnection>& qc, uint64_t stream_id) {
+            uint8_t buffer[16384];
+            auto it = qc->streams.find(stream_id);
+            ssize_t received;
+            while ((received = quiche_h3_recv_body(qc->h3, qc->conn, stream_id, buffer, sizeof(buffer))) > 0) {
+                if (it == qc->streams.end() || it->second.dispatched) continue;
+                Stream& stream = it->second;
+                std::size_t size = stream.request.body.size() + static_cast<std::size_t>(received);
+                if (size > owner_.server_.config().max_body_size ||
+                    (size > stream.body_reservation.bytes() && !stream.body_reservation.try_grow(size - stream.body_reservation.bytes()))) {
+                    log_message("WARN", fmt::format("Rejecting HTTP/3 request body on stream {}: over the size limit or memory budget", stream_id));
+                    reject(qc, stream_id, 413, "Payload Too Large");
+                    it = qc->streams.find(stream_id); // reject() may have finished and erased the stream
+                    continue;
+                }
+                stream.request.body.append(reinterpret_cast<const char*>(buffer), static_cast<std::size_t>(received));
+            }
+        }
+
+        // Answers a stream without running its handler.
+        inline void reject(const std::shared_ptr<QuicConnection>& qc, uint64_t stream_id, int status, const char* text) {
+            Stream& stream = qc->streams[stream_id];
+            stream.dispatched = true;
+            stream.request.body.clear();
+            stream.body_reservation.reset();
+            stream.response = std::make_shared<Response>();
+            stream.response->status_code = status;
+            stream.response->Text(text);
+            send_response(qc, stream_id);
+        }
+
+        /**
+         * @brief Runs the matched route on the server's scheduler and sends
+         * the result back on this worker once it is ready.
+         */
+        inline void dispatch(const std::shared_ptr<QuicConnection>& qc, uint64_t stream_id) {
+            Stream& stream = qc->streams[stream_id];
+            if (stream.dispatched) return;
+            stream.dispatched = true;
+
+            Server& server = owner_.server_;
+            if (!stream.request.id.assign(stream.request.header(server.config().request_id_header))) {
+                stream.request.id = RequestId::generate();
+            }
+            LogContext log_context(stream.request.id);
+            log_message("INFO", fmt::format("HTTP/3 Request: {} {}", stream.request.method, stream.request.path));
+
+            Route route;
+            PathStatus path_status = normalize_request_target(stream.request.path, stream.request.query);
+            if (path_status == PathStatus::Ok) {
+                route = server.get_route(stream.request);
+            } else {
+                log_message("WARN", fmt::format("Rejected HTTP/3 request target: {}", path_status_name(path_status)));
+                route.handler = [](const Request&, Response& res) {
+                    res.status_code = 400;
+                    res.Text("Bad Request");
+                };
+            }
+            stream.request.deadline = server.deadline_for(stream.request, route.options, std::chrono::steady_clock::now());
+            stream.request.session_store = server.session_store();
+            stream.response = std::make_shared<Response>();
+            if (!server.config().request_id_header.empty()) {
+                stream.response->headers[server.config().request_id_header] = stream.request.id.view();
+            }
+            if (const CorsPolicy* cors = path_status == PathStatus::Ok ? server.cors_policy(stream.request) : nullptr) {
+                std::string_view origin = stream.request.header("Origin");
+                if (CorsPolicy::is_preflight(stream.request.method, stream.request.header("Access-Control-Request-Method"))) {
+                    const CorsPolicy::Entry* entry = cors->find(origin);
+                    stream.response->status_code = entry ? 204 : 403;
+                    stream.response->headers.erase("Content-Type");
+                    stream.response->header_block = entry ? &entry->preflight_headers : cors->response_headers(origin);
+                    send_response(qc, stream_id);
+                    return;
+                }
+                stream.response->header_block = cors->response_headers(origin);
+            }
+
+            std::weak_ptr<QuicConnection> weak = qc;
+            auto request = std::make_shared<Request>(std::move(stream.request)); // Moves the body rather than copying it
+            auto response = stream.response;
+            auto complete = [handle = handle_, weak, stream_id]() {
+                std::lock_guard<std::mutex> lock(handle->mutex);
+                Worker* worker = handle->worker;
+                if (!worker) return; // Shutting down
+                asio::post(worker->io_, [worker, weak, stream_id]() {
+                    if (auto conn = weak.lock()) {
+                        worker->send_response(conn, stream_id);
+                        worker->dirty_.push_back(conn);
+                        worker->flush();
+                    }
+                });
+            };
+            PriorityClass priority = route.options.priority; // Read before route is moved into the task
+            server.get_scheduler().submit(priority, request->deadline, server.client_key(*request),
+                [request, response, route = std::move(route), complete]() {
+                    LogContext log_context(request->id);
+                    try {
+                        invoke_route(route, *request, *response);
+                    } catch (const std::exception& e) {
+                        log_message("ERROR", fmt::format("Handler threw exception for {} {}: {}", request->method, request->path, e.what()));
+                        response->status_code = 500;
+                        response->Text("Internal Server Error");
+                    }
+                    complete();
+                },
+                [response, complete]() {
+                    response->status_code = 503;
+                    response->headers["Retry-After"] = "1";
+                    response->Text("Service Unavailable");
+                    complete();
+                });
+        }
+
+        inline void send_response(const std::shared_ptr<QuicConnection>& qc, uint64_t stream_id) {
+            auto it = qc->streams.find(stream_id);
+            if (it == qc->streams.end() || !qc->h3) return;
+            Stream& stream = it->second;
+            const Response& res = *stream.response;
+
+            std::string status = std::to_string(res.status_code);
+            std::string length = std::to_string(res.body.size());
+            std::vector<quiche_h3_header> headers;
+            auto add = [&headers](const std::string& name, const std::string& value) {
+                headers.push_back({reinterpret_cast<const uint8_t*>(name.data()), name.size(),
+                                   reinterpret_cast<const uint8_t*>(value.data()), value.size()});
+            };
+            static const std::string status_name = ":status";
+            static const std::string length_name = "content-length";
+            static const std::string cookie_name = "set-cookie";
+            add(status_name, status);
+            std::vector<std::string> lowered;
+            std::vector<std::string> block_values;
+            std::size_t block_lines = res.header_block ? static_cast<std::size_t>(std::count(res.header_block->begin(), res.header_block->end(), '\n')) : 0;
+            headers.reserve(res.headers.size() + res.cookies.size() + block_lines + 2);
+            lowered.reserve(res.headers.size() + block_lines);
+            block_values.reserve(block_lines);
+            for (const auto& header : res.headers) {
+                std::string name = header.first;
+                for (auto& c : name) c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+                if (name == "connection" || name == "content-length") continue; // Not allowed / set below
+                lowered.push_back(std::move(name));
+                add(lowered.back(), header.second);
+            }
+            for (const auto& cookie : res.cookies) add(cookie_name, cookie);
+            if (res.header_block) {
+                std::string_view block = *res.header_block;
+                while (!block.empty()) {
+                    std::size_t end = block.find("\r\n");
+                    std::string_view line = block.substr(0, end);
+                    block.remove_prefix(end == std::string_view::npos ? block.size() : end + 2);
+                    std::size_t colon = line.find(':');
+                    if (colon == std::string_view::npos) continue;
+                    std::string name(line.substr(0, colon));
+                    for (auto& c : name) c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+                    lowered.push_back(std::move(name));
+                    block_values.emplace_back(line.substr(std::min(line.size(), colon + 2)));
+                    add(lowered.back(), block_values.back());
+                }
+            }
+            add(length_name, length);
+
+            stream.response_ready = true;
+            int rc = quiche_h3_send_response(qc->h3, qc->conn, stream_id, headers.data(), headers.size(), res.body.empty());
+            if (rc == QUICHE_H3_ERR_STREAM_BLOCKED || rc == QUICHE_H3_ERR_DONE) {
+                return; // No room on the stream yet; flush() retries once the peer grants more
+            }
+            if (rc < 0) {
+                log_message("WARN", fmt::format("HTTP/3 response on stream {} failed ({}), dropping it", stream_id, rc));
+                qc->streams.erase(it);
+                return;
+            }
+            stream.headers_sent = true;
+            stream.pending_body = res.body;
+            continue_body(qc, stream_id);
+        }
+
+        // Pushes as much of the pending body as flow control allows.
+        inline void continue_body(const std::shared_ptr<QuicConnection>& qc, uint64_t stream_id) {
+            auto it = qc->streams.find(stream_id);
+            if (it == qc->streams.end()) return;
+            Stream& stream = it->second;
+            if (stream.body_offset < stream.pending_body.size()) {
+                ssize_t written = quiche_h3_send_body(qc->h3, qc->conn, stream_id,
+                    reinterpret_cast<const uint8_t*>(stream.pending_body.data()) + stream.body_offset,
+                    stream.pending_body.size() - stream.body_offset, true);
+                if (written > 0) stream.body_offset += static_cast<std::size_t>(written);
+            }
+            if (stream.headers_sent && stream.body_offset >= stream.pending_body.size()) {
+                qc->streams.erase(it);
+            }
+        }
+
+        /**
+         * @brief Sends everything the dirty connections have queued. Packets
+         * of one connection are coalesced into GSO buffers, and all buffers
+         * go out in one sendmmsg.
+         */
+        inline void flush() {
+            if (dirty_.empty()) return;
+            static thread_local std::vector<uint8_t> out(kRecvBatch * kMaxGsoSegments * kMaxDatagramSize);
+            std::vector<mmsghdr> msgs;
+            std::vector<iovec> iovs;
+            std::vector<std::array<char, CMSG_SPACE(sizeof(uint16_t))>> controls;
+            msgs.reserve(kRecvBatch);
+            iovs.reserve(kRecvBatch);
+            controls.reserve(kRecvBatch);
+            std::size_t used = 0;
+
+            auto send_all = [&]() {
+                std::size_t sent = 0;
+                while (sent < msgs.size()) {
+                    int n = ::sendmmsg(socket_.native_handle(), msgs.data() + sent, static_cast<unsigned>(msgs.size() - sent), 0);
+                    if (n <= 0) {
+                        if (errno == EIO || errno == EINVAL) gso_ = false; // No GSO support on this path
+                        break;
+                    }
+                    sent += static_cast<std::size_t>(n);
+                }
+                msgs.clear();
+                iovs.clear();
+                controls.clear();
+                used = 0;
+            };
+
+            std::vector<std::shared_ptr<QuicConnection>> dirty;
+            dirty.swap(dirty_);
+            for (auto& qc : dirty) {
+                if (!qc->conn) continue;
+                if (qc->h3) {
+                    // Resume responses and bodies that were blocked on flow control.
+                    std::vector<std::pair<uint64_t, bool>> ids;
+                    for (const auto& stream : qc->streams) {
+                        if (stream.second.response_ready) ids.emplace_back(stream.first, stream.second.headers_sent);
+                    }
+                    for (const auto& [id, headers_sent] : ids) {
+                        if (headers_sent) continue_body(qc, id);
+                        else send_response(qc, id);
+                    }
+                }
+
+                for (;;) {
+                    if (msgs.size() == kRecvBatch || used + kMaxGsoSegments * kMaxDatagramSize > out.size()) send_all();
+
+                    // Fill one GSO buffer: equal-size packets, only the last may be shorter.
+                    uint8_t* start = out.data() + used;
+                    std::size_t segment = 0;
+                    std::size_t total = 0;
+                    std::size_t segments = 0;
+                    std::size_t max_segments = gso_ ? kMaxGsoSegments : 1;
+                    quiche_send_info send_info;
+                    while (segments < max_segments) {
+                        ssize_t written = quiche_conn_send(qc->conn, start + total, kMaxDatagramSize, &send_info);
+                        if (written <= 0) break;
+                        if (segments == 0) segment = static_cast<std::size_t>(written);
+                        total += static_cast<std::size_t>(written);
+                        ++segments;
+                        if (static_cast<std::size_t>(written) < segment) break; // Short packet ends the buffer
+                    }
+                    if (segments == 0) break;
+
+                    iovs.push_back({start, total});
+                    msgs.push_back({});
+                    msghdr& hdr = msgs.back().msg_hdr;
+                    hdr.msg_name = &qc->peer;
+                    hdr.msg_namelen = qc->peer_len;
+                    hdr.msg_iov = &iovs.back();
+                    hdr.msg_iovlen = 1;
+                    if (segments > 1) {
+                        controls.emplace_back();
+                        hdr.msg_control = controls.back().data();
+                        hdr.msg_controllen = controls.back().size();
+                        cmsghdr* c = CMSG_FIRSTHDR(&hdr);
+                        c->cmsg_level = SOL_UDP;
+                        c->cmsg_type = UDP_SEGMENT;
+                        c->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+                        auto gso_size = static_cast<uint16_t>(segment);
+                        std::memcpy(CMSG_DATA(c), &gso_size, sizeof(gso_size));
+                    }
+                    used += total;
+                    if (segments < max_segments) break; // quiche has nothing more right now
+                }
+                arm_timer(qc);
+            }
+            send_all();
+        }
+
+        inline void arm_timer(const std::shared_ptr<QuicConnection>& qc) {
+            if (quiche_conn_is_closed(qc->conn)) {
+                close(qc);
+                return;
+            }
+            uint64_t timeout_ms = quiche_conn_timeout_as_millis(qc->conn);
+            if (timeout_ms == UINT64_MAX) return;
+            qc->timer->expires_after(std::chrono::milliseconds(timeout_ms));
+            std::weak_ptr<QuicConnection> weak = qc;
+            qc->timer->async_wait([this, weak](asio::error_code ec) {
+                auto conn = weak.lock();
+                if (ec || !conn) return;
+                quiche_conn_on_timeout(conn->conn);
+                dirty_.push_back(conn);
+                flush();
+            });
+        }
+
+        inline void close(const std::shared_ptr<QuicConnection>& qc) {
+            qc->timer->cancel();
+            connections_.erase(std::string(reinterpret_cast<const char*>(qc->cid.data()), qc->cid.size()));
+            connections_.erase(qc->odcid);
+        }
+
+        static inline std::string peer_address(const sockaddr_storage& addr) {
+            char text[INET6_ADDRSTRLEN] = {};
+            if (addr.ss_family == AF_INET) {
+                ::inet_ntop(AF_INET, &reinterpret_cast<const sockaddr_in&>(addr).sin_addr, text, sizeof(text));
+            } else if (addr.ss_family == AF_INET6) {
+                ::inet_ntop(AF_INET6, &reinterpret_cast<const sockaddr_in6&>(addr).sin6_addr, text, sizeof(text));
+            }
+            return text;
+        }
+
+        Http3Listener& owner_;
+        uint8_t index_;
+        asio::io_context io_;
+        asio::ip::udp::socket socket_;
+        sockaddr_storage local_{};
+        socklen_t local_len_ = 0;
+        bool gro_ = false;
+        bool gso_ = false;
+        std::mt19937 rng_;
+        std::shared_ptr<WorkerHandle> handle_; // Shared with in-flight handler completions
+        std::unordered_map<std::string, std::shared_ptr<QuicConnection>> connections_;
+        std::vector<std::shared_ptr<QuicConnection>> dirty_; // Connections with output to flush
+        std::thread thread_;
+    };
+
+    Server& server_;
+    std::string host_;
+    Http3Config config_;
+    quiche_config* quic_config_ = nullptr;
+    quiche_h3_config* h3_config_ = nullptr;
+    std::vector<std::unique_ptr<Worker>> workers_;
+};
+
+} // namespace Haka
+
+#endif // HAKA_ENABLE_HTTP3 && __linux__
+
+#endif // HAKA_HTTP3_HPP
@@ -0,0 +1,277 @@
+#ifndef HAKA_INFLATE_HPP
+#define HAKA_INFLATE_HPP
+
+#if defined(HAKA_ENABLE_ZLIB)
+
+// Project includes
+#include "haka/memory_budget.hpp" // For MemoryReservation
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <zlib.h>
+
+namespace Haka {
+
+/**
+ * @brief Result of feeding compressed body bytes to a BodyInflater.
+ */
+enum class InflateStatus : uint8_t {
+    NeedMore,    // All input consumed, the stream continues
+    Done,        // finish(): the stream ended cleanly
+    BadData,     // Corrupt, truncated, or trailing garbage (400)
+    TooLarge,    // Over the size or ratio limit (413)
+    OutOfMemory  // Memory budget exhausted, or zlib could not allocate (413)
+};
+
+inline const char* inflate_status_name(InflateStatus status) {
+    switch (status) {
+        case InflateStatus::NeedMore: return "need more";
+        case InflateStatus::Done: return "done";
+        case InflateStatus::BadData: return "corrupt or truncated data";
+        case InflateStatus::TooLarge: return "over the decompressed size or ratio limit";
+        case InflateStatus::OutOfMemory: return "out of memory";
+    }
+    return "unknown";
+}
+
+/**
+ * @brief Bounds on what a compressed body may expand to.
+ */
+struct InflateLimits {
+    // Largest decompressed body.
+    std::size_t max_output = 32 * 1024 * 1024;
+    // Largest decompressed/compressed ratio, checked once the output passes
+    // 1 MiB (small bodies legitimately compress very well).
+    std::size_t max_ratio = 100;
+};
+
+namespace detail {
+
+struct InflateStreamDeleter {
+    inline void operator()(z_stream* stream) const {
+        inflateEnd(stream);
+        delete stream;
+    }
+};
+
+using InflateStream = std::unique_ptr<z_stream, InflateStreamDeleter>;
+
+/**
+ * @brief Per-thread cache of zlib inflate states. Setting one up allocates
+ * about 7 KiB of state plus a 32 KiB window; inflateReset2 reuses both, so
+ * a thread decoding many bodies allocates them only a few times.
+ */
+class InflateStreamPool {
+public:
+    static constexpr std::size_t kMaxCached = 16;
+
+    static inline InflateStream acquire(int window_bits) {
+        auto& cached = local();
+        while (!cached.empty()) {
+            InflateStream stream = std::move(cached.back());
+            cached.pop_back();
+            if (inflateReset2(stream.get(), window_bits) == Z_OK) return stream;
+        }
+        InflateStream stream(new z_stream{});
+        if (inflateInit2(stream.get(), window_bits) != Z_OK) {
+            delete stream.release(); // Not initialized, so no inflateEnd
+            return nullptr;
+        }
+        return stream;
+    }
+
+    static inline void release(InflateStream stream) {
+        auto& cached = local();
+        if (stream && cached.size() < kMaxCached) cached.push_back(std::move(stream));
+    }
+
+private:
+    static inline std::vector<InflateStream>& local() {
+        thread_local std::vector<InflateStream> cached;
+        return cached;
+    }
+};
+
+} // namespace detail
+
+/**
+ * @brief Decompresses a gzip or deflate request body incrementally, as its
+ * bytes arrive, into a string. Each call to update() takes whatever was read
+ * since the last call. Output size and expansion ratio are checked as the
+ * output grows, so a decompression bomb is stopped after producing at most
+ * the limit rather than after exhausting memory.
+ *
+ * "deflate" is the zlib format per RFC 9110, but raw deflate streams (sent by
+ * some clients) are recognized from their first bytes and accepted too.
+ * Concatenated gzip members are decoded as one body, as gzip(1) does.
+ */
+class BodyInflater {
+public:
+    enum class Coding : uint8_t { Identity, Gzip, Deflate, Unsupported };
+
+    /**
+     * @brief Maps a Content-Encoding header value to a coding. Only a single
+     * coding is supported; lists such as "gzip, gzip" are Unsupported.
+     */
+    static inline Coding coding(std::string_view content_encoding) {
+        while (!content_encoding.empty() && (content_encoding.back() == ' ' || content_encoding.back() == '\t')) {
+            content_encoding.remove_suffix(1);
+        }
+        auto is = [&](std::string_view name) {
+            if (content_encoding.size() != name.size()) return false;
+            for (std::size_t i = 0; i < name.size(); ++i) {
+                char c = content_encoding[i];
+                if ((c >= 'A' && c <= 'Z' ? static_cast<char>(c | 0x20) : c) != name[i]) return false;
+            }
+            return true;
+        };
+        if (content_encoding.empty() || is("identity")) return Coding::Identity;
+        if (is("gzip") || is("x-gzip")) return Coding::Gzip;
+        if (is("deflate")) return Coding::Deflate;
+        return Coding::Unsupported;
+    }
+
+    inline BodyInflater(Coding coding, InflateLimits limits) : coding_(coding), limits_(limits) {}
+
+    inline ~BodyInflater() {
+        detail::InflateStreamPool::release(std::move(stream_));
+    }
+
+    BodyInflater(const BodyInflater&) = delete;
+    BodyInflater& operator=(const BodyInflater&) = delete;
+
+    /**
+     * @brief Decompresses the next piece of the body.
+     * @param data Compressed bytes received since the last call.
+     * @param size Their length.
+     * @param out Receives the decompressed bytes (appended).
+     * @param reservation Grown before `out` is; failure yields OutOfMemory.
+     * @return NeedMore, or the reason decoding stopped.
+     */
+    inline InflateStatus update(const char* data, std::size_t size, std::string& out, MemoryReservation& reservation) {
+        if (failed_ != InflateStatus::NeedMore) return failed_;
+        if (!stream_) {
+            // Raw deflate is told apart from zlib by the zlib header check, so
+            // wait for its first two bytes.
+            if (coding_ == Coding::Deflate && header_.size() + size < 2) {
+                header_.append(data, size);
+                return InflateStatus::NeedMore;
+            }
+            if (!start(data)) return fail(InflateStatus::OutOfMemory);
+            if (!header_.empty()) {
+                InflateStatus status = feed(header_.data(), header_.size(), out, reservation);
+                std::string().swap(header_);
+                if (status != InflateStatus::NeedMore) return status;
+            }
+        }
+        return feed(data, size, out, reservation);
+    }
+
+    /**
+     * @brief Called once the whole compressed body has been fed.
+     * @return Done if the stream ended exactly there, BadData if it was cut
+     * short, or the earlier failure.
+     */
+    inline InflateStatus finish() {
+        if (failed_ != InflateStatus::NeedMore) return failed_;
+        return ended_ ? InflateStatus::Done : fail(InflateStatus::BadData);
+    }
+
+    inline std::size_t consumed() const { return consumed_; }
+    inline std::size_t produced() const { return produced_; }
+
+private:
+    static constexpr std::size_t kOutputStep = 16 * 1024;
+    static constexpr std::size_t kRatioFloor = 1024 * 1024;
+
+    inline bool start(const char* data) {
+        int window_bits = 15 + 16; // gzip
+        if (coding_ == Coding::Deflate) {
+            // header_ holds at most the first byte; the rest is in data.
+            unsigned char b0 = static_cast<unsigned char>(header_.empty() ? data[0] : header_[0]);
+            unsigned char b1 = static_cast<unsigned char>(header_.empty() ? data[1] : data[0]);
+            bool zlib_header = (b0 & 0x0F) == Z_DEFLATED && ((b0 << 8) | b1) % 31 == 0;
+            window_bits = zlib_header ? 15 : -15;
+        }
+        stream_ = detail::InflateStreamPool::acquire(window_bits);
+        return stream_ != nullptr;
+    }
+
+    inline InflateStatus feed(const char* data, std::size_t size, std::string& out, MemoryReservation& reservation) {
+        z_stream& z = *stream_;
+        z.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data));
+        z.avail_in = 0;
+        bool output_full = false; // inflate() may hold more output than fit last time
+        while (size > 0 || z.avail_in > 0 || output_full) {
+            if (z.avail_in == 0) {
+                // zlib counts in uInt; feed oversized input in pieces.
+                z.avail_in = static_cast<uInt>(std::min<std::size_t>(size, 1u << 30));
+                size -= z.avail_in;
+            }
+            if (ended_) {
+                if (z.avail_in == 0) break;
+                // Input after the end of the stream: another gzip member, or garbage.
+                if (coding_ != Coding::Gzip || inflateReset(&z) != Z_OK) return fail(InflateStatus::BadData);
+                ended_ = false;
+            }
+            if (out.size() == out.capacity()) {
+                std::size_t grow = std::min(std::max(out.capacity(), kOutputStep), limits_.max_output + 1 - produced_);
+                if (!reservation.try_grow(grow)) return fail(InflateStatus::OutOfMemory);
+                out.reserve(out.size() + grow);
+            }
+            std::size_t before = out.size();
+            out.resize(out.capacity());
+            z.next_out = reinterpret_cast<Bytef*>(out.data() + before);
+            z.avail_out = static_cast<uInt>(std::min<std::size_t>(out.size() - before, 1u << 30));
+            uInt in_before = z.avail_in;
+            uInt out_before = z.avail_out;
+            int rc = inflate(&z, Z_NO_FLUSH);
+            std::size_t written = out_before - z.avail_out;
+            out.resize(before + written);
+            consumed_ += in_before - z.avail_in;
+            produced_ += written;
+            output_full = z.avail_out == 0;
+            if (rc == Z_STREAM_END) {
+                ended_ = true;
+                output_full = false;
+            } else if (rc == Z_MEM_ERROR) {
+                return fail(InflateStatus::OutOfMemory);
+            } else if (rc == Z_BUF_ERROR && z.avail_in == 0) {
+                output_full = false; // Nothing pending after all
+            } else if (rc != Z_OK) {
+                return fail(InflateStatus::BadData);
+            }
+            if (produced_ > limits_.max_output ||
+                (produced_ > kRatioFloor && produced_ / std::max<std::size_t>(consumed_, 1) > limits_.max_ratio)) {
+                return fail(InflateStatus::TooLarge);
+            }
+        }
+        return InflateStatus::NeedMore;
+    }
+
+    inline InflateStatus fail(InflateStatus status) {
+        failed_ = status;
+        return status;
+    }
+
+    Coding coding_;
+    InflateLimits limits_;
+    detail::InflateStream stream_; // From the thread's pool, set up on the first bytes
+    std::string header_;           // First byte of a deflate body, until the second arrives
+    bool ended_ = false;           // The last inflate() reached the end of a stream
+    InflateStatus failed_ = InflateStatus::NeedMore;
+    std::size_t consumed_ = 0;
+    std::size_t produced_ = 0;
+};
+
+} // namespace Haka
+
+#endif // HAKA_ENABLE_ZLIB
+
+#endif // HAKA_INFLATE_HPP
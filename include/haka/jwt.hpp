@@ -0,0 +1,563 @@
+#ifndef HAKA_JWT_HPP
+#define HAKA_JWT_HPP
+
+#if defined(HAKA_ENABLE_JWT)
+
+// Project includes
+#include "haka/core.hpp"          // For Request, Response, RouteFilter, log_message
+#include "haka/metrics.hpp"       // For append_metric
+#include "haka/memory_budget.hpp" // For accounting cached claims
+
+#include <array>
+#include <atomic>
+#include <charconv>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include <openssl/bio.h>
+#include <openssl/bn.h>
+#include <openssl/ecdsa.h>
+#include <openssl/evp.h>
+#include <openssl/pem.h>
+
+namespace Haka {
+
+/**
+ * @brief Why a token was refused.
+ */
+enum class JwtError : uint8_t {
+    None,
+    Missing,              // No "Authorization: Bearer" header
+    Malformed,            // Not three base64url parts of JSON
+    UnsupportedAlgorithm, // Not RS256/ES256, or not the algorithm of the key
+    UnknownKey,           // "kid" not registered
+    BadSignature,
+    Expired,
+    NotYetValid,
+    WrongIssuer,
+    WrongAudience
+};
+
+inline const char* jwt_error_name(JwtError error) {
+    switch (error) {
+        case JwtError::None: return "none";
+        case JwtError::Missing: return "missing token";
+        case JwtError::Malformed: return "malformed token";
+        case JwtError::UnsupportedAlgorithm: return "unsupported algorithm";
+        case JwtError::UnknownKey: return "unknown key";
+        case JwtError::BadSignature: return "bad signature";
+        case JwtError::Expired: return "token expired";
+        case JwtError::NotYetValid: return "token not yet valid";
+        case JwtError::WrongIssuer: return "wrong issuer";
+        case JwtError::WrongAudience: return "wrong audience";
+    }
+    return "unknown";
+}
+
+namespace detail {
+
+inline std::string_view json_skip_ws(std::string_view s) {
+    while (!s.empty() && (s.front() == ' ' || s.front() == '\t' || s.front() == '\n' || s.front() == '\r')) s.remove_prefix(1);
+    return s;
+}
+
+// Length of the JSON value at the start of s (string, number, literal,
+// object or array), or npos if it is malformed.
+inline std::size_t json_value_length(std::string_view s) {
+    if (s.empty()) return std::string_view::npos;
+    if (s.front() == '"') {
+        for (std::size_t i = 1; i < s.size(); ++i) {
+            if (s[i] == '\\') ++i;
+            else if (s[i] == '"') return i + 1;
+        }
+        return std::string_view::npos;
+    }
+    if (s.front() == '{' || s.front() == '[') {
+        int depth = 0;
+        for (std::size_t i = 0; i < s.size(); ++i) {
+            char c = s[i];
+            if (c == '"') {
+                std::size_t n = json_value_length(s.substr(i));
+                if (n == std::string_view::npos) return n;
+                i += n - 1;
+            } else if (c == '{' || c == '[') {
+                ++depth;
+            } else if (c == '}' || c == ']') {
+                if (--depth == 0) return i + 1;
+            }
+        }
+        return std::string_view::npos;
+    }
+    std::size_t i = 0;
+    while (i < s.size() && s[i] != ',' && s[i] != '}' && s[i] != ']' && s[i] != ' ' && s[i] != '\n' && s[i] != '\r' && s[i] != '\t') ++i;
+    return i == 0 ? std::string_view::npos : i;
+}
+
+/**
+ * @brief Finds a top-level member of a JSON object without parsing the rest.
+ * @return The raw value: string contents without quotes (escapes kept),
+ * other values as written. nullopt if absent or the JSON is malformed.
+ */
+inline std::optional<std::string_view> json_member(std::string_view json, std::string_view name) {
+    std::string_view s = json_skip_ws(json);
+    if (s.empty() || s.front() != '{') return std::nullopt;
+    s.remove_prefix(1);
+    for (;;) {
+        s = json_skip_ws(s);
+        if (s.empty() || s.front() != '"') return std::nullopt;
+        std::size_t key_length = json_value_length(s);
+        if (key_length == std::string_view::npos) return std::nullopt;
+        std::string_view key = s.substr(1, key_length - 2);
+        s = json_skip_ws(s.substr(key_length));
+        if (s.empty() || s.front() != ':') return std::nullopt;
+        s = json_skip_ws(s.substr(1));
+        std::size_t value_length = json_value_length(s);
+        if (value_length == std::string_view::npos) return std::nullopt;
+        if (key == name) {
+            std::string_view value = s.substr(0, value_length);
+            if (value.front() == '"') value = value.substr(1, value.size() - 2);
+            return value;
+        }
+        s = json_skip_ws(s.substr(value_length));
+        if (s.empty() || s.front() != ',') return std::nullopt;
+        s.remove_prefix(1);
+    }
+}
+
+inline std::optional<int64_t> json_integer(std::optional<std::string_view> raw) {
+    if (!raw) return std::nullopt;
+    int64_t value = 0;
+    auto result = std::from_chars(raw->data(), raw->data() + raw->size(), value);
+    if (result.ec != std::errc()) return std::nullopt;
+    return value; // NumericDate may carry a fraction; the integer part is enough
+}
+
+inline bool base64url_decode(std::string_view in, std::string& out) {
+    static constexpr auto table = [] {
+        std::array<int8_t, 256> t{};
+        for (auto& v : t) v = -1;
+        const char* alphabet = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789-_";
+        for (int i = 0; i < 64; ++i) t[static_cast<unsigned char>(alphabet[i])] = static_cast<int8_t>(i);
+        return t;
+    }();
+    out.clear();
+    out.reserve(in.size() * 3 / 4);
+    uint32_t buffer = 0;
+    int bits = 0;
+    for (char c : in) {
+        int8_t v = table[static_cast<unsigned char>(c)];
+        if (v < 0) return false;
+        buffer = (buffer << 6) | static_cast<uint32_t>(v);
+        bits += 6;
+        if (bits >= 8) {
+            bits -= 8;
+            out.push_back(static_cast<char>((buffer >> bits) & 0xFF));
+        }
+    }
+    return bits < 6; // A single leftover character cannot encode a byte
+}
+
+} // namespace detail
+
+/**
+ * @brief The verified claims of a token. The payload is kept as JSON and
+ * members are located on access, so a handler only pays for the claims it
+ * reads; the registered time claims are extracted once at verification.
+ */
+class JwtClaims {
+public:
+    inline JwtClaims(std::string payload, int64_t expires) : payload_(std::move(payload)), expires_(expires) {}
+
+    /**
+     * @brief Looks up a top-level claim.
+     * @param name Claim name (e.g., "sub", "scope").
+     * @return The raw value: string contents without quotes (JSON escapes
+     * are not decoded), other values as written; empty if absent.
+     */
+    inline std::string_view claim(std::string_view name) const {
+        return detail::json_member(payload_, name).value_or(std::string_view{});
+    }
+
+    inline std::optional<int64_t> integer_claim(std::string_view name) const {
+        return detail::json_integer(detail::json_member(payload_, name));
+    }
+
+    inline std::string_view subject() const { return claim("sub"); }
+    inline std::string_view issuer() const { return claim("iss"); }
+
+    inline std::chrono::system_clock::time_point expires_at() const {
+        return std::chrono::system_clock::time_point(std::chrono::seconds(expires_));
+    }
+
+    // The payload JSON, for handlers that want to parse it fully.
+    inline const std::string& json() const { return payload_; }
+
+private:
+    std::string payload_;
+    int64_t expires_;
+};
+
+/**
+ * @brief Settings for JwtVerifier.
+ */
+struct JwtConfig {
+    std::string issuer;   // Required "iss" value; empty accepts any
+    std::string audience; // Must appear in "aud"; empty skips the check
+    // Clock skew tolerated for "exp" and "nbf".
+    std::chrono::seconds leeway{30};
+    // Verified tokens remembered until they expire, split over shards so
+    // handler threads rarely contend on a lock.
+    std::size_t cache_capacity = 65536;
+    std::size_t cache_shards = 16;
+};
+
+/**
+ * @brief Verifies RS256 and ES256 bearer tokens against registered public
+ * keys. Verified tokens are cached by SHA-256 hash until they expire, so a
+ * client reusing its token costs one hash and one lookup instead of a
+ * signature check. Thread-safe once keys are added.
+ */
+class JwtVerifier {
+public:
+    inline explicit JwtVerifier(JwtConfig config = {}) : config_(std::move(config)) {
+        config_.cache_shards = std::max<std::size_t>(1, config_.cache_shards);
+        shards_ = std::vector<Shard>(config_.cache_shards);
+        shard_capacity_ = std::max<std::size_t>(1, config_.cache_capacity / config_.cache_shards);
+        shrinker_id_ = memory_budget().add_shrinker("jwt", [this](std::size_t target) { return shrink(target); });
+    }
+
+    inline ~JwtVerifier() {
+        memory_budget().remove_shrinker(shrinker_id_);
+        for (auto& key : keys_) EVP_PKEY_free(key.second.pkey);
+        memory_budget().release(MemorySubsystem::Caches, cached_bytes_.load(std::memory_order_relaxed));
+    }
+
+    JwtVerifier(const JwtVerifier&) = delete;
+    JwtVerifier& operator=(const JwtVerifier&) = delete;
+
+    /**
+     * @brief Registers a public key. Its type decides the algorithm: RSA keys
+     * verify RS256, P-256 EC keys verify ES256. Call before serving traffic.
+     * @param kid Key ID matched against the token header's "kid"; a token
+     * without "kid" is checked against the key registered as "".
+     * @param pem The key in PEM ("BEGIN PUBLIC KEY") format.
+     * @throws std::runtime_error if the key cannot be read or is unsupported.
+     */
+    inline void add_key(const std::string& kid, std::string_view pem) {
+        BIO* bio = BIO_new_mem_buf(pem.data(), static_cast<int>(pem.size()));
+        EVP_PKEY* pkey = bio ? PEM_read_bio_PUBKEY(bio, nullptr, nullptr, nullptr) : nullptr;
+        BIO_free(bio);
+        if (!pkey) {
+            throw std::runtime_error("JWT: cannot read public key '" + kid + "'");
+        }
+        Key key{pkey, ""};
+        if (EVP_PKEY_base_id(pkey) == EVP_PKEY_RSA) {
+            key.algorithm = "RS256";
+        } else if (EVP_PKEY_base_id(pkey) == EVP_PKEY_EC && is_p256(pkey)) {
+            key.algorithm = "ES256";
+        } else {
+            EVP_PKEY_free(pkey);
+            throw std::runtime_error("JWT: key '" + kid + "' is neither RSA nor P-256");
+        }
+        auto it = keys_.find(kid);
+        if (it != keys_.end()) EVP_PKEY_free(it->second.pkey);
+        keys_[kid] = key;
+        log_message("INFO", fmt::format("JWT: registered {} key '{}'", key.algorithm, kid));
+    }
+
+    /**
+     * @brief Verifies a compact-serialized token.
+     * @param token The token (without "Bearer ").
+     * @param error Receives the reason when the token is refused.
+     * @return The claims, or null if the token is refused.
+     */
+    inline std::shared_ptr<const JwtClaims> verify(std::string_view token, JwtError& error) {
+        error = JwtError::None;
+        CacheKey key = hash(token);
+        Shard& shard = shards_[key[8] % shards_.size()];
+        int64_t now = std::chrono::duration_cast<std::chrono::seconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
+        {
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            auto it = shard.index.find(key);
+            if (it != shard.index.end()) {
+                auto node = it->second;
+                if (node->claims->expires_at().time_since_epoch() / std::chrono::seconds(1) + config_.leeway.count() > now) {
+                    shard.lru.splice(shard.lru.begin(), shard.lru, node);
+                    hits_.fetch_add(1, std::memory_order_relaxed);
+                    return node->claims;
+                }
+                evict(shard, node);
+                error = JwtError::Expired;
+                rejected_.fetch_add(1, std::memory_order_relaxed);
+                return nullptr;
+            }
+        }
+        misses_.fetch_add(1, std::memory_order_relaxed);
+
+        std::shared_ptr<const JwtClaims> claims = verify_uncached(token, now, error);
+        if (!claims) {
+            rejected_.fetch_add(1, std::memory_order_relaxed);
+            return nullptr;
+        }
+        // Reserved before locking: reserving can run the shrinkers, which lock shards.
+        std::size_t bytes = sizeof(Node) + claims->json().capacity() + sizeof(JwtClaims) + 64;
+        memory_budget().reserve(MemorySubsystem::Caches, bytes);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        if (shard.index.count(key)) { // Another thread verified it meanwhile
+            memory_budget().release(MemorySubsystem::Caches, bytes);
+            return claims;
+        }
+        cached_bytes_.fetch_add(bytes, std::memory_order_relaxed);
+        while (shard.lru.size() >= shard_capacity_) {
+            evict(shard, std::prev(shard.lru.end()));
+        }
+        shard.lru.push_front(Node{key, claims, bytes});
+        shard.index.emplace(key, shard.lru.begin());
+        return claims;
+    }
+
+    /**
+     * @brief Appends cache and verification counters in Prometheus text format.
+     * @param out The buffer to append to.
+     */
+    inline void collect_metrics(std::string& out) const {
+        out += "# TYPE haka_jwt_cache_hits_total counter\n";
+        append_metric(out, "haka_jwt_cache_hits_total", "", hits_.load(std::memory_order_relaxed));
+        out += "# TYPE haka_jwt_verifications_total counter\n";
+        append_metric(out, "haka_jwt_verifications_total", "", misses_.load(std::memory_order_relaxed));
+        out += "# TYPE haka_jwt_rejected_total counter\n";
+        append_metric(out, "haka_jwt_rejected_total", "", rejected_.load(std::memory_order_relaxed));
+        out += "# TYPE haka_jwt_cache_bytes gauge\n";
+        append_metric(out, "haka_jwt_cache_bytes", "", cached_bytes_.load(std::memory_order_relaxed));
+    }
+
+private:
+    using CacheKey = std::array<uint8_t, 32>;
+
+    struct CacheKeyHash {
+        inline std::size_t operator()(const CacheKey& key) const {
+            std::size_t h;
+            std::memcpy(&h, key.data(), sizeof(h)); // Already uniformly distributed
+            return h;
+        }
+    };
+
+    struct Node {
+        CacheKey key;
+        std::shared_ptr<const JwtClaims> claims;
+        std::size_t bytes;
+    };
+
+    struct Shard {
+        std::mutex mutex;
+        std::list<Node> lru; // Most recently used first
+        std::unordered_map<CacheKey, std::list<Node>::iterator, CacheKeyHash> index;
+    };
+
+    struct Key {
+        EVP_PKEY* pkey;
+        std::string algorithm;
+    };
+
+    static inline CacheKey hash(std::string_view token) {
+        CacheKey key{};
+        unsigned int length = 0;
+        EVP_Digest(token.data(), token.size(), key.data(), &length, EVP_sha256(), nullptr);
+        return key;
+    }
+
+    static inline bool is_p256(EVP_PKEY* pkey) {
+        char name[64];
+        std::size_t length = 0;
+        return EVP_PKEY_get_group_name(pkey, name, sizeof(name), &length) == 1 &&
+               std::string_view(name, length) == "prime256v1";
+    }
+
+    // Memory budget shrinker: evicts least recently used tokens, skipping
+    // shards that are busy (this may run on a thread holding one).
+    inline std::size_t shrink(std::size_t target) {
+        std::size_t freed = 0;
+        bool evicted = true;
+        while (freed < target && evicted) {
+            evicted = false;
+            for (auto& shard : shards_) {
+                std::unique_lock<std::mutex> lock(shard.mutex, std::try_to_lock);
+                if (!lock.owns_lock() || shard.lru.empty()) continue;
+                freed += shard.lru.back().bytes;
+                evict(shard, std::prev(shard.lru.end()));
+                evicted = true;
+                if (freed >= target) break;
+            }
+        }
+        return freed;
+    }
+
+    // Called with the shard's mutex held.
+    inline void evict(Shard& shard, std::list<Node>::iterator node) {
+        memory_budget().release(MemorySubsystem::Caches, node->bytes);
+        cached_bytes_.fetch_sub(node->bytes, std::memory_order_relaxed);
+        shard.index.erase(node->key);
+        shard.lru.erase(node);
+    }
+
+    inline std::shared_ptr<const JwtClaims> verify_uncached(std::string_view token, int64_t now, JwtError& error) const {
+        std::size_t first = token.find('.');
+        std::size_t second = first == std::string_view::npos ? first : token.find('.', first + 1);
+        if (second == std::string_view::npos || token.find('.', second + 1) != std::string_view::npos) {
+            error = JwtError::Malformed;
+            return nullptr;
+        }
+        std::string header, payload, signature;
+        if (!detail::base64url_decode(token.substr(0, first), header) ||
+            !detail::base64url_decode(token.substr(first + 1, second - first - 1), payload) ||
+            !detail::base64url_decode(token.substr(second + 1), signature)) {
+            error = JwtError::Malformed;
+            return nullptr;
+        }
+
+        auto algorithm = detail::json_member(header, "alg");
+        if (!algorithm) {
+            error = JwtError::Malformed;
+            return nullptr;
+        }
+        auto kid = detail::json_member(header, "kid");
+        auto key = keys_.find(std::string(kid.value_or(std::string_view{})));
+        if (key == keys_.end()) {
+            error = JwtError::UnknownKey;
+            return nullptr;
+        }
+        // The key decides the algorithm; the header only has to agree (no "none", no RS/HS confusion).
+        if (*algorithm != key->second.algorithm) {
+            error = JwtError::UnsupportedAlgorithm;
+            return nullptr;
+        }
+        if (!verify_signature(key->second, token.substr(0, second), signature)) {
+            error = JwtError::BadSignature;
+            return nullptr;
+        }
+
+        auto expires = detail::json_integer(detail::json_member(payload, "exp"));
+        if (!expires) {
+            error = JwtError::Malformed; // Tokens without "exp" could be cached forever
+            return nullptr;
+        }
+        if (*expires + config_.leeway.count() <= now) {
+            error = JwtError::Expired;
+            return nullptr;
+        }
+        auto not_before = detail::json_integer(detail::json_member(payload, "nbf"));
+        if (not_before && *not_before - config_.leeway.count() > now) {
+            error = JwtError::NotYetValid;
+            return nullptr;
+        }
+        if (!config_.issuer.empty() && detail::json_member(payload, "iss").value_or(std::string_view{}) != config_.issuer) {
+            error = JwtError::WrongIssuer;
+            return nullptr;
+        }
+        if (!config_.audience.empty() && !audience_matches(detail::json_member(payload, "aud"))) {
+            error = JwtError::WrongAudience;
+            return nullptr;
+        }
+        return std::make_shared<const JwtClaims>(std::move(payload), *expires);
+    }
+
+    inline bool audience_matches(std::optional<std::string_view> aud) const {
+        if (!aud) return false;
+        if (aud->empty() || aud->front() != '[') return *aud == config_.audience;
+        // Array form: look for the quoted audience among the elements.
+        std::string quoted = "\"" + config_.audience + "\"";
+        std::string_view items = *aud;
+        std::size_t pos = 0;
+        while ((pos = items.find(quoted, pos)) != std::string_view::npos) {
+            std::size_t prev = items.find_last_not_of(" \t\r\n", pos - 1); // pos > 0: items starts with '['
+            if (items[prev] == '[' || items[prev] == ',') return true;
+            pos += quoted.size();
+        }
+        return false;
+    }
+
+    static inline bool verify_signature(const Key& key, std::string_view signed_part, const std::string& signature) {
+        std::string der;
+        const unsigned char* sig = reinterpret_cast<const unsigned char*>(signature.data());
+        std::size_t sig_length = signature.size();
+        if (key.algorithm == "ES256") {
+            // JWS carries r || s; OpenSSL wants a DER-encoded ECDSA-Sig-Value.
+            if (signature.size() != 64) return false;
+            ECDSA_SIG* ecdsa = ECDSA_SIG_new();
+            BIGNUM* r = BN_bin2bn(sig, 32, nullptr);
+            BIGNUM* s = BN_bin2bn(sig + 32, 32, nullptr);
+            if (!ecdsa || !r || !s || ECDSA_SIG_set0(ecdsa, r, s) != 1) {
+                BN_free(r);
+                BN_free(s);
+                ECDSA_SIG_free(ecdsa);
+                return false;
+            }
+            int der_length = i2d_ECDSA_SIG(ecdsa, nullptr);
+            der.resize(der_length > 0 ? static_cast<std::size_t>(der_length) : 0);
+            auto* out = reinterpret_cast<unsigned char*>(der.data());
+            i2d_ECDSA_SIG(ecdsa, &out);
+            ECDSA_SIG_free(ecdsa);
+            sig = reinterpret_cast<const unsigned char*>(der.data());
+            sig_length = der.size();
+        }
+        EVP_MD_CTX* ctx = EVP_MD_CTX_new();
+        bool ok = ctx &&
+                  EVP_DigestVerifyInit(ctx, nullptr, EVP_sha256(), nullptr, key.pkey) == 1 &&
+                  EVP_DigestVerify(ctx, sig, sig_length,
+                                   reinterpret_cast<const unsigned char*>(signed_part.data()), signed_part.size()) == 1;
+        EVP_MD_CTX_free(ctx);
+        return ok;
+    }
+
+    JwtConfig config_;
+    std::unordered_map<std::string, Key> keys_;
+    std::vector<Shard> shards_;
+    std::size_t shard_capacity_ = 1;
+    std::atomic<uint64_t> hits_{0};
+    std::atomic<uint64_t> misses_{0};
+    std::atomic<uint64_t> rejected_{0};
+    std::atomic<std::size_t> cached_bytes_{0};
+    uint64_t shrinker_id_ = 0;
+};
+
+/**
+ * @brief A route filter that requires "Authorization: Bearer <token>"
+ * verified by `verifier`, and exposes the token's claims as req.claims.
+ * Refused requests get a 401 with a WWW-Authenticate challenge.
+ * @param verifier The verifier (shared by every route that uses it).
+ * @return The filter, for RouteOptions::filters.
+ */
+inline RouteFilter jwt_bearer(std::shared_ptr<JwtVerifier> verifier) {
+    return [verifier = std::move(verifier)](Request& req, Response& res) {
+        std::string_view authorization = req.header("Authorization");
+        JwtError error = JwtError::Missing;
+        if (authorization.size() > 7 && (authorization.substr(0, 7) == "Bearer " || authorization.substr(0, 7) == "bearer ")) {
+            req.claims = verifier->verify(authorization.substr(7), error);
+            if (req.claims) return true;
+        }
+        log_message("DEBUG", fmt::format("JWT refused for {} {}: {}", req.method, req.path, jwt_error_name(error)));
+        res.status_code = 401;
+        res.headers["WWW-Authenticate"] = error == JwtError::Missing
+            ? std::string("Bearer")
+            : fmt::format("Bearer error=\"invalid_token\", error_description=\"{}\"", jwt_error_name(error));
+        res.Text("Unauthorized");
+        return false;
+    };
+}
+
+} // namespace Haka
+
+#endif // HAKA_ENABLE_JWT
+
+#endif // HAKA_JWT_HPP
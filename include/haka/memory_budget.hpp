@@ -0,0 +1,321 @@
+#ifndef HAKA_MEMORY_BUDGET_HPP
+#define HAKA_MEMORY_BUDGET_HPP
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#if !defined(_WIN32)
+#include <unistd.h> // For sysconf
+#endif
+
+namespace Haka {
+
+/**
+ * @brief The parts of the server that account their memory.
+ */
+enum class MemorySubsystem : uint8_t {
+    RequestBuffers, // Request bytes read from sockets, including bodies
+    ResponseBodies, // Serialized responses waiting to be written
+    Files,          // Files being read by Response::sendFile
+    Caches,         // Caches (shared cache segment, sessions, ...)
+    Queues          // Work queued for background threads (mirroring, ...)
+};
+inline constexpr std::size_t kMemorySubsystemCount = 5;
+
+inline const char* memory_subsystem_name(MemorySubsystem subsystem) {
+    switch (subsystem) {
+        case MemorySubsystem::RequestBuffers: return "request_buffers";
+        case MemorySubsystem::ResponseBodies: return "response_bodies";
+        case MemorySubsystem::Files: return "files";
+        case MemorySubsystem::Caches: return "caches";
+        case MemorySubsystem::Queues: return "queues";
+    }
+    return "unknown";
+}
+
+/**
+ * @brief Memory budget settings. Pass through ServerConfig::memory.
+ */
+struct MemoryBudgetConfig {
+    // Hard limit in bytes. Zero derives it from the cgroup memory limit
+    // (or physical memory) times limit_fraction, leaving room for memory
+    // the budget does not see (code, stacks, allocator overhead).
+    std::size_t limit = 0;
+    double limit_fraction = 0.75;
+    // Above this share of the limit the server is under pressure: sockets
+    // stop being read, caches are asked to shrink, and large reservations fail.
+    double high_watermark = 0.9;
+    // Reservations at least this large (e.g., uploads) must fit under the high
+    // watermark, so big requests are turned away before small ones.
+    std::size_t large_reservation = 1024 * 1024;
+};
+
+/**
+ * @brief Process-wide memory accounting. Subsystems reserve bytes before
+ * they hold them and release them afterwards; the budget decides when the
+ * server must push back. Counters are atomics, so reserving costs a few
+ * atomic adds and never takes a lock.
+ */
+class MemoryBudget {
+public:
+    // Frees memory, ideally at least `target` bytes; returns the bytes freed.
+    using Shrinker = std::function<std::size_t(std::size_t target)>;
+
+    /**
+     * @brief Applies settings, detecting the limit if none is given.
+     * @param config The budget settings.
+     */
+    inline void configure(const MemoryBudgetConfig& config) {
+        std::size_t limit = config.limit;
+        if (limit == 0) {
+            limit = static_cast<std::size_t>(static_cast<double>(detect_memory_limit()) * config.limit_fraction);
+        }
+        limit_.store(limit, std::memory_order_relaxed);
+        high_.store(static_cast<std::size_t>(static_cast<double>(limit) * config.high_watermark), std::memory_order_relaxed);
+        large_.store(config.large_reservation, std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief Reserves bytes if they fit in the budget.
+     * @param subsystem Who is reserving.
+     * @param bytes How much.
+     * @return false (reserving nothing) if the reservation would exceed the
+     * limit, or the high watermark for large reservations.
+     */
+    inline bool try_reserve(MemorySubsystem subsystem, std::size_t bytes) {
+        std::size_t ceiling = bytes >= large_.load(std::memory_order_relaxed)
+                              ? high_.load(std::memory_order_relaxed)
+                              : limit_.load(std::memory_order_relaxed);
+        std::size_t used = used_.load(std::memory_order_relaxed);
+        do {
+            if (used + bytes > ceiling) {
+                rejected_.fetch_add(1, std::memory_order_relaxed);
+                shrink(used + bytes - ceiling);
+                return false;
+            }
+        } while (!used_.compare_exchange_weak(used, used + bytes, std::memory_order_relaxed));
+        by_subsystem_[index(subsystem)].fetch_add(bytes, std::memory_order_relaxed);
+        if (used + bytes > high_.load(std::memory_order_relaxed)) {
+            shrink(used + bytes - high_.load(std::memory_order_relaxed));
+        }
+        return true;
+    }
+
+    /**
+     * @brief Accounts bytes that are already held (e.g., a response the
+     * handler produced). Never fails, but can push the budget into pressure.
+     * @param subsystem Who is reserving.
+     * @param bytes How much.
+     */
+    inline void reserve(MemorySubsystem subsystem, std::size_t bytes) {
+        std::size_t used = used_.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+        by_subsystem_[index(subsystem)].fetch_add(bytes, std::memory_order_relaxed);
+        std::size_t high = high_.load(std::memory_order_relaxed);
+        if (used > high) {
+            shrink(used - high);
+        }
+    }
+
+    /**
+     * @brief Returns bytes to the budget.
+     * @param subsystem Who reserved them.
+     * @param bytes How much.
+     */
+    inline void release(MemorySubsystem subsystem, std::size_t bytes) {
+        used_.fetch_sub(bytes, std::memory_order_relaxed);
+        by_subsystem_[index(subsystem)].fetch_sub(bytes, std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief Whether usage is above the high watermark. Connections stop
+     * reading from their sockets while this is true.
+     */
+    inline bool under_pressure() const {
+        return used_.load(std::memory_order_relaxed) > high_.load(std::memory_order_relaxed);
+    }
+
+    inline std::size_t used() const { return used_.load(std::memory_order_relaxed); }
+    inline std::size_t limit() const { return limit_.load(std::memory_order_relaxed); }
+
+    /**
+     * @brief Registers a function that frees memory (typically by evicting
+     * cache entries) when the budget comes under pressure. It is called from
+     * whichever thread pushed usage over the high watermark, possibly from
+     * inside reserve(), so it must not block on locks that thread may hold
+     * (use try_lock).
+     * @param name Name of the cache, for diagnostics.
+     * @param shrinker The function.
+     * @return An ID for remove_shrinker.
+     */
+    inline uint64_t add_shrinker(std::string name, Shrinker shrinker) {
+        std::lock_guard<std::mutex> lock(shrinkers_mutex_);
+        uint64_t id = ++next_shrinker_id_;
+        shrinkers_.push_back({id, std::move(name), std::move(shrinker)});
+        return id;
+    }
+
+    /**
+     * @brief Unregisters a shrinker; once this returns it is not running and
+     * will not be called again.
+     * @param id The ID add_shrinker returned.
+     */
+    inline void remove_shrinker(uint64_t id) {
+        std::lock_guard<std::mutex> lock(shrinkers_mutex_);
+        shrinkers_.erase(std::remove_if(shrinkers_.begin(), shrinkers_.end(),
+                                        [id](const ShrinkerEntry& entry) { return entry.id == id; }),
+                         shrinkers_.end());
+    }
+
+    /**
+     * @brief Appends usage metrics in Prometheus text format.
+     * @param out The buffer to append to.
+     */
+    inline void collect_metrics(std::string& out) const {
+        out += "# TYPE haka_memory_limit_bytes gauge\nhaka_memory_limit_bytes " + std::to_string(limit()) + "\n";
+        out += "# TYPE haka_memory_used_bytes gauge\n";
+        for (std::size_t i = 0; i < kMemorySubsystemCount; ++i) {
+            out += "haka_memory_used_bytes{subsystem=\"";
+            out += memory_subsystem_name(static_cast<MemorySubsystem>(i));
+            out += "\"} " + std::to_string(by_subsystem_[i].load(std::memory_order_relaxed)) + "\n";
+        }
+        out += "# TYPE haka_memory_rejected_total counter\nhaka_memory_rejected_total " +
+               std::to_string(rejected_.load(std::memory_order_relaxed)) + "\n";
+        out += "# TYPE haka_memory_shrunk_bytes_total counter\nhaka_memory_shrunk_bytes_total " +
+               std::to_string(shrunk_.load(std::memory_order_relaxed)) + "\n";
+    }
+
+    /**
+     * @brief Finds the memory available to this process: the cgroup v2 or v1
+     * limit if one is set, otherwise physical memory.
+     * @return The limit in bytes.
+     */
+    static inline std::size_t detect_memory_limit() {
+        auto read_limit = [](const char* path) -> std::size_t {
+            std::ifstream file(path);
+            std::string value;
+            if (!(file >> value) || value == "max") return 0;
+            try {
+                unsigned long long bytes = std::stoull(value);
+                return bytes >= (1ULL << 60) ? 0 : static_cast<std::size_t>(bytes); // v1 reports "unlimited" as ~2^63
+            } catch (...) {
+                return 0;
+            }
+        };
+        if (std::size_t limit = read_limit("/sys/fs/cgroup/memory.max")) return limit;
+        if (std::size_t limit = read_limit("/sys/fs/cgroup/memory/memory.limit_in_bytes")) return limit;
+#if !defined(_WIN32)
+        long pages = ::sysconf(_SC_PHYS_PAGES);
+        long page_size = ::sysconf(_SC_PAGE_SIZE);
+        if (pages > 0 && page_size > 0) {
+            return static_cast<std::size_t>(pages) * static_cast<std::size_t>(page_size);
+        }
+#endif
+        return std::size_t{4} << 30; // Unknown: assume 4 GiB
+    }
+
+private:
+    static inline std::size_t index(MemorySubsystem subsystem) {
+        return static_cast<std::size_t>(subsystem);
+    }
+
+    // Runs the shrinkers; only one thread shrinks at a time, others carry on.
+    inline void shrink(std::size_t target) {
+        if (shrinking_.exchange(true, std::memory_order_acquire)) return;
+        std::size_t freed = 0;
+        {
+            std::lock_guard<std::mutex> lock(shrinkers_mutex_);
+            for (auto& entry : shrinkers_) {
+                if (freed >= target) break;
+                freed += entry.shrink(target - freed);
+            }
+        }
+        shrunk_.fetch_add(freed, std::memory_order_relaxed);
+        shrinking_.store(false, std::memory_order_release);
+    }
+
+    std::atomic<std::size_t> limit_{std::size_t{1} << 30};
+    std::atomic<std::size_t> high_{(std::size_t{1} << 30) / 10 * 9};
+    std::atomic<std::size_t> large_{1024 * 1024};
+    std::atomic<std::size_t> used_{0};
+    std::array<std::atomic<std::size_t>, kMemorySubsystemCount> by_subsystem_{};
+    std::atomic<uint64_t> rejected_{0};
+    std::atomic<uint64_t> shrunk_{0};
+    std::atomic<bool> shrinking_{false};
+    struct ShrinkerEntry {
+        uint64_t id;
+        std::string name;
+        Shrinker shrink;
+    };
+
+    std::mutex shrinkers_mutex_;
+    std::vector<ShrinkerEntry> shrinkers_;
+    uint64_t next_shrinker_id_ = 0;
+};
+
+/**
+ * @brief The process-wide budget. Memory is a per-process resource, so
+ * every Server and subsystem in the process shares it.
+ */
+inline MemoryBudget& memory_budget() {
+    static MemoryBudget budget;
+    return budget;
+}
+
+/**
+ * @brief Owns a number of reserved bytes and returns them when destroyed.
+ */
+class MemoryReservation {
+public:
+    inline explicit MemoryReservation(MemorySubsystem subsystem) : subsystem_(subsystem) {}
+    inline ~MemoryReservation() { reset(); }
+
+    inline MemoryReservation(MemoryReservation&& other) noexcept
+        : subsystem_(other.subsystem_), bytes_(std::exchange(other.bytes_, 0)) {}
+    MemoryReservation(const MemoryReservation&) = delete;
+    MemoryReservation& operator=(const MemoryReservation&) = delete;
+
+    /**
+     * @brief Reserves more bytes if they fit in the budget.
+     * @param bytes Additional bytes.
+     * @return false if the budget refused them.
+     */
+    inline bool try_grow(std::size_t bytes) {
+        if (!memory_budget().try_reserve(subsystem_, bytes)) return false;
+        bytes_ += bytes;
+        return true;
+    }
+
+    /**
+     * @brief Sets the reservation to exactly `bytes`, growing
+     * unconditionally (for memory already held) or shrinking.
+     * @param bytes The new size.
+     */
+    inline void resize(std::size_t bytes) {
+        if (bytes > bytes_) {
+            memory_budget().reserve(subsystem_, bytes - bytes_);
+        } else if (bytes < bytes_) {
+            memory_budget().release(subsystem_, bytes_ - bytes);
+        }
+        bytes_ = bytes;
+    }
+
+    inline void reset() { resize(0); }
+    inline std::size_t bytes() const { return bytes_; }
+
+private:
+    MemorySubsystem subsystem_;
+    std::size_t bytes_ = 0;
+};
+
+} // namespace Haka
+
+#endif // HAKA_MEMORY_BUDGET_HPP
@@ -0,0 +1,73 @@
+#ifndef HAKA_METRICS_HPP
+#define HAKA_METRICS_HPP
+
+// Project includes
+#include "haka/core.hpp" // For fmt
+
+#include <functional>
+#include <iterator>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace Haka {
+
+/**
+ * @brief Appends one sample in Prometheus text exposition format.
+ * @param out The buffer to append to.
+ * @param name Metric name (e.g., "haka_scheduler_queued").
+ * @param labels Label set without braces (e.g., "class=\"batch\""), or empty.
+ * @param value The sample value.
+ */
+template <typename T>
+inline void append_metric(std::string& out, const std::string& name, const std::string& labels, T value) {
+    if (labels.empty()) {
+        fmt::format_to(std::back_inserter(out), "{} {}\n", name, value);
+    } else {
+        fmt::format_to(std::back_inserter(out), "{}{{{}}} {}\n", name, labels, value);
+    }
+}
+
+/**
+ * @brief Collects metrics from the server's subsystems and renders them
+ * for a scrape endpoint. Subsystems register a collector once; collectors
+ * only run when the metrics are rendered, so there is no cost per request.
+ */
+class MetricsRegistry {
+public:
+    // Appends the collector's samples to the output buffer.
+    using Collector = std::function<void(std::string&)>;
+
+    /**
+     * @brief Registers a collector.
+     * @param name Name used in logs for this group of metrics.
+     * @param collector Function that appends samples to the output.
+     */
+    inline void add_collector(const std::string& name, Collector collector) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        collectors_.emplace_back(name, std::move(collector));
+        log_message("DEBUG", fmt::format("Registered metrics collector: {}", name));
+    }
+
+    /**
+     * @brief Runs every collector.
+     * @return All metrics in Prometheus text format.
+     */
+    inline std::string render() const {
+        std::string out;
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (const auto& entry : collectors_) {
+            entry.second(out);
+        }
+        return out;
+    }
+
+private:
+    mutable std::mutex mutex_;
+    std::vector<std::pair<std::string, Collector>> collectors_;
+};
+
+} // namespace Haka
+
+#endif // HAKA_METRICS_HPP
@@ -0,0 +1,381 @@
+#ifndef HAKA_MIRROR_HPP
+#define HAKA_MIRROR_HPP
+
+// External library includes (Asio for the shadow connections)
+#define ASIO_STANDALONE
+#include <asio.hpp>
+
+// Project includes
+#include "haka/core.hpp"    // For Request, log_message
+#include "haka/metrics.hpp" // For append_metric
+#include "haka/path.hpp"    // For append_encoded_path
+#include "haka/memory_budget.hpp" // For accounting queued copies
+
+#include <atomic>
+#include <charconv>
+#include <chrono>
+#include <deque>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace Haka {
+
+/**
+ * @brief Settings for one shadow upstream.
+ */
+struct MirrorConfig {
+    std::size_t connections = 4;          // Pooled keep-alive connections to the shadow
+    std::size_t queue_capacity = 1024;    // Copies waiting for a connection; excess are dropped
+    std::chrono::milliseconds timeout{5000}; // Per copy, connect to end of response
+};
+
+/**
+ * @brief Duplicates requests to a shadow upstream (e.g., a new version of
+ * the service) without affecting the primary response. Copies are sent
+ * fire-and-forget over a small pool of keep-alive connections from a
+ * dedicated thread; shadow responses are read and discarded. When the
+ * shadow falls behind, the bounded queue fills and further copies are
+ * dropped and counted.
+ */
+class Mirror {
+public:
+    /**
+     * @brief Resolves the shadow address and starts the mirror thread.
+     * @param name Name used in logs and metrics.
+     * @param host Shadow host.
+     * @param port Shadow port.
+     * @param config Pool and queue settings.
+     * @throws asio::system_error if the host cannot be resolved.
+     */
+    inline Mirror(std::string name, const std::string& host, unsigned short port, MirrorConfig config = {})
+        : name_(std::move(name)), host_(host), port_(port), config_(config),
+          work_(asio::make_work_guard(io_))
+    {
+        asio::ip::tcp::resolver resolver(io_);
+        endpoints_ = resolver.resolve(host, std::to_string(port));
+        config_.connections = std::max<std::size_t>(1, config_.connections);
+        for (std::size_t i = 0; i < config_.connections; ++i) {
+            slots_.push_back(std::make_unique<Slot>(io_));
+        }
+        thread_ = std::thread([this] { io_.run(); });
+        log_message("INFO", fmt::format("Mirroring '{}' to {}:{} over {} connections", name_, host_, port_, slots_.size()));
+    }
+
+    inline ~Mirror() {
+        work_.reset();
+        io_.stop();
+        if (thread_.joinable()) thread_.join();
+    }
+
+    Mirror(const Mirror&) = delete;
+    Mirror& operator=(const Mirror&) = delete;
+
+    /**
+     * @brief Decides whether a request should be mirrored.
+     * @param percent Share of requests to mirror, 0-100.
+     * @return true for roughly percent% of calls.
+     */
+    static inline bool sample(double percent) {
+        if (percent >= 100.0) return true;
+        if (percent <= 0.0) return false;
+        thread_local std::minstd_rand rng{std::random_device{}()};
+        return std::uniform_real_distribution<double>(0.0, 100.0)(rng) < percent;
+    }
+
+    /**
+     * @brief Queues a copy of the request for the shadow. Never blocks: the
+     * copy is handed to the mirror thread, or dropped if the queue is full.
+     * @param req The request, already answered by the primary handler.
+     * @return false if the copy was dropped.
+     */
+    inline bool submit(const Request& req) {
+        if (queued_.fetch_add(1, std::memory_order_relaxed) >= config_.queue_capacity) {
+            queued_.fetch_sub(1, std::memory_order_relaxed);
+            dropped_.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        std::string copy = serialize(req);
+        if (!memory_budget().try_reserve(MemorySubsystem::Queues, copy.size())) {
+            queued_.fetch_sub(1, std::memory_order_relaxed);
+            dropped_.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        asio::post(io_, [this, copy = std::move(copy)]() mutable {
+            pending_.push_back(std::move(copy));
+            pump();
+        });
+        return true;
+    }
+
+    /**
+     * @brief Appends the mirror's counters in Prometheus text format.
+     * @param out The buffer to append to.
+     */
+    inline void collect_metrics(std::string& out) const {
+        std::string labels = fmt::format("mirror=\"{}\"", name_);
+        append_metric(out, "haka_mirror_queued", labels, queued_.load(std::memory_order_relaxed));
+        append_metric(out, "haka_mirror_sent_total", labels, sent_.load(std::memory_order_relaxed));
+        append_metric(out, "haka_mirror_dropped_total", labels, dropped_.load(std::memory_order_relaxed));
+        append_metric(out, "haka_mirror_errors_total", labels, errors_.load(std::memory_order_relaxed));
+    }
+
+    inline const std::string& name() const { return name_; }
+
+private:
+    // One pooled connection; only touched on the mirror thread.
+    struct Slot {
+        inline explicit Slot(asio::io_context& io) : socket(io), timer(io) {}
+        asio::ip::tcp::socket socket;
+        asio::steady_timer timer;
+        bool connected = false;
+        bool busy = false;
+        bool reused = false;       // Sent over a connection that already carried a copy
+        bool retried = false;
+        bool head = false;         // The copy is a HEAD request, so its response has no body
+        uint64_t generation = 0;   // Guards against a stale timeout closing the next copy's socket
+        std::string out;
+        std::string in;
+    };
+
+    static inline std::string serialize(const Request& req) {
+        std::string out;
+        out.reserve(256 + req.body.size());
+        // req.path is decoded; re-encode it so the shadow sees a well-formed target.
+        out += req.method;
+        out += ' ';
+        append_encoded_path(req.path, out);
+        if (!req.query.empty()) {
+            out += '?';
+            out += req.query;
+        }
+        out += " HTTP/1.1\r\n";
+        for (const auto& header : req.headers) {
+            if (equals_ignore_case(header.first, "Connection") || equals_ignore_case(header.first, "Content-Length") ||
+                equals_ignore_case(header.first, "Transfer-Encoding")) {
+                continue;
+            }
+            fmt::format_to(std::back_inserter(out), "{}: {}\r\n", header.first, header.second);
+        }
+        if (!req.id.empty() && req.header("X-Request-Id").empty()) {
+            // Same ID as the primary, so both sides' logs can be matched up.
+            fmt::format_to(std::back_inserter(out), "X-Request-Id: {}\r\n", req.id.view());
+        }
+        fmt::format_to(std::back_inserter(out), "X-Haka-Mirror: 1\r\nConnection: keep-alive\r\nContent-Length: {}\r\n\r\n",
+                       req.body.size());
+        out += req.body;
+        return out;
+    }
+
+    static inline bool equals_ignore_case(std::string_view a, std::string_view b) {
+        return a.size() == b.size() && std::equal(a.begin(), a.end(), b.begin(), [](char x, char y) {
+            return std::tolower(static_cast<unsigned char>(x)) == std::tolower(static_cast<unsigned char>(y));
+        });
+    }
+
+    // Hands pending copies to idle connections.
+    inline void pump() {
+        for (auto& slot : slots_) {
+            if (pending_.empty()) return;
+            if (slot->busy) continue;
+            slot->busy = true;
+            slot->retried = false;
+            slot->out = std::move(pending_.front());
+            slot->head = slot->out.rfind("HEAD ", 0) == 0;
+            pending_.pop_front();
+            queued_.fetch_sub(1, std::memory_order_relaxed);
+            start(*slot);
+        }
+    }
+
+    inline void start(Slot& slot) {
+        slot.in.clear();
+        uint64_t generation = ++slot.generation;
+        slot.timer.expires_after(config_.timeout);
+        slot.timer.async_wait([&slot, generation](asio::error_code ec) {
+            if (!ec && slot.generation == generation) {
+                asio::error_code ignored;
+                slot.socket.close(ignored); // Aborts the pending operation
+            }
+        });
+        if (slot.connected) {
+            slot.reused = true;
+            write(slot);
+            return;
+        }
+        slot.reused = false;
+        asio::async_connect(slot.socket, endpoints_, [this, &slot](asio::error_code ec, const asio::ip::tcp::endpoint&) {
+            if (ec) {
+                finish(slot, false);
+                return;
+            }
+            slot.socket.set_option(asio::ip::tcp::no_delay(true));
+            slot.connected = true;
+            write(slot);
+        });
+    }
+
+    inline void write(Slot& slot) {
+        asio::async_write(slot.socket, asio::buffer(slot.out), [this, &slot](asio::error_code ec, std::size_t) {
+            if (ec) {
+                finish(slot, false);
+                return;
+            }
+            read(slot);
+        });
+    }
+
+    // Reads and discards the shadow's response.
+    inline void read(Slot& slot) {
+        auto chunk = std::make_shared<std::array<char, 4096>>();
+        slot.socket.async_read_some(asio::buffer(*chunk), [this, &slot, chunk](asio::error_code ec, std::size_t n) {
+            slot.in.append(chunk->data(), n);
+            bool keep_alive = false;
+            if (response_complete(slot.in, slot.head, static_cast<bool>(ec), keep_alive)) {
+                if (!keep_alive) close(slot);
+                finish(slot, true);
+                return;
+            }
+            if (ec) {
+                // A kept-alive connection the shadow closed while idle: resend once on a fresh one.
+                if (slot.reused && slot.in.empty() && !slot.retried) {
+                    close(slot);
+                    slot.retried = true;
+                    slot.timer.cancel();
+                    start(slot);
+                    return;
+                }
+                finish(slot, false);
+                return;
+            }
+            read(slot);
+        });
+    }
+
+    /**
+     * @brief Checks whether `in` holds a whole response. Interim 1xx
+     * responses are skipped (removed from `in`); 204, 304 and replies to
+     * HEAD have no body; otherwise the body is framed by chunked
+     * Transfer-Encoding, Content-Length, or the end of the connection.
+     * @param in Bytes read so far.
+     * @param head Whether the request was HEAD.
+     * @param eof Whether the shadow closed the connection.
+     * @param keep_alive Set to whether the connection can carry another copy.
+     */
+    static inline bool response_complete(std::string& in, bool head, bool eof, bool& keep_alive) {
+        for (;;) {
+            std::size_t header_end = in.find("\r\n\r\n");
+            if (header_end == std::string::npos) return false;
+            int status = 0;
+            if (in.size() >= 12) std::from_chars(in.data() + 9, in.data() + 12, status);
+            keep_alive = in.rfind("HTTP/1.1", 0) == 0;
+            std::size_t length = 0;
+            bool has_length = false;
+            bool chunked = false;
+            std::size_t line = in.find("\r\n");
+            while (line < header_end) {
+                std::size_t next = in.find("\r\n", line + 2);
+                std::string_view header(in.data() + line + 2, next - line - 2);
+                std::size_t colon = header.find(':');
+                if (colon != std::string_view::npos) {
+                    std::string_view name = header.substr(0, colon);
+                    std::string_view value = header.substr(colon + 1);
+                    value.remove_prefix(std::min(value.find_first_not_of(' '), value.size()));
+                    value.remove_suffix(value.size() - std::min(value.find_last_not_of(' ') + 1, value.size()));
+                    if (equals_ignore_case(name, "Content-Length")) {
+                        std::from_chars(value.data(), value.data() + value.size(), length);
+                        has_length = true;
+                    } else if (equals_ignore_case(name, "Transfer-Encoding")) {
+                        // Chunked is always the last coding applied.
+                        chunked = value.size() >= 7 && equals_ignore_case(value.substr(value.size() - 7), "chunked");
+                    } else if (equals_ignore_case(name, "Connection")) {
+                        keep_alive = equals_ignore_case(value, "keep-alive");
+                    }
+                }
+                line = next;
+            }
+            std::size_t body_start = header_end + 4;
+            if (status >= 100 && status < 200 && status != 101) {
+                in.erase(0, body_start); // e.g. 100 Continue; the final response follows
+                continue;
+            }
+            if (status == 101) {
+                keep_alive = false; // The shadow switched protocols; nothing more to read as HTTP
+                return true;
+            }
+            if (head || status == 204 || status == 304) return true;
+            if (chunked) {
+                return chunked_length(std::string_view(in).substr(body_start)) != std::string_view::npos;
+            }
+            if (has_length) return in.size() - body_start >= length;
+            keep_alive = false; // Body delimited by EOF
+            return eof;
+        }
+    }
+
+    // Length of the complete chunked body (with trailers) at the start of `body`, or npos if more is needed.
+    static inline std::size_t chunked_length(std::string_view body) {
+        std::size_t pos = 0;
+        for (;;) {
+            std::size_t line_end = body.find("\r\n", pos);
+            if (line_end == std::string_view::npos) return std::string_view::npos;
+            std::size_t size = 0;
+            std::from_chars(body.data() + pos, body.data() + line_end, size, 16); // Stops at chunk extensions
+            pos = line_end + 2;
+            if (size == 0) {
+                // Trailer fields, ended by an empty line.
+                for (;;) {
+                    line_end = body.find("\r\n", pos);
+                    if (line_end == std::string_view::npos) return std::string_view::npos;
+                    bool empty = line_end == pos;
+                    pos = line_end + 2;
+                    if (empty) return pos;
+                }
+            }
+            if (size > body.size() - pos || body.size() - pos - size < 2) return std::string_view::npos;
+            pos += size + 2;
+        }
+    }
+
+    inline void close(Slot& slot) {
+        asio::error_code ignored;
+        slot.socket.close(ignored);
+        slot.connected = false;
+    }
+
+    inline void finish(Slot& slot, bool ok) {
+        slot.timer.cancel();
+        if (ok) {
+            sent_.fetch_add(1, std::memory_order_relaxed);
+        } else {
+            errors_.fetch_add(1, std::memory_order_relaxed);
+            close(slot);
+            log_message("DEBUG", fmt::format("Mirror '{}': copy to {}:{} failed", name_, host_, port_));
+        }
+        slot.busy = false;
+        memory_budget().release(MemorySubsystem::Queues, slot.out.size());
+        slot.out.clear();
+        pump();
+    }
+
+    std::string name_;
+    std::string host_;
+    unsigned short port_;
+    MirrorConfig config_;
+    asio::io_context io_;
+    asio::executor_work_guard<asio::io_context::executor_type> work_;
+    asio::ip::tcp::resolver::results_type endpoints_;
+    std::vector<std::unique_ptr<Slot>> slots_;
+    std::deque<std::string> pending_;      // Mirror thread only
+    std::atomic<std::size_t> queued_{0};   // Submitted but not yet on a connection
+    std::atomic<uint64_t> sent_{0};
+    std::atomic<uint64_t> dropped_{0};
+    std::atomic<uint64_t> errors_{0};
+    std::thread thread_;
+};
+
+} // namespace Haka
+
+#endif // HAKA_MIRROR_HPP
@@ -0,0 +1,386 @@
+#ifndef HAKA_OPEN_FILE_CACHE_HPP
+#define HAKA_OPEN_FILE_CACHE_HPP
+
+// Built on POSIX file descriptors; Windows builds keep opening static files
+// per request.
+#if !defined(_WIN32)
+
+// Project includes
+#include "haka/core.hpp"          // For Response, log_message, guess_mime_type
+#include "haka/metrics.hpp"       // For append_metric
+#include "haka/memory_budget.hpp" // For accounting cache entries and file reads
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// POSIX files
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace Haka {
+
+namespace detail {
+
+inline struct timespec stat_mtime(const struct stat& st) {
+#if defined(__APPLE__)
+    return st.st_mtimespec;
+#else
+    return st.st_mtim;
+#endif
+}
+
+} // namespace detail
+
+/**
+ * @brief Settings for the open file cache (Server::open_file_cache).
+ */
+struct OpenFileCacheConfig {
+    // Most paths kept, and so at most this many descriptors held open; the
+    // least recently used are closed beyond this.
+    std::size_t max_entries = 1000;
+    // How long a cached lookup is trusted before the path is stat()ed again.
+    // A file changed or replaced within this window may be served stale (or
+    // truncated) until then.
+    std::chrono::milliseconds valid{60000};
+    // Entries not used for this long are closed by a periodic sweep.
+    std::chrono::milliseconds inactive{60000};
+    // Also remember paths that do not exist (ENOENT, ENOTDIR), so repeated
+    // requests for missing files cost no syscalls either.
+    bool cache_errors = true;
+    // Independently locked shards of the cache (at most max_entries).
+    std::size_t shards = 16;
+};
+
+/**
+ * @brief The result of looking a path up: an open descriptor plus the stat
+ * fields needed to serve and revalidate it, or the errno of the failed open.
+ * The descriptor stays open while anyone holds the OpenFile, even after the
+ * cache has dropped it.
+ */
+struct OpenFile {
+    int fd = -1;           // Open for reading if regular, else -1
+    int error = 0;         // errno of the failed open(), 0 if the path exists
+    bool regular = false;  // A regular file (directories etc. are not served)
+    uint64_t size = 0;
+    dev_t device = 0;
+    ino_t inode = 0;
+    struct timespec mtime {};
+
+    inline OpenFile() = default;
+    inline ~OpenFile() {
+        if (fd >= 0) ::close(fd);
+    }
+    OpenFile(const OpenFile&) = delete;
+    OpenFile& operator=(const OpenFile&) = delete;
+
+    /**
+     * @brief Opens and fstat()s a path (two syscalls; one if it is missing).
+     * @param path The file to open.
+     * @return The file; check error and regular.
+     */
+    static inline std::shared_ptr<const OpenFile> open(const std::string& path) {
+        auto file = std::make_shared<OpenFile>();
+        int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC | O_NONBLOCK);
+        if (fd < 0) {
+            file->error = errno;
+            return file;
+        }
+        struct stat st {};
+        if (::fstat(fd, &st) != 0) {
+            file->error = errno;
+            ::close(fd);
+            return file;
+        }
+        file->fill(st);
+        if (file->regular) {
+            file->fd = fd;
+        } else {
+            ::close(fd); // Not served, only remembered
+        }
+        return file;
+    }
+
+    /**
+     * @brief Checks whether stat() results still describe this file.
+     */
+    inline bool same_as(const struct stat& st) const {
+        return S_ISREG(st.st_mode) == regular && st.st_dev == device && st.st_ino == inode &&
+               static_cast<uint64_t>(st.st_size) == size && detail::stat_mtime(st).tv_sec == mtime.tv_sec &&
+               detail::stat_mtime(st).tv_nsec == mtime.tv_nsec;
+    }
+
+    /**
+     * @brief Reads the whole file with pread(), so concurrent readers can
+     * share the descriptor. Stops early if the file shrank since it was opened.
+     * @param out Replaced with the contents.
+     * @return false on a read error.
+     */
+    inline bool read(std::string& out) const {
+        out.resize(size);
+        std::size_t done = 0;
+        while (done < size) {
+            ssize_t n = ::pread(fd, out.data() + done, size - done, static_cast<off_t>(done));
+            if (n < 0 && errno == EINTR) continue;
+            if (n < 0) return false;
+            if (n == 0) break;
+            done += static_cast<std::size_t>(n);
+        }
+        out.resize(done);
+        return true;
+    }
+
+private:
+    inline void fill(const struct stat& st) {
+        regular = S_ISREG(st.st_mode);
+        size = static_cast<uint64_t>(st.st_size);
+        device = st.st_dev;
+        inode = st.st_ino;
+        mtime = detail::stat_mtime(st);
+    }
+};
+
+/**
+ * @brief Sets a response from a file opened through the OpenFileCache, with
+ * the same statuses as Response::sendFile.
+ * @param res The response.
+ * @param file The open file.
+ * @param file_path Its path, for the Content-Type and logs.
+ * @return true if the file was read.
+ */
+inline bool send_open_file(Response& res, const OpenFile& file, const std::string& file_path) {
+    MemoryReservation reading(MemorySubsystem::Files);
+    if (!reading.try_grow(static_cast<std::size_t>(file.size))) {
+        log_message("WARN", fmt::format("Not enough memory budget to serve {} ({} bytes)", file_path, file.size));
+        res.status_code = 503;
+        res.body = "Service Unavailable";
+        res.headers["Content-Type"] = "text/plain";
+        res.headers["Retry-After"] = "1";
+        return false;
+    }
+    if (!file.read(res.body)) {
+        log_message("ERROR", fmt::format("Error reading file {}: {}", file_path, std::strerror(errno)));
+        res.status_code = 500;
+        res.body = "Internal Server Error";
+        res.headers["Content-Type"] = "text/plain";
+        return false;
+    }
+    res.headers["Content-Type"] = guess_mime_type(file_path);
+    res.status_code = 200;
+    return true;
+}
+
+/**
+ * @brief Keeps static files open between requests, in the spirit of nginx's
+ * open_file_cache: a hit within the validity interval costs no syscalls
+ * before the file is read (and the read is one pread()), instead of the
+ * stat/open/seek/read sequence of every uncached request. Paths that do not
+ * exist are remembered too, so repeated 404s for missing assets are free.
+ *
+ * After config.valid the path is stat()ed again; an unchanged file keeps its
+ * descriptor, a changed, replaced or deleted one is reopened. The cache is a
+ * sharded LRU bounded by config.max_entries, so it never holds more than
+ * that many descriptors. Safe to use from concurrent handlers.
+ */
+class OpenFileCache {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    // Every shard holds at least one entry, so there are never more shards
+    // than max_entries.
+    inline explicit OpenFileCache(OpenFileCacheConfig config = {})
+        : config_(config),
+          shards_(std::clamp<std::size_t>(config.shards, 1, std::max<std::size_t>(1, config.max_entries))) {
+        shard_capacity_ = std::max<std::size_t>(1, config_.max_entries / shards_.size());
+        shrinker_id_ = memory_budget().add_shrinker("open_files", [this](std::size_t target) { return shrink(target); });
+    }
+
+    inline ~OpenFileCache() {
+        memory_budget().remove_shrinker(shrinker_id_);
+        for (Shard& shard : shards_) {
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            while (!shard.lru.empty()) evict(shard, std::prev(shard.lru.end()));
+        }
+    }
+
+    OpenFileCache(const OpenFileCache&) = delete;
+    OpenFileCache& operator=(const OpenFileCache&) = delete;
+
+    inline const OpenFileCacheConfig& config() const { return config_; }
+
+    /**
+     * @brief Looks a path up, opening (or revalidating) it only if the cache
+     * has no answer younger than config.valid.
+     * @param path The absolute file path.
+     * @return The file; check error and regular. Never null.
+     */
+    inline std::shared_ptr<const OpenFile> open(const std::string& path) {
+        Shard& shard = shards_[std::hash<std::string>{}(path) % shards_.size()];
+        Clock::time_point now = Clock::now();
+        std::shared_ptr<const OpenFile> stale;
+        {
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            auto it = shard.index.find(path);
+            if (it != shard.index.end()) {
+                auto node = it->second;
+                shard.lru.splice(shard.lru.begin(), shard.lru, node);
+                node->used = now;
+                if (now - node->checked < config_.valid) {
+                    (node->file->error ? negative_hits_ : hits_).fetch_add(1, std::memory_order_relaxed);
+                    return node->file;
+                }
+                stale = node->file;
+            }
+        }
+
+        std::shared_ptr<const OpenFile> file;
+        if (stale && !stale->error) {
+            // Still the same file? Then one stat() renews it for another interval.
+            revalidations_.fetch_add(1, std::memory_order_relaxed);
+            struct stat st {};
+            if (::stat(path.c_str(), &st) == 0 && stale->same_as(st)) file = stale;
+        }
+        if (!file) {
+            misses_.fetch_add(1, std::memory_order_relaxed);
+            file = OpenFile::open(path);
+        }
+        if (file->error && !(config_.cache_errors && (file->error == ENOENT || file->error == ENOTDIR))) {
+            // Not remembered: drop any entry for the path so the next request retries.
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            auto it = shard.index.find(path);
+            if (it != shard.index.end()) evict(shard, it->second);
+            return file;
+        }
+
+        // Reserved before locking: reserving can run the shrinkers, which lock shards.
+        std::size_t bytes = sizeof(Node) + path.capacity() + 2 * sizeof(void*) + sizeof(OpenFile) + 64;
+        memory_budget().reserve(MemorySubsystem::Caches, bytes);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        auto it = shard.index.find(path);
+        if (it != shard.index.end()) {
+            memory_budget().release(MemorySubsystem::Caches, bytes);
+            it->second->file = file;
+            it->second->checked = now;
+            return file;
+        }
+        while (shard.lru.size() >= shard_capacity_) {
+            evict(shard, std::prev(shard.lru.end()));
+        }
+        shard.lru.push_front(Node{path, file, now, now, bytes});
+        shard.index.emplace(shard.lru.front().path, shard.lru.begin());
+        entries_.fetch_add(1, std::memory_order_relaxed);
+        return file;
+    }
+
+    /**
+     * @brief Closes entries unused for config.inactive. Run periodically
+     * (Server::open_file_cache does).
+     */
+    inline void sweep() {
+        Clock::time_point cutoff = Clock::now() - config_.inactive;
+        for (Shard& shard : shards_) {
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            // Least recently used last, so stop at the first entry still in use.
+            while (!shard.lru.empty() && shard.lru.back().used < cutoff) {
+                evict(shard, std::prev(shard.lru.end()));
+                closed_inactive_.fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+    }
+
+    /**
+     * @brief Number of cached paths, found or not.
+     */
+    inline std::size_t size() const {
+        return entries_.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief Appends cache counters in Prometheus text format.
+     * @param out The buffer to append to.
+     */
+    inline void collect_metrics(std::string& out) const {
+        out += "# TYPE haka_open_file_cache_entries gauge\n";
+        append_metric(out, "haka_open_file_cache_entries", "", size());
+        out += "# TYPE haka_open_file_cache_hits_total counter\n";
+        append_metric(out, "haka_open_file_cache_hits_total", "result=\"found\"", hits_.load(std::memory_order_relaxed));
+        append_metric(out, "haka_open_file_cache_hits_total", "result=\"missing\"", negative_hits_.load(std::memory_order_relaxed));
+        out += "# TYPE haka_open_file_cache_misses_total counter\n";
+        append_metric(out, "haka_open_file_cache_misses_total", "", misses_.load(std::memory_order_relaxed));
+        out += "# TYPE haka_open_file_cache_revalidations_total counter\n";
+        append_metric(out, "haka_open_file_cache_revalidations_total", "", revalidations_.load(std::memory_order_relaxed));
+        out += "# TYPE haka_open_file_cache_inactive_closed_total counter\n";
+        append_metric(out, "haka_open_file_cache_inactive_closed_total", "", closed_inactive_.load(std::memory_order_relaxed));
+    }
+
+private:
+    struct Node {
+        std::string path;
+        std::shared_ptr<const OpenFile> file;
+        Clock::time_point checked; // Last open or successful revalidation
+        Clock::time_point used;    // Last lookup
+        std::size_t bytes;
+    };
+
+    struct Shard {
+        std::mutex mutex;
+        std::list<Node> lru; // Most recently used first
+        std::unordered_map<std::string, std::list<Node>::iterator> index;
+    };
+
+    // Memory budget shrinker: closes least recently used entries, skipping
+    // shards that are busy (this may run on a thread holding one).
+    inline std::size_t shrink(std::size_t target) {
+        std::size_t freed = 0;
+        bool evicted = true;
+        while (freed < target && evicted) {
+            evicted = false;
+            for (Shard& shard : shards_) {
+                std::unique_lock<std::mutex> lock(shard.mutex, std::try_to_lock);
+                if (!lock.owns_lock() || shard.lru.empty()) continue;
+                freed += shard.lru.back().bytes;
+                evict(shard, std::prev(shard.lru.end()));
+                evicted = true;
+                if (freed >= target) break;
+            }
+        }
+        return freed;
+    }
+
+    // Called with the shard's mutex held. The descriptor closes once the
+    // last request using it is done.
+    inline void evict(Shard& shard, std::list<Node>::iterator node) {
+        memory_budget().release(MemorySubsystem::Caches, node->bytes);
+        entries_.fetch_sub(1, std::memory_order_relaxed);
+        shard.index.erase(node->path);
+        shard.lru.erase(node);
+    }
+
+    OpenFileCacheConfig config_;
+    std::size_t shard_capacity_ = 1;
+    std::vector<Shard> shards_;
+    std::atomic<std::size_t> entries_{0};
+    std::atomic<uint64_t> hits_{0};
+    std::atomic<uint64_t> negative_hits_{0};
+    std::atomic<uint64_t> misses_{0};
+    std::atomic<uint64_t> revalidations_{0};
+    std::atomic<uint64_t> closed_inactive_{0};
+    uint64_t shrinker_id_ = 0;
+};
+
+} // namespace Haka
+
+#endif // !_WIN32
+
+#endif // HAKA_OPEN_FILE_CACHE_HPP
@@ -0,0 +1,227 @@
+#ifndef HAKA_PARSER_HPP
+#define HAKA_PARSER_HPP
+
+// Project includes
+#include "haka/core.hpp" // For Request
+#include "haka/path.hpp" // For normalize_request_target
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+
+namespace Haka {
+
+/**
+ * @brief Limits the parser enforces (copied from ServerConfig).
+ */
+struct ParserLimits {
+    std::size_t max_request_line = 8 * 1024;
+    std::size_t max_header_bytes = 16 * 1024;
+    std::size_t max_header_count = 100;
+    std::size_t max_body_size = 8 * 1024 * 1024;
+};
+
+/**
+ * @brief Outcome of RequestParser::scan and RequestParser::parse_head.
+ */
+enum class ParseStatus : uint8_t {
+    Incomplete,                  // scan(): the head has not fully arrived
+    HeadComplete,                // scan(): the blank line ending the head is in the buffer
+    Complete,                    // parse_head(): request line and headers parsed
+    RequestLineTooLong,          // 414
+    HeaderBytesTooLarge,         // 431
+    TooManyHeaders,              // 431
+    BadRequestLine,              // 400: not "<method> <target> <version>"
+    BadTarget,                   // 400: see RequestParser::path_status()
+    BadContentLength,            // 400: not digits, or conflicting Content-Length fields
+    UnsupportedTransferEncoding, // 501: chunked bodies are not supported
+    BodyTooLarge                 // 413: Content-Length over max_body_size
+};
+
+inline const char* parse_status_name(ParseStatus status) {
+    switch (status) {
+        case ParseStatus::Incomplete: return "incomplete";
+        case ParseStatus::HeadComplete: return "head complete";
+        case ParseStatus::Complete: return "complete";
+        case ParseStatus::RequestLineTooLong: return "request line too long";
+        case ParseStatus::HeaderBytesTooLarge: return "header bytes over limit";
+        case ParseStatus::TooManyHeaders: return "too many headers";
+        case ParseStatus::BadRequestLine: return "malformed request line";
+        case ParseStatus::BadTarget: return "bad request target";
+        case ParseStatus::BadContentLength: return "bad Content-Length";
+        case ParseStatus::UnsupportedTransferEncoding: return "unsupported Transfer-Encoding";
+        case ParseStatus::BodyTooLarge: return "body too large";
+    }
+    return "unknown";
+}
+
+/**
+ * @brief The HTTP status code a parse failure is answered with.
+ * @return The status code, or 0 if `status` is not an error.
+ */
+inline int parse_status_code(ParseStatus status) {
+    switch (status) {
+        case ParseStatus::RequestLineTooLong: return 414;
+        case ParseStatus::HeaderBytesTooLarge:
+        case ParseStatus::TooManyHeaders: return 431;
+        case ParseStatus::BadRequestLine:
+        case ParseStatus::BadTarget:
+        case ParseStatus::BadContentLength: return 400;
+        case ParseStatus::UnsupportedTransferEncoding: return 501;
+        case ParseStatus::BodyTooLarge: return 413;
+        default: return 0;
+    }
+}
+
+/**
+ * @brief Incremental HTTP/1.1 request head parser used by Connection.
+ *
+ * scan() is called after every read with the accumulated buffer and resumes
+ * where the previous call stopped, so a head arriving in many small reads is
+ * searched once rather than from the start each time. It enforces the
+ * request-line and header-byte limits before the head is complete. Once it
+ * reports HeadComplete, parse_head() parses the request line (normalizing
+ * the target in place, see normalize_request_target) and the header fields
+ * straight out of the buffer.
+ *
+ * Header fields are split on LF with a trailing CR removed; the value starts
+ * after the first ':' and leading spaces/tabs. A line without ':' is ignored
+ * (but counted against max_header_count); a repeated name keeps the last
+ * value. Every Content-Length field must be all digits and they must agree.
+ * fuzz/ holds a differential fuzzer that checks this against a plain
+ * reference implementation.
+ */
+class RequestParser {
+public:
+    inline explicit RequestParser(ParserLimits limits = {}) : limits_(limits) {}
+
+    /**
+     * @brief Looks for the end of the request head in the bytes received so far.
+     * @param buffer All bytes received on the connection so far.
+     * @return Incomplete, HeadComplete, or a limit violation.
+     */
+    inline ParseStatus scan(const std::string& buffer) {
+        if (line_end_ == std::string::npos) {
+            line_end_ = buffer.find("\r\n", scanned_ > 0 ? scanned_ - 1 : 0);
+            if (line_end_ == std::string::npos) {
+                scanned_ = buffer.size();
+                // A trailing '\r' may be the start of the line's CRLF, not part of the line.
+                std::size_t line_length = buffer.size() - (!buffer.empty() && buffer.back() == '\r' ? 1 : 0);
+                return line_length > limits_.max_request_line ? ParseStatus::RequestLineTooLong : ParseStatus::Incomplete;
+            }
+            if (line_end_ > limits_.max_request_line) return ParseStatus::RequestLineTooLong;
+            scanned_ = line_end_;
+        }
+        if (head_end_ == std::string::npos) {
+            // "\r\n\r\n" starts with the request line's CRLF at the earliest.
+            head_end_ = buffer.find("\r\n\r\n", std::max(line_end_, scanned_ >= 3 ? scanned_ - 3 : 0));
+            scanned_ = buffer.size();
+        }
+        std::size_t end = head_end_ == std::string::npos ? buffer.size() : head_end_ + 4;
+        if (end - line_end_ - 2 > limits_.max_header_bytes) return ParseStatus::HeaderBytesTooLarge;
+        return head_end_ == std::string::npos ? ParseStatus::Incomplete : ParseStatus::HeadComplete;
+    }
+
+    /**
+     * @brief Parses the request line and headers into `request`. Call once,
+     * after scan() returned HeadComplete.
+     * @param buffer The same buffer; the target is normalized in place.
+     * @param request Receives method, path, query and headers.
+     * @return Complete, or why the request must be refused.
+     */
+    inline ParseStatus parse_head(std::string& buffer, Request& request) {
+        char* data = buffer.data();
+        std::string_view line(data, line_end_);
+        std::size_t method_end = line.find(' ');
+        std::size_t target_end = method_end == std::string_view::npos ? method_end : line.find(' ', method_end + 1);
+        if (method_end == 0 || target_end == std::string_view::npos || target_end == method_end + 1) {
+            return ParseStatus::BadRequestLine;
+        }
+        request.method.assign(data, method_end);
+        std::size_t path_size = 0;
+        path_status_ = normalize_request_target(data + method_end + 1, target_end - method_end - 1, path_size, request.query);
+        if (path_status_ != PathStatus::Ok) return ParseStatus::BadTarget;
+        request.path.assign(data + method_end + 1, path_size);
+
+        // Header lines lie in [line_end + 2, head_end + 2): each ends in LF, the
+        // last one at the first CRLF of the blank line.
+        const char* p = data + line_end_ + 2;
+        const char* end = data + head_end_ + 2;
+        std::size_t count = 0;
+        bool has_length = false;
+        bool chunked = false;
+        bool bad_length = false;
+        while (p < end) {
+            const char* newline = static_cast<const char*>(std::memchr(p, '\n', static_cast<std::size_t>(end - p)));
+            std::string_view field(p, static_cast<std::size_t>(newline - p));
+            p = newline + 1;
+            if (field == "\r") break;
+            if (++count > limits_.max_header_count) return ParseStatus::TooManyHeaders;
+            if (!field.empty() && field.back() == '\r') field.remove_suffix(1);
+            std::size_t colon = field.find(':');
+            if (colon == std::string_view::npos) {
+                ++malformed_lines_;
+                continue;
+            }
+            std::string_view name = field.substr(0, colon);
+            std::string_view value = field.substr(colon + 1);
+            while (!value.empty() && (value.front() == ' ' || value.front() == '\t')) value.remove_prefix(1);
+
+            if (detail::iequals(name, "Content-Length")) {
+                std::size_t length = 0;
+                bad_length |= !parse_length(value, length) || (has_length && length != content_length_);
+                content_length_ = length;
+                has_length = true;
+            } else if (detail::iequals(name, "Transfer-Encoding")) {
+                chunked |= !value.empty();
+            }
+            // Names are stored lower-cased, once, so lookups never fold case on both sides.
+            std::string key(name);
+            for (char& c : key) c = detail::ascii_lower(c);
+            request.headers.insert_or_assign(std::move(key), std::string(value));
+        }
+        if (chunked) return ParseStatus::UnsupportedTransferEncoding;
+        if (bad_length) return ParseStatus::BadContentLength;
+        if (content_length_ > limits_.max_body_size) return ParseStatus::BodyTooLarge;
+        return ParseStatus::Complete;
+    }
+
+    // Offset of the request line's CRLF (valid once scan() got past it).
+    inline std::size_t line_end() const { return line_end_; }
+    // Offset of the first body byte (valid after HeadComplete).
+    inline std::size_t body_start() const { return head_end_ + 4; }
+    // Body length from Content-Length, 0 without one (valid after Complete).
+    inline std::size_t content_length() const { return content_length_; }
+    // Why the target was refused when parse_head() returned BadTarget.
+    inline PathStatus path_status() const { return path_status_; }
+    // Header lines without ':' that were skipped.
+    inline std::size_t malformed_lines() const { return malformed_lines_; }
+
+private:
+    // Content-Length = 1*DIGIT (plus trailing whitespace), without overflow.
+    static inline bool parse_length(std::string_view value, std::size_t& length) {
+        while (!value.empty() && (value.back() == ' ' || value.back() == '\t')) value.remove_suffix(1);
+        if (value.empty() || value.size() > 18) return false;
+        length = 0;
+        for (char c : value) {
+            if (c < '0' || c > '9') return false;
+            length = length * 10 + static_cast<std::size_t>(c - '0');
+        }
+        return true;
+    }
+
+    ParserLimits limits_;
+    std::size_t scanned_ = 0; // Bytes of the buffer already searched
+    std::size_t line_end_ = std::string::npos;
+    std::size_t head_end_ = std::string::npos;
+    std::size_t content_length_ = 0;
+    std::size_t malformed_lines_ = 0;
+    PathStatus path_status_ = PathStatus::Ok;
+};
+
+} // namespace Haka
+
+#endif // HAKA_PARSER_HPP
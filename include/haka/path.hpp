@@ -0,0 +1,232 @@
+#ifndef HAKA_PATH_HPP
+#define HAKA_PATH_HPP
+
+// Project includes
+#include "haka/utf8.hpp" // For validate_utf8
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace Haka {
+
+/**
+ * @brief Outcome of normalizing a request target.
+ */
+enum class PathStatus : uint8_t {
+    Ok,
+    BadTarget,   // Not origin-form ("/...") or "*", or contains a raw NUL
+    BadEncoding, // '%' not followed by two hex digits
+    EncodedControl, // "%00"-"%1F" or "%7F" (e.g., an encoded CR or LF)
+    Traversal,   // ".." would climb above the root
+    BadUtf8      // Decoded path is not well-formed UTF-8
+};
+
+inline const char* path_status_name(PathStatus status) {
+    switch (status) {
+        case PathStatus::Ok: return "ok";
+        case PathStatus::BadTarget: return "bad target";
+        case PathStatus::BadEncoding: return "bad percent-encoding";
+        case PathStatus::EncodedControl: return "encoded control character";
+        case PathStatus::Traversal: return "path traversal";
+        case PathStatus::BadUtf8: return "invalid UTF-8";
+    }
+    return "unknown";
+}
+
+namespace detail {
+
+inline int hex_value(unsigned char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    c |= 0x20; // Lower-case letters
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    return -1;
+}
+
+/**
+ * @brief Finds the first '%' or NUL byte, 16 bytes per step with SSE2.
+ * Most paths contain no escapes, so this usually runs to the end.
+ * @return Its offset, or n if there is none.
+ */
+inline std::size_t find_escape(const char* p, std::size_t n) {
+    std::size_t i = 0;
+#if defined(__SSE2__)
+    const __m128i percent = _mm_set1_epi8('%');
+    const __m128i zero = _mm_setzero_si128();
+    for (; i + 16 <= n; i += 16) {
+        __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i));
+        int mask = _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(chunk, percent), _mm_cmpeq_epi8(chunk, zero)));
+        if (mask != 0) return i + static_cast<std::size_t>(__builtin_ctz(static_cast<unsigned>(mask)));
+    }
+#endif
+    for (; i < n; ++i) {
+        if (p[i] == '%' || p[i] == '\0') return i;
+    }
+    return n;
+}
+
+/**
+ * @brief Decodes %XX escapes in place.
+ * @return The decoded length (never longer than size).
+ */
+inline std::size_t percent_decode(char* data, std::size_t size, PathStatus& status) {
+    std::size_t in = 0;
+    std::size_t out = 0;
+    while (in < size) {
+        std::size_t run = find_escape(data + in, size - in);
+        if (run > 0 && out != in) std::memmove(data + out, data + in, run);
+        in += run;
+        out += run;
+        if (in == size) break;
+        if (data[in] == '\0') {
+            status = PathStatus::BadTarget;
+            return out;
+        }
+        if (in + 2 >= size) {
+            status = PathStatus::BadEncoding;
+            return out;
+        }
+        int hi = hex_value(static_cast<unsigned char>(data[in + 1]));
+        int lo = hex_value(static_cast<unsigned char>(data[in + 2]));
+        if (hi < 0 || lo < 0) {
+            status = PathStatus::BadEncoding;
+            return out;
+        }
+        int decoded = (hi << 4) | lo;
+        if (decoded < 0x20 || decoded == 0x7f) {
+            status = PathStatus::EncodedControl;
+            return out;
+        }
+        data[out++] = static_cast<char>(decoded);
+        in += 3;
+    }
+    return out;
+}
+
+/**
+ * @brief Collapses repeated slashes and resolves "." and ".." segments in
+ * place (RFC 3986 section 5.2.4). data[0] must be '/'.
+ * @return The new length.
+ */
+inline std::size_t remove_dot_segments(char* data, std::size_t size, PathStatus& status) {
+    std::size_t in = 0;
+    std::size_t out = 0; // data[0, out) holds "/seg/seg" with no trailing slash
+    bool trailing_slash = false;
+    while (in < size) {
+        while (in < size && data[in] == '/') ++in;
+        std::size_t start = in;
+        while (in < size && data[in] != '/') ++in;
+        std::size_t length = in - start;
+
+        if (length == 0) {
+            trailing_slash = true; // Path ended with one or more slashes
+        } else if (length == 1 && data[start] == '.') {
+            trailing_slash = true;
+        } else if (length == 2 && data[start] == '.' && data[start + 1] == '.') {
+            if (out == 0) {
+                status = PathStatus::Traversal;
+                return 0;
+            }
+            while (out > 0 && data[--out] != '/') {
+            }
+            trailing_slash = true;
+        } else {
+            data[out++] = '/';
+            if (out != start) std::memmove(data + out, data + start, length);
+            out += length;
+            trailing_slash = false;
+        }
+    }
+    if (trailing_slash || out == 0) data[out++] = '/';
+    return out;
+}
+
+} // namespace detail
+
+/**
+ * @brief Turns a raw request target into the path the router matches, in
+ * place: splits off the query string, percent-decodes, collapses "//", and
+ * resolves "." and "..". Runs once per request while parsing, so routing and
+ * static file lookup can trust the path without touching the filesystem.
+ * Encoded control characters (NUL, CR, LF, ...) and ".." segments that
+ * would leave the root are rejected
+ * rather than clamped, as are paths that don't decode to valid UTF-8.
+ * Decoding happens before dot-segment removal, so "%2e%2e" and "..%2f" are
+ * caught too.
+ * @param data The request target; overwritten with the normalized path.
+ * @param size Length of the target.
+ * @param path_size Receives the length of the normalized path.
+ * @param query Receives the raw (still encoded) query string, without '?'.
+ * @return PathStatus::Ok, or why the target was rejected.
+ */
+inline PathStatus normalize_request_target(char* data, std::size_t size, std::size_t& path_size, std::string& query) {
+    path_size = 0;
+    query.clear();
+    if (size == 1 && data[0] == '*') { // OPTIONS *
+        path_size = 1;
+        return PathStatus::Ok;
+    }
+    if (size == 0 || data[0] != '/') return PathStatus::BadTarget;
+
+    auto* mark = static_cast<char*>(std::memchr(data, '?', size));
+    std::size_t length = size;
+    if (mark) {
+        length = static_cast<std::size_t>(mark - data);
+        query.assign(mark + 1, size - length - 1);
+    }
+
+    PathStatus status = PathStatus::Ok;
+    length = detail::percent_decode(data, length, status);
+    if (status != PathStatus::Ok) return status;
+    if (!validate_utf8(std::string_view(data, length))) return PathStatus::BadUtf8;
+    length = detail::remove_dot_segments(data, length, status);
+    if (status != PathStatus::Ok) return status;
+    path_size = length;
+    return PathStatus::Ok;
+}
+
+/**
+ * @brief Percent-encodes a normalized path for use in a request line,
+ * the reverse of the decoding in normalize_request_target. Unreserved
+ * characters, sub-delims, ':', '@' and '/' are kept; everything else
+ * (space, '%', '?', '#', non-ASCII bytes, ...) is escaped.
+ * @param path The decoded path.
+ * @param out The buffer to append to.
+ */
+inline void append_encoded_path(std::string_view path, std::string& out) {
+    static constexpr char kHex[] = "0123456789ABCDEF";
+    for (char c : path) {
+        auto byte = static_cast<unsigned char>(c);
+        bool keep = (byte >= 'a' && byte <= 'z') || (byte >= 'A' && byte <= 'Z') || (byte >= '0' && byte <= '9') ||
+                    std::strchr("-._~!$&'()*+,;=:@/", c) != nullptr;
+        if (keep && byte != 0) {
+            out += c;
+        } else {
+            out += '%';
+            out += kHex[byte >> 4];
+            out += kHex[byte & 0x0f];
+        }
+    }
+}
+
+/**
+ * @brief normalize_request_target for a target held in a std::string.
+ * @param target The target; replaced by the normalized path on success.
+ * @param query Receives the raw query string.
+ */
+inline PathStatus normalize_request_target(std::string& target, std::string& query) {
+    std::size_t path_size = 0;
+    PathStatus status = normalize_request_target(target.data(), target.size(), path_size, query);
+    if (status == PathStatus::Ok) target.resize(path_size);
+    return status;
+}
+
+} // namespace Haka
+
+#endif // HAKA_PATH_HPP
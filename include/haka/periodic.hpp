@@ -0,0 +1,262 @@
+#ifndef HAKA_PERIODIC_HPP
+#define HAKA_PERIODIC_HPP
+
+// External library includes (Asio for the timer)
+#define ASIO_STANDALONE
+#include <asio.hpp>
+
+// Project includes
+#include "haka/core.hpp"      // For log_message
+#include "haka/metrics.hpp"   // For append_metric
+#include "haka/scheduler.hpp" // For Scheduler, PriorityClass
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace Haka {
+
+/**
+ * @brief Settings for a task registered with Server::every.
+ */
+struct PeriodicOptions {
+    // Name used in logs and in the task="..." metric label.
+    std::string name = "task";
+    // Each run is delayed by a random fraction of the interval up to this
+    // (0.1 = up to 10%), so instances started together don't fire together.
+    // Runs stay anchored to the original schedule; jitter does not accumulate.
+    double jitter = 0.1;
+    // Run on the handler worker pool instead of the io thread. Use this for
+    // anything that blocks (file or network I/O, heavy compaction).
+    bool on_workers = false;
+    // Scheduler class for on_workers tasks.
+    PriorityClass priority = PriorityClass::Batch;
+    // Also run once right away instead of waiting a full interval.
+    bool run_immediately = false;
+};
+
+/**
+ * @brief Runs periodic tasks from a single timer on the io thread. Due times
+ * live in one min-heap, and the timer is always armed for the earliest one,
+ * so any number of tasks costs one pending timer. A task never overlaps
+ * itself: if a run is still going (or queued) when the next one is due, that
+ * run is skipped and counted. Per-task runs, skips, failures and durations
+ * are exported as metrics.
+ */
+class PeriodicScheduler {
+public:
+    using Clock = std::chrono::steady_clock;
+    using Task = std::function<void()>;
+
+    /**
+     * @param io The io_context whose thread runs the timer (and io tasks).
+     * @param workers Pool for PeriodicOptions::on_workers tasks, or nullptr to
+     * run everything on the io thread (ServerConfig::handler_threads == 0).
+     */
+    inline PeriodicScheduler(asio::io_context& io, Scheduler* workers)
+        : io_(io), workers_(workers), timer_(io), rng_(std::random_device{}()) {}
+
+    PeriodicScheduler(const PeriodicScheduler&) = delete;
+    PeriodicScheduler& operator=(const PeriodicScheduler&) = delete;
+
+    /**
+     * @brief Registers a task. Callable from any thread, before or after the
+     * server starts.
+     * @param interval Time between runs (must be positive).
+     * @param task The work.
+     * @param options Name, jitter and where the task runs.
+     * @return An ID for cancel().
+     * @throws std::invalid_argument if the interval is not positive.
+     */
+    inline uint64_t every(Clock::duration interval, Task task, PeriodicOptions options = {}) {
+        if (interval <= Clock::duration::zero()) {
+            throw std::invalid_argument("Periodic task '" + options.name + "': interval must be positive");
+        }
+        auto entry = std::make_shared<Entry>();
+        entry->interval = interval;
+        entry->task = std::move(task);
+        entry->options = std::move(options);
+        entry->labels = "task=\"" + entry->options.name + "\"";
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            entry->id = ++next_id_;
+            entries_.emplace(entry->id, entry);
+        }
+        asio::post(io_, [this, entry]() {
+            entry->anchor = Clock::now();
+            Clock::time_point first = entry->options.run_immediately ? entry->anchor : next_due(*entry);
+            heap_.push({first, entry->id});
+            arm();
+        });
+        log_message("DEBUG", fmt::format("Periodic task '{}' registered", entry->options.name));
+        return entry->id;
+    }
+
+    /**
+     * @brief Stops a task. A run already in progress finishes.
+     * @param id The ID returned by every().
+     */
+    inline void cancel(uint64_t id) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        entries_.erase(id); // Its heap entry is dropped when it comes up
+    }
+
+    /**
+     * @brief Appends per-task metrics in Prometheus text format.
+     * @param out The buffer to append to.
+     */
+    inline void collect_metrics(std::string& out) const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (entries_.empty()) return;
+        out += "# TYPE haka_periodic_runs_total counter\n";
+        for (const auto& [id, entry] : entries_) {
+            append_metric(out, "haka_periodic_runs_total", entry->labels, entry->runs.load(std::memory_order_relaxed));
+        }
+        out += "# TYPE haka_periodic_skipped_total counter\n";
+        for (const auto& [id, entry] : entries_) {
+            append_metric(out, "haka_periodic_skipped_total", entry->labels, entry->skipped.load(std::memory_order_relaxed));
+        }
+        out += "# TYPE haka_periodic_failures_total counter\n";
+        for (const auto& [id, entry] : entries_) {
+            append_metric(out, "haka_periodic_failures_total", entry->labels, entry->failures.load(std::memory_order_relaxed));
+        }
+        out += "# TYPE haka_periodic_duration_seconds_sum counter\n";
+        for (const auto& [id, entry] : entries_) {
+            append_metric(out, "haka_periodic_duration_seconds_sum", entry->labels, entry->total_us.load(std::memory_order_relaxed) / 1e6);
+        }
+        out += "# TYPE haka_periodic_last_duration_seconds gauge\n";
+        for (const auto& [id, entry] : entries_) {
+            append_metric(out, "haka_periodic_last_duration_seconds", entry->labels, entry->last_us.load(std::memory_order_relaxed) / 1e6);
+        }
+        out += "# TYPE haka_periodic_max_duration_seconds gauge\n";
+        for (const auto& [id, entry] : entries_) {
+            append_metric(out, "haka_periodic_max_duration_seconds", entry->labels, entry->max_us.load(std::memory_order_relaxed) / 1e6);
+        }
+    }
+
+private:
+    struct Entry {
+        uint64_t id = 0;
+        Clock::duration interval{};
+        Task task;
+        PeriodicOptions options;
+        std::string labels;
+        Clock::time_point anchor;  // Unjittered time of the last scheduled run (io thread only)
+        std::atomic<bool> running{false};
+        std::atomic<uint64_t> runs{0};
+        std::atomic<uint64_t> skipped{0};
+        std::atomic<uint64_t> failures{0};
+        std::atomic<uint64_t> total_us{0};
+        std::atomic<uint64_t> last_us{0};
+        std::atomic<uint64_t> max_us{0};
+    };
+
+    struct Due {
+        Clock::time_point when;
+        uint64_t id;
+        inline bool operator>(const Due& other) const { return when > other.when; }
+    };
+
+    // Advances the anchor by one interval and adds this run's jitter.
+    inline Clock::time_point next_due(Entry& entry) {
+        entry.anchor += entry.interval;
+        auto now = Clock::now();
+        if (entry.anchor < now) entry.anchor = now; // Fell behind (e.g., a long io-thread task)
+        Clock::duration jitter{};
+        if (entry.options.jitter > 0) {
+            std::uniform_real_distribution<double> fraction(0.0, entry.options.jitter);
+            jitter = std::chrono::duration_cast<Clock::duration>(entry.interval * fraction(rng_));
+        }
+        return entry.anchor + jitter;
+    }
+
+    // Arms the timer for the earliest due task. io thread only. Re-arming
+    // cancels the previous wait, whose handler then sees operation_aborted.
+    inline void arm() {
+        if (heap_.empty()) return;
+        if (armed_for_ == heap_.top().when) return;
+        armed_for_ = heap_.top().when;
+        timer_.expires_at(armed_for_);
+        timer_.async_wait([this](asio::error_code ec) {
+            if (ec == asio::error::operation_aborted) return;
+            armed_for_ = Clock::time_point{};
+            fire_due();
+        });
+    }
+
+    inline void fire_due() {
+        auto now = Clock::now();
+        while (!heap_.empty() && heap_.top().when <= now) {
+            Due due = heap_.top();
+            heap_.pop();
+            std::shared_ptr<Entry> entry;
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                auto it = entries_.find(due.id);
+                if (it == entries_.end()) continue; // Cancelled
+                entry = it->second;
+            }
+            heap_.push({next_due(*entry), entry->id});
+            start(entry);
+        }
+        arm();
+    }
+
+    inline void start(const std::shared_ptr<Entry>& entry) {
+        if (entry->running.exchange(true, std::memory_order_acq_rel)) {
+            entry->skipped.fetch_add(1, std::memory_order_relaxed);
+            log_message("DEBUG", fmt::format("Periodic task '{}' still running, skipping this run", entry->options.name));
+            return;
+        }
+        if (!entry->options.on_workers || !workers_) {
+            run(*entry);
+            return;
+        }
+        workers_->submit(entry->options.priority, Clock::time_point::max(), entry->options.name,
+                         [entry]() { run(*entry); },
+                         [entry]() {
+                             entry->skipped.fetch_add(1, std::memory_order_relaxed);
+                             entry->running.store(false, std::memory_order_release);
+                         });
+    }
+
+    static inline void run(Entry& entry) {
+        auto start = Clock::now();
+        try {
+            entry.task();
+        } catch (const std::exception& e) {
+            entry.failures.fetch_add(1, std::memory_order_relaxed);
+            log_message("ERROR", fmt::format("Periodic task '{}' threw: {}", entry.options.name, e.what()));
+        }
+        auto us = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - start).count());
+        entry.runs.fetch_add(1, std::memory_order_relaxed);
+        entry.total_us.fetch_add(us, std::memory_order_relaxed);
+        entry.last_us.store(us, std::memory_order_relaxed);
+        uint64_t max = entry.max_us.load(std::memory_order_relaxed);
+        while (us > max && !entry.max_us.compare_exchange_weak(max, us, std::memory_order_relaxed)) {
+        }
+        entry.running.store(false, std::memory_order_release);
+    }
+
+    asio::io_context& io_;
+    Scheduler* workers_;
+    asio::steady_timer timer_;
+    Clock::time_point armed_for_{}; // Expiry of the pending wait, or epoch if none
+    std::priority_queue<Due, std::vector<Due>, std::greater<Due>> heap_; // io thread only
+    std::mt19937_64 rng_;                                               // io thread only
+    mutable std::mutex mutex_; // Guards entries_ (registration, cancel, metrics)
+    std::unordered_map<uint64_t, std::shared_ptr<Entry>> entries_;
+    uint64_t next_id_ = 0;
+};
+
+} // namespace Haka
+
+#endif // HAKA_PERIODIC_HPP
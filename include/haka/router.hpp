@@ -3,18 +3,95 @@
 
 // Project includes
 #include "haka/core.hpp" // For Request, Response, RouteHandler, log_message
+#include "haka/scheduler.hpp" // For PriorityClass
+#include "haka/cors.hpp" // For CorsPolicy
+#include "haka/session.hpp" // For SessionStore::commit
+#include "haka/zstd.hpp" // For ZstdDictionary::encode (HAKA_ENABLE_ZSTD)
+#include "haka/open_file_cache.hpp" // For OpenFileCache (POSIX only)
 
 #include <vector>
 #include <utility> // For std::pair
 #include <string>
+#include <string_view>
 #include <unordered_map>
 #include <functional> // For std::function
 #include <filesystem> // For path manipulation and checks
 #include <sstream> // For std::istringstream
+#include <chrono> // For route timeouts
+#include <memory> // For std::shared_ptr
 
 
 namespace Haka {
 
+class ZstdDictionary; // Defined in haka/zstd.hpp (HAKA_ENABLE_ZSTD)
+
+/**
+ * @brief Per-route settings applied by the server when it runs the handler.
+ */
+struct RouteOptions {
+    // Maximum time the handler may take before the client gets a 504.
+    // Zero means "use the server-wide handler_timeout".
+    std::chrono::milliseconds timeout{0};
+
+    // Scheduling class used when handler workers are saturated.
+    PriorityClass priority = PriorityClass::Normal;
+
+    // Name of a shadow upstream registered with Server::addMirror. Copies of
+    // mirror_percent% of this route's requests are sent there after the
+    // primary response. Empty disables mirroring.
+    std::string mirror{};
+    double mirror_percent = 100.0;
+
+    // Run in order on the handler thread before the handler; any of them can
+    // answer the request itself (e.g., jwt_bearer() with a 401).
+    std::vector<RouteFilter> filters{};
+
+    // Reject request bodies that are not well-formed UTF-8 with a 400, before
+    // the handler runs (e.g., ahead of JSON parsing). Checked while the body
+    // is read. Paths are always checked.
+    bool validate_utf8 = false;
+
+    // Compress successful responses with this zstd dictionary for clients
+    // that have it (Content-Encoding: dcz), or with plain zstd for clients
+    // that accept that. Needs HAKA_ENABLE_ZSTD; see Server::serve_dictionary.
+    std::shared_ptr<const ZstdDictionary> dictionary{};
+};
+
+/**
+ * @brief A registered handler together with its options.
+ */
+struct Route {
+    RouteHandler handler;
+    RouteOptions options;
+};
+
+/**
+ * @brief Runs a route's filters, then its handler unless a filter answered,
+ * then sets the session cookie if the request started or ended a session,
+ * and finally compresses the response if the route has a dictionary.
+ * @param route The matched route.
+ * @param req The request; filters may annotate it.
+ * @param res The response being built.
+ */
+inline void invoke_route(const Route& route, Request& req, Response& res) {
+    try {
+        bool admitted = true;
+        for (const auto& filter : route.options.filters) {
+            if (!(admitted = filter(req, res))) break;
+        }
+        if (admitted) route.handler(req, res);
+    } catch (...) {
+        // The caller turns this into a 500 on the same Response; the session
+        // the handler started still needs its cookie (or its removal).
+        SessionStore::commit(req, res);
+        throw;
+    }
+    SessionStore::commit(req, res);
+#if defined(HAKA_ENABLE_ZSTD)
+    if (route.options.dictionary) route.options.dictionary->encode(req, res);
+#endif
+}
+
 /**
  * @brief Manages the mapping of incoming requests (method, path) to
  * the appropriate RouteHandler functions. Supports static file serving
@@ -35,9 +112,10 @@ public:
      * The path is combined with the current group prefix.
      * @param path The URL path segment for this route.
      * @param handler The function to execute for this route.
+     * @param options Per-route settings such as the handler timeout.
      */
-    inline void Get(const std::string& path, RouteHandler handler) {
-        add_route("GET", path, handler);
+    inline void Get(const std::string& path, RouteHandler handler, RouteOptions options = {}) {
+        add_route("GET", path, handler, options);
     }
 
     /**
@@ -45,9 +123,10 @@ public:
      * The path is combined with the current group prefix.
      * @param path The URL path segment for this route.
      * @param handler The function to execute for this route.
+     * @param options Per-route settings such as the handler timeout.
      */
-    inline void Post(const std::string& path, RouteHandler handler) {
-        add_route("POST", path, handler);
+    inline void Post(const std::string& path, RouteHandler handler, RouteOptions options = {}) {
+        add_route("POST", path, handler, options);
     }
 
     // TODO: Add methods for other HTTP methods (Put, Delete, Patch, Options, Head)
@@ -55,7 +134,8 @@ public:
     /**
      * @brief Registers a directory for serving static files under a specific URL prefix.
      * Files requested under the URL prefix will be served from the corresponding
-     * location in the filesystem path. Includes basic path traversal protection.
+     * location in the filesystem path. Request paths arrive already normalized
+     * (see normalize_request_target), so they cannot climb out of the directory.
      * @param path_prefix The URL prefix (e.g., "/static").
      * @param fs_path The filesystem path (e.g., "./public").
      */
@@ -63,11 +143,58 @@ public:
         // Normalize the URL prefix: ensure it starts with '/' and remove trailing '/' unless it's just "/"
         std::string clean_prefix = normalize_path_segment(path_prefix);
 
-        // Store the cleaned prefix and the filesystem path
-        static_paths_.push_back({clean_prefix, fs_path});
+        // Store the cleaned prefix and the absolute filesystem path (resolved once here,
+        // not per request)
+        static_paths_.push_back({clean_prefix, std::filesystem::absolute(fs_path).lexically_normal().string()});
         log_message("INFO", fmt::format("Serving static files from '{}' at URL prefix '{}'", fs_path, clean_prefix));
     }
 
+#if !defined(_WIN32)
+    /**
+     * @brief Looks static files up through an open file cache instead of
+     * stat()ing and opening them on every request. Applies to every static
+     * directory, including those of mounted routers.
+     * @param cache The cache, or null to go back to uncached lookups.
+     */
+    inline void open_file_cache(std::shared_ptr<OpenFileCache> cache) {
+        open_files_ = std::move(cache);
+    }
+#endif
+
+    /**
+     * @brief Enables CORS for every path under the current group prefix (or
+     * all paths at the top level). Preflights are answered by the server from
+     * buffers compiled here; matched responses get the CORS headers appended.
+     * The most specific prefix wins when groups set different policies.
+     * @param config Allowed origins, methods, headers, and preflight max-age.
+     * @throws std::invalid_argument if the configuration is invalid.
+     */
+    inline void cors(const CorsConfig& config) {
+        std::string prefix = normalize_path_segment(current_group_prefix_);
+        cors_policies_.push_back({prefix, std::make_shared<const CorsPolicy>(config)});
+        log_message("INFO", fmt::format("CORS enabled under '{}'", prefix));
+    }
+
+    /**
+     * @brief Finds the CORS policy covering a path.
+     * @param path The normalized request path.
+     * @return The policy with the longest matching prefix, or nullptr.
+     */
+    inline const CorsPolicy* cors_policy(std::string_view path) const {
+        const CorsPolicy* best = nullptr;
+        std::size_t best_length = 0;
+        for (const auto& entry : cors_policies_) {
+            const std::string& prefix = entry.first;
+            bool covers = prefix == "/" ||
+                          (path.starts_with(prefix) && (path.size() == prefix.size() || path[prefix.size()] == '/'));
+            if (covers && (!best || prefix.size() > best_length)) {
+                best = entry.second.get();
+                best_length = prefix.size();
+            }
+        }
+        return best;
+    }
+
     /**
      * @brief Defines a group of routes that share a common URL prefix.
      * Handlers defined within the config_func will have the prefix applied.
@@ -130,17 +257,23 @@ public:
             static_paths_.push_back({full_static_prefix, fs_path});
             log_message("INFO", fmt::format("   Mounted static path: '{}' from '{}' at URL prefix '{}'", fs_path, other_prefix, full_static_prefix));
         }
+
+        // Merge CORS policies (shared, they are immutable)
+        for (const auto& cors_entry : other_router.cors_policies_) {
+            cors_policies_.push_back({normalize_path_segment(mount_prefix + normalize_path_segment(cors_entry.first)), cors_entry.second});
+        }
     }
 
 
     /**
-     * @brief Finds the appropriate handler for a given request.
+     * @brief Finds the appropriate route for a given request.
      * Checks static file routes first, then registered explicit routes.
-     * Returns a 404 handler if no match is found.
+     * Returns a 404 route if no match is found. Static files and 404s
+     * use default RouteOptions.
      * @param req The incoming Request object.
-     * @return The RouteHandler function to process the request.
+     * @return The Route (handler and options) to process the request.
      */
-    inline RouteHandler match(const Request& req) const {
+    inline Route match(const Request& req) const {
         log_message("DEBUG", fmt::format("Attempting to match request: {} {}", req.method, req.path));
 
         // 1. Check Static Files first
@@ -153,7 +286,8 @@ public:
             // Check if the request path starts with the static URL prefix
             // We need to handle the case where the prefix is "/"
             bool prefix_matches = (url_prefix == "/" && req.path == "/") ||
-                                  (url_prefix != "/" && req.path_starts_with(url_prefix + "/"));
+                                  (url_prefix != "/" && req.path.size() > url_prefix.size() &&
+                                   req.path_starts_with(url_prefix) && req.path[url_prefix.size()] == '/');
 
              // Special case: if url_prefix is "/" and req.path starts with "/", it's a match
              if (url_prefix == "/" && req.path.starts_with("/")) prefix_matches = true;
@@ -175,48 +309,43 @@ public:
                      file_sub_path = "/index.html";
                 }
 
-                // Construct the full filesystem path
-                // Ensure fs_root is treated as a directory base
-                std::filesystem::path fs_root_path = std::filesystem::absolute(fs_root);
-                // Remove leading slash from file_sub_path for joining
-                std::filesystem::path relative_path = (file_sub_path.length() > 0 && file_sub_path[0] == '/') ? file_sub_path.substr(1) : file_sub_path;
-                std::filesystem::path full_fs_path = fs_root_path / relative_path;
+                // Construct the full filesystem path. fs_root is absolute, and the request
+                // path was normalized while parsing (no "..", no encoded control characters), so the
+                // result stays under fs_root without resolving it against the filesystem.
+                std::string_view relative_path = file_sub_path;
+                if (!relative_path.empty() && relative_path[0] == '/') {
+                    relative_path.remove_prefix(1);
+                }
+                std::filesystem::path full_fs_path = std::filesystem::path(fs_root) / relative_path;
 
                 log_message("DEBUG", fmt::format("  Attempting to serve file: {}", full_fs_path.string()));
 
-                // Basic security check: ensure the resolved path is within the served directory
-                // This helps prevent directory traversal attacks.
-                try {
-                     // Use canonical to resolve symlinks and ..
-                     std::filesystem::path canonical_fs_root = std::filesystem::canonical(fs_root_path);
-                     std::filesystem::path canonical_full_path = std::filesystem::canonical(full_fs_path);
-
-                     if (!canonical_full_path.string().starts_with(canonical_fs_root.string())) {
-                        log_message("WARN", fmt::format("Attempted directory traversal: {}", req.path));
-                        // Return a handler for Bad Request
-                        return [](const Request& r, Response& res) {
-                            res.status_code = 400; // Bad Request
-                            res.Text("Invalid path.");
-                        };
-                     }
-                } catch (const std::filesystem::filesystem_error& e) {
-                     // If canonical fails (e.g., file doesn't exist), it's not necessarily an error,
-                     // but we should log the attempt and let the exists check handle it.
-                     log_message("DEBUG", fmt::format("Filesystem error during canonical path check for {}: {}", req.path, e.what()));
-                     // Continue to exists check below
+#if !defined(_WIN32)
+                if (open_files_) {
+                    // A cached lookup, found or missing, usually costs no syscalls.
+                    std::string file_path = full_fs_path.string();
+                    std::shared_ptr<const OpenFile> file = open_files_->open(file_path);
+                    if (file->regular) {
+                        log_message("INFO", fmt::format("Serving static file: {}", file_path));
+                        return Route{[file, file_path](const Request&, Response& res) {
+                            send_open_file(res, *file, file_path);
+                        }, {}};
+                    }
+                    log_message("DEBUG", fmt::format("  Static file not found or not a regular file: {}", file_path));
+                    continue;
                 }
-
+#endif
 
                 // Check if the file exists and is a regular file
                 if (std::filesystem::exists(full_fs_path) && std::filesystem::is_regular_file(full_fs_path)) {
                     log_message("INFO", fmt::format("Serving static file: {}", full_fs_path.string()));
                     // Return a handler that serves the file
-                    return [file_path = full_fs_path.string()](const Request& r, Response& res) {
+                    return Route{[file_path = full_fs_path.string()](const Request& r, Response& res) {
                         if (!res.sendFile(file_path)) {
                             // sendFile already logs errors and sets 500 status on failure
                             // No need to do more here unless you want a different 500 message
                         }
-                    };
+                    }, {}};
                 } else {
                      log_message("DEBUG", fmt::format("  Static file not found or not a regular file: {}", full_fs_path.string()));
                      // Continue to check explicit routes if static file not found
@@ -227,14 +356,22 @@ public:
         }
 
         // 2. Check registered explicit routes
-        std::string normalized_req_path = normalize_path_segment(req.path);
-        std::string lookup_key = req.method + " " + normalized_req_path;
+        // The path is already normalized; only a trailing slash differs from the
+        // registered form. The key buffer is reused so matching doesn't allocate.
+        std::string_view req_path = req.path;
+        if (req_path.size() > 1 && req_path.back() == '/') {
+            req_path.remove_suffix(1);
+        }
+        thread_local std::string lookup_key;
+        lookup_key.assign(req.method);
+        lookup_key += ' ';
+        lookup_key += req_path;
         log_message("DEBUG", fmt::format(" Checking explicit route for key: '{}'", lookup_key));
 
         auto it = routes_.find(lookup_key);
         if (it != routes_.end()) {
             log_message("INFO", fmt::format("Matched explicit route: {} {}", req.method, req.path));
-            return it->second; // Return the found handler
+            return it->second; // Return the found route
         } else {
              log_message("DEBUG", fmt::format(" No explicit route found for key: '{}'", lookup_key));
         }
@@ -242,10 +379,10 @@ public:
 
         // 3. No match found - return a 404 Not Found handler
         log_message("INFO", fmt::format("Route not found: {} {}", req.method, req.path));
-        return [](const Request& r, Response& res) {
+        return Route{[](const Request& r, Response& res) {
             res.status_code = 404;
             res.Text(fmt::format("Not found: {}", r.path));
-        };
+        }, {}};
     }
 
 private:
@@ -255,13 +392,14 @@ private:
      * @param method The HTTP method (e.g., "GET", "POST").
      * @param path The route path segment.
      * @param handler The handler function.
+     * @param options Per-route settings stored alongside the handler.
      */
-    inline void add_route(const std::string& method, const std::string& path, RouteHandler handler) {
+    inline void add_route(const std::string& method, const std::string& path, RouteHandler handler, RouteOptions options) {
         // Combine the current group prefix with the route path
         std::string full_path = normalize_path_segment(current_group_prefix_ + normalize_path_segment(path));
 
-        // Store the handler mapped to "METHOD /full/path"
-        routes_[method + " " + full_path] = handler;
+        // Store the route mapped to "METHOD /full/path"
+        routes_[method + " " + full_path] = Route{handler, options};
         log_message("INFO", fmt::format("Registered route: {} {}", method, full_path));
     }
 
@@ -285,12 +423,20 @@ private:
     }
 
 
-    // Internal storage for explicit routes: maps "METHOD /full/path" to handler
-    std::unordered_map<std::string, RouteHandler> routes_;
+    // Internal storage for explicit routes: maps "METHOD /full/path" to its route
+    std::unordered_map<std::string, Route> routes_;
 
     // Internal storage for static file configurations: {url_prefix, fs_path}
     std::vector<std::pair<std::string, std::string>> static_paths_;
 
+    // CORS policies by URL prefix
+    std::vector<std::pair<std::string, std::shared_ptr<const CorsPolicy>>> cors_policies_;
+
+#if !defined(_WIN32)
+    // Static file lookups go through this when set (Server::open_file_cache).
+    std::shared_ptr<OpenFileCache> open_files_;
+#endif
+
     // Internal state to track the current prefix when defining routes within a group
     std::string current_group_prefix_ = ""; // Start with empty prefix for the root level
 };
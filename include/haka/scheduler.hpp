@@ -0,0 +1,510 @@
+#ifndef HAKA_SCHEDULER_HPP
+#define HAKA_SCHEDULER_HPP
+
+// Project includes
+#include "haka/core.hpp"    // For log_message
+#include "haka/metrics.hpp" // For append_metric
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+namespace Haka {
+
+namespace detail {
+
+/**
+ * @brief SipHash-2-4 of `data` under a 128-bit key. A keyed PRF, so flow
+ * collisions can't be computed without the key, unlike std::hash, whose
+ * seed is fixed and public.
+ */
+inline uint64_t siphash24(const std::array<uint64_t, 2>& key, std::string_view data) {
+    auto rotl = [](uint64_t x, int b) { return (x << b) | (x >> (64 - b)); };
+    uint64_t v0 = 0x736f6d6570736575ULL ^ key[0];
+    uint64_t v1 = 0x646f72616e646f6dULL ^ key[1];
+    uint64_t v2 = 0x6c7967656e657261ULL ^ key[0];
+    uint64_t v3 = 0x7465646279746573ULL ^ key[1];
+    auto round = [&] {
+        v0 += v1; v1 = rotl(v1, 13); v1 ^= v0; v0 = rotl(v0, 32);
+        v2 += v3; v3 = rotl(v3, 16); v3 ^= v2;
+        v0 += v3; v3 = rotl(v3, 21); v3 ^= v0;
+        v2 += v1; v1 = rotl(v1, 17); v1 ^= v2; v2 = rotl(v2, 32);
+    };
+    auto compress = [&](uint64_t m) {
+        v3 ^= m;
+        round();
+        round();
+        v0 ^= m;
+    };
+    std::size_t size = data.size();
+    const auto* p = reinterpret_cast<const unsigned char*>(data.data());
+    for (; size >= 8; size -= 8, p += 8) {
+        uint64_t m = 0;
+        for (int i = 7; i >= 0; --i) m = (m << 8) | p[i]; // Little-endian
+        compress(m);
+    }
+    uint64_t last = static_cast<uint64_t>(data.size()) << 56;
+    for (std::size_t i = 0; i < size; ++i) last |= static_cast<uint64_t>(p[i]) << (8 * i);
+    compress(last);
+    v2 ^= 0xff;
+    for (int i = 0; i < 4; ++i) round();
+    return v0 ^ v1 ^ v2 ^ v3;
+}
+
+} // namespace detail
+
+/**
+ * @brief Scheduling class of a route. Lower classes are served first when
+ * handler workers are saturated.
+ */
+enum class PriorityClass : std::uint8_t {
+    Critical = 0, // Health checks, control endpoints
+    Interactive,  // User-facing calls (checkout, page loads)
+    Normal,       // Default
+    Batch         // Exports, reports, anything that can wait
+};
+
+inline constexpr std::size_t kPriorityClassCount = 4;
+
+/**
+ * @brief Lower-case name of a priority class, used in metric labels.
+ */
+inline const char* priority_class_name(PriorityClass cls) {
+    switch (cls) {
+        case PriorityClass::Critical: return "critical";
+        case PriorityClass::Interactive: return "interactive";
+        case PriorityClass::Normal: return "normal";
+        case PriorityClass::Batch: return "batch";
+    }
+    return "unknown";
+}
+
+/**
+ * @brief Settings for the handler scheduler.
+ */
+struct SchedulerConfig {
+    // Queueing budget per class, indexed by PriorityClass. A job's virtual
+    // deadline is the earlier of its request deadline and enqueue time plus
+    // this budget. Workers take the class whose next job (in round-robin
+    // order) has the earliest virtual deadline. So Critical work goes first,
+    // but a Batch job that has waited longer than its budget ages past newly
+    // queued Interactive work. Within a class, jobs are not reordered by
+    // their request deadlines.
+    std::array<std::chrono::milliseconds, kPriorityClassCount> class_budget{
+        std::chrono::milliseconds(0),
+        std::chrono::milliseconds(50),
+        std::chrono::milliseconds(250),
+        std::chrono::milliseconds(2000)};
+
+    // Number of fair-queuing flows per class. Clients are hashed onto these
+    // (SipHash under a random per-process key, so collisions can't be aimed
+    // for), so memory stays fixed however many distinct clients there are;
+    // clients that collide share a flow's share of the workers.
+    std::size_t fair_queue_flows = 1024;
+
+    // Cost units a flow may spend each time deficit round robin visits it.
+    // Every job currently costs one unit, so a quantum of 1 serves flows in
+    // strict rotation.
+    std::int64_t fair_queue_quantum = 1;
+
+    // CoDel queue management. When the shortest time jobs of a class spend
+    // queued stays above codel_target for a whole codel_interval, the class
+    // starts rejecting jobs (the client gets a 503), at a rate that rises
+    // with the square root of the drop count until the delay falls again.
+    // Critical work is never dropped.
+    bool codel_enabled = true;
+    std::chrono::milliseconds codel_target{10};
+    std::chrono::milliseconds codel_interval{100};
+};
+
+/**
+ * @brief Worker pool that runs queued handler work in earliest-deadline-first
+ * order across priority classes, and fairly across clients within a class.
+ *
+ * Within a class, jobs are queued per client flow and flows are served by
+ * deficit round robin, so one heavy client cannot monopolize the workers.
+ * Across classes, workers take the class whose next job has the earliest
+ * virtual deadline; that is a comparison of kPriorityClassCount candidates,
+ * so both enqueue and dequeue are O(1). The next job is the one at the head
+ * of the flow round robin visits next. That is usually, but not always, the
+ * class's earliest virtual deadline: a request deadline tighter than the
+ * class budget does not move its job ahead within the class.
+ */
+class Scheduler {
+public:
+    using Task = std::function<void()>;
+    using Clock = std::chrono::steady_clock;
+    // Called on a worker thread instead of the task when the job is dropped
+    // by CoDel or its deadline passed while it was queued.
+    using Reject = std::function<void()>;
+
+    /**
+     * @brief Starts the worker threads.
+     * @param threads Number of workers; zero creates no workers.
+     * @param config Per-class budgets.
+     */
+    inline Scheduler(std::size_t threads, SchedulerConfig config = {})
+        : config_(config)
+    {
+        std::random_device random;
+        for (auto& word : flow_key_) word = (static_cast<uint64_t>(random()) << 32) | random();
+        config_.fair_queue_flows = std::max<std::size_t>(config_.fair_queue_flows, 1);
+        config_.fair_queue_quantum = std::max<std::int64_t>(config_.fair_queue_quantum, 1);
+        for (auto& queue : queues_) {
+            queue.flows.resize(config_.fair_queue_flows);
+        }
+        workers_.reserve(threads);
+        for (std::size_t i = 0; i < threads; ++i) {
+            workers_.emplace_back([this] { worker_loop(); });
+        }
+    }
+
+    /**
+     * @brief Stops the workers. Jobs still queued are dropped.
+     */
+    inline ~Scheduler() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stopping_ = true;
+        }
+        cv_.notify_all();
+        for (auto& worker : workers_) {
+            if (worker.joinable()) worker.join();
+        }
+        for (auto& queue : queues_) {
+            for (auto& flow : queue.flows) {
+                while (Job* job = flow.head) {
+                    flow.head = job->next;
+                    delete job;
+                }
+            }
+        }
+    }
+
+    Scheduler(const Scheduler&) = delete;
+    Scheduler& operator=(const Scheduler&) = delete;
+
+    /**
+     * @brief Queues a task.
+     * @param cls The route's priority class.
+     * @param deadline The request deadline (time_point::max() if none).
+     * @param client Identity of the client the work is for (remote IP or API
+     *        key); work is shared fairly between distinct clients.
+     * @param task The work to run on a worker thread.
+     * @param reject Called instead of the task if the job is dropped.
+     */
+    inline void submit(PriorityClass cls, Clock::time_point deadline, std::string_view client, Task task, Reject reject = {}) {
+        auto now = Clock::now();
+        auto index = static_cast<std::size_t>(cls);
+        Job* job = new Job{std::move(task), std::move(reject), now, deadline,
+                           std::min(deadline, now + config_.class_budget[index]), 1, nullptr};
+        std::size_t flow_index = static_cast<std::size_t>(detail::siphash24(flow_key_, client) % config_.fair_queue_flows);
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            queues_[index].push(flow_index, job);
+            stats_[index].active_flows.store(queues_[index].active_count, std::memory_order_relaxed);
+        }
+        stats_[index].submitted.fetch_add(1, std::memory_order_relaxed);
+        stats_[index].queued.fetch_add(1, std::memory_order_relaxed);
+        cv_.notify_one();
+    }
+
+    /**
+     * @brief Appends per-class metrics in Prometheus format.
+     * @param out The buffer to append to.
+     */
+    inline void collect_metrics(std::string& out) const {
+        for (std::size_t i = 0; i < kPriorityClassCount; ++i) {
+            const ClassStats& s = stats_[i];
+            std::string labels = fmt::format("class=\"{}\"", priority_class_name(static_cast<PriorityClass>(i)));
+            append_metric(out, "haka_scheduler_queued", labels, s.queued.load(std::memory_order_relaxed));
+            append_metric(out, "haka_scheduler_submitted_total", labels, s.submitted.load(std::memory_order_relaxed));
+            append_metric(out, "haka_scheduler_completed_total", labels, s.completed.load(std::memory_order_relaxed));
+            append_metric(out, "haka_scheduler_queue_wait_seconds_sum", labels, s.wait_us.load(std::memory_order_relaxed) / 1e6);
+            append_metric(out, "haka_scheduler_queue_wait_seconds_max", labels, s.max_wait_us.load(std::memory_order_relaxed) / 1e6);
+            append_metric(out, "haka_scheduler_run_seconds_sum", labels, s.run_us.load(std::memory_order_relaxed) / 1e6);
+            append_metric(out, "haka_scheduler_active_flows", labels, s.active_flows.load(std::memory_order_relaxed));
+            append_metric(out, "haka_scheduler_dropped_total", labels, s.dropped.load(std::memory_order_relaxed));
+            append_metric(out, "haka_scheduler_expired_total", labels, s.expired.load(std::memory_order_relaxed));
+            append_metric(out, "haka_scheduler_codel_dropping", labels, s.dropping.load(std::memory_order_relaxed) ? 1 : 0);
+        }
+    }
+
+    /**
+     * @brief Whether any class is currently shedding load.
+     * @return true while CoDel is in its dropping state for some class.
+     */
+    inline bool overloaded() const {
+        for (const auto& s : stats_) {
+            if (s.dropping.load(std::memory_order_relaxed)) return true;
+        }
+        return false;
+    }
+
+private:
+    struct Job {
+        Task task;
+        Reject reject;
+        Clock::time_point enqueued;
+        Clock::time_point deadline;
+        Clock::time_point virtual_deadline;
+        std::int64_t cost;
+        Job* next; // Intrusive FIFO link within a flow
+    };
+
+    // One client flow: a FIFO of jobs plus its deficit-round-robin state.
+    struct Flow {
+        Job* head = nullptr;
+        Job* tail = nullptr;
+        Flow* next_active = nullptr; // Link in the class's active-flow ring
+        std::int64_t deficit = 0;
+        bool active = false;
+    };
+
+    // All flows of one priority class and the round-robin list of the
+    // non-empty ones. Must be used with mutex_ held.
+    struct ClassQueue {
+        std::vector<Flow> flows;
+        Flow* active_head = nullptr;
+        Flow* active_tail = nullptr;
+        std::size_t active_count = 0;
+
+        inline bool empty() const { return active_head == nullptr; }
+
+        inline void push(std::size_t flow_index, Job* job) {
+            Flow& flow = flows[flow_index];
+            if (flow.tail) {
+                flow.tail->next = job;
+            } else {
+                flow.head = job;
+            }
+            flow.tail = job;
+            if (!flow.active) {
+                flow.active = true;
+                flow.deficit = 0;
+                append_active(&flow);
+                ++active_count;
+            }
+        }
+
+        // The job deficit round robin would most likely serve next.
+        inline const Job* peek() const {
+            return active_head->head;
+        }
+
+        inline Job* pop(std::int64_t quantum) {
+            for (;;) {
+                Flow* flow = active_head;
+                if (flow->deficit < flow->head->cost) {
+                    // Out of credit: top up and move to the back of the ring.
+                    flow->deficit += quantum;
+                    if (flow != active_tail) {
+                        active_head = flow->next_active;
+                        flow->next_active = nullptr;
+                        append_active(flow);
+                    }
+                    continue;
+                }
+                Job* job = flow->head;
+                flow->deficit -= job->cost;
+                flow->head = job->next;
+                job->next = nullptr;
+                if (!flow->head) {
+                    // Drained flows leave the ring and forfeit their credit.
+                    flow->tail = nullptr;
+                    flow->active = false;
+                    flow->deficit = 0;
+                    active_head = flow->next_active;
+                    if (!active_head) active_tail = nullptr;
+                    flow->next_active = nullptr;
+                    --active_count;
+                }
+                return job;
+            }
+        }
+
+    private:
+        inline void append_active(Flow* flow) {
+            if (active_tail) {
+                active_tail->next_active = flow;
+            } else {
+                active_head = flow;
+            }
+            active_tail = flow;
+        }
+    };
+
+    struct ClassStats {
+        std::atomic<std::uint64_t> submitted{0};
+        std::atomic<std::uint64_t> completed{0};
+        std::atomic<std::int64_t> queued{0};
+        std::atomic<std::uint64_t> wait_us{0};
+        std::atomic<std::uint64_t> max_wait_us{0};
+        std::atomic<std::uint64_t> run_us{0};
+        std::atomic<std::size_t> active_flows{0};
+        std::atomic<std::uint64_t> dropped{0};
+        std::atomic<std::uint64_t> expired{0};
+        std::atomic<bool> dropping{false};
+    };
+
+    // CoDel control state of one class (RFC 8289), guarded by mutex_.
+    struct CoDelState {
+        Clock::time_point first_above_time{};
+        Clock::time_point drop_next{};
+        std::uint32_t count = 0;
+        std::uint32_t last_count = 0;
+        bool dropping = false;
+    };
+
+    inline void worker_loop() {
+        std::vector<std::unique_ptr<Job>> rejected;
+        for (;;) {
+            std::unique_ptr<Job> job;
+            std::size_t index = 0;
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                cv_.wait(lock, [this] { return stopping_ || has_work(); });
+                if (stopping_) return;
+                // Skip over jobs nobody is waiting for any more and jobs CoDel sheds.
+                while (has_work()) {
+                    index = pick_class();
+                    job.reset(queues_[index].pop(config_.fair_queue_quantum));
+                    stats_[index].active_flows.store(queues_[index].active_count, std::memory_order_relaxed);
+                    stats_[index].queued.fetch_sub(1, std::memory_order_relaxed);
+                    auto now = Clock::now();
+                    if (job->deadline <= now) {
+                        stats_[index].expired.fetch_add(1, std::memory_order_relaxed);
+                        rejected.push_back(std::move(job));
+                    } else if (codel_should_drop(index, now - job->enqueued, now)) {
+                        stats_[index].dropped.fetch_add(1, std::memory_order_relaxed);
+                        rejected.push_back(std::move(job));
+                    } else {
+                        break;
+                    }
+                }
+            }
+
+            // Rejections run outside the lock; they only post a reply back to the io thread.
+            for (auto& dropped : rejected) {
+                if (dropped->reject) dropped->reject();
+            }
+            rejected.clear();
+            if (!job) continue;
+
+            ClassStats& s = stats_[index];
+            auto start = Clock::now();
+            auto wait_us = static_cast<std::uint64_t>(
+                std::chrono::duration_cast<std::chrono::microseconds>(start - job->enqueued).count());
+            s.wait_us.fetch_add(wait_us, std::memory_order_relaxed);
+            std::uint64_t prev_max = s.max_wait_us.load(std::memory_order_relaxed);
+            while (wait_us > prev_max && !s.max_wait_us.compare_exchange_weak(prev_max, wait_us, std::memory_order_relaxed)) {
+            }
+
+            try {
+                job->task();
+            } catch (const std::exception& e) {
+                log_message("ERROR", fmt::format("Scheduled task threw: {}", e.what()));
+            } catch (...) {
+                log_message("ERROR", "Scheduled task threw an unknown exception");
+            }
+
+            s.run_us.fetch_add(static_cast<std::uint64_t>(
+                std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - start).count()), std::memory_order_relaxed);
+            s.completed.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    /**
+     * @brief CoDel drop decision for a job leaving class `index` after
+     * waiting `sojourn`. Expects mutex_ to be held.
+     * @return true if the job should be dropped.
+     */
+    inline bool codel_should_drop(std::size_t index, Clock::duration sojourn, Clock::time_point now) {
+        if (!config_.codel_enabled || index == static_cast<std::size_t>(PriorityClass::Critical)) {
+            return false;
+        }
+        CoDelState& st = codel_[index];
+        const auto interval = std::chrono::duration_cast<Clock::duration>(config_.codel_interval);
+
+        bool ok_to_drop = false;
+        if (sojourn < config_.codel_target || queues_[index].empty()) {
+            // Delay is fine, or the queue just drained: leave the "above target" episode.
+            st.first_above_time = Clock::time_point{};
+        } else if (st.first_above_time == Clock::time_point{}) {
+            st.first_above_time = now + interval;
+        } else if (now >= st.first_above_time) {
+            ok_to_drop = true;
+        }
+
+        bool drop = false;
+        if (st.dropping) {
+            if (!ok_to_drop) {
+                st.dropping = false;
+            } else if (now >= st.drop_next) {
+                ++st.count;
+                st.drop_next = codel_control_law(st.drop_next, st.count);
+                drop = true;
+            }
+        } else if (ok_to_drop) {
+            st.dropping = true;
+            // Resume near the previous drop rate if we were dropping recently.
+            std::uint32_t delta = st.count - st.last_count;
+            st.count = (delta > 1 && now - st.drop_next < 16 * interval) ? delta : 1;
+            st.last_count = st.count;
+            st.drop_next = codel_control_law(now, st.count);
+            drop = true;
+        }
+        stats_[index].dropping.store(st.dropping, std::memory_order_relaxed);
+        return drop;
+    }
+
+    inline Clock::time_point codel_control_law(Clock::time_point t, std::uint32_t count) const {
+        auto interval = std::chrono::duration_cast<Clock::duration>(config_.codel_interval);
+        return t + std::chrono::duration_cast<Clock::duration>(interval / std::sqrt(static_cast<double>(count)));
+    }
+
+    // Both helpers expect mutex_ to be held.
+    inline bool has_work() const {
+        for (const auto& queue : queues_) {
+            if (!queue.empty()) return true;
+        }
+        return false;
+    }
+
+    inline std::size_t pick_class() const {
+        std::size_t best = kPriorityClassCount;
+        for (std::size_t i = 0; i < kPriorityClassCount; ++i) {
+            if (queues_[i].empty()) continue;
+            if (best == kPriorityClassCount ||
+                queues_[i].peek()->virtual_deadline < queues_[best].peek()->virtual_deadline) {
+                best = i;
+            }
+        }
+        return best;
+    }
+
+    SchedulerConfig config_;
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::array<ClassQueue, kPriorityClassCount> queues_;
+    std::array<ClassStats, kPriorityClassCount> stats_;
+    std::array<CoDelState, kPriorityClassCount> codel_;
+    std::array<uint64_t, 2> flow_key_{}; // Random per process: flow assignment can't be predicted offline
+    bool stopping_ = false;
+    std::vector<std::thread> workers_; // Declared last so the queues outlive the workers
+};
+
+} // namespace Haka
+
+#endif // HAKA_SCHEDULER_HPP
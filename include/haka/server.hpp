@@ -10,10 +10,27 @@
 // Project includes
 #include "haka/core.hpp"   // For Request, Response, RouteHandler, log_message
 #include "haka/router.hpp" // For Router class
+#include "haka/scheduler.hpp" // For Scheduler
+#include "haka/metrics.hpp" // For MetricsRegistry
+#include "haka/tracing.hpp" // For Tracer, RequestTimings
+#include "haka/mirror.hpp" // For Mirror
+#include "haka/memory_budget.hpp" // For MemoryBudget, MemoryReservation
+#include "haka/slab_pool.hpp" // For SlabAllocator
+#include "haka/path.hpp" // For normalize_request_target
+#include "haka/parser.hpp" // For RequestParser
+#include "haka/utf8.hpp" // For Utf8Validator
+#include "haka/inflate.hpp" // For BodyInflater (HAKA_ENABLE_ZLIB)
+#include "haka/session.hpp" // For SessionStore
+#include "haka/bus.hpp" // For Bus
+#include "haka/periodic.hpp" // For PeriodicScheduler
 
 #include <memory> // For std::shared_ptr, std::enable_shared_from_this
 #include <array>  // For buffer_
-#include <sstream> // For std::istringstream // Needed for Connection methods
+#include <chrono> // For handler deadlines
+#include <atomic> // For the health state
+#include <thread> // For std::thread::hardware_concurrency
+#include <charconv> // For parsing the deadline header
+#include <optional> // For the body inflater
 
 
 namespace Haka
@@ -31,6 +48,84 @@ namespace Haka
     // Forward declaration of the Server class (needed by Connection)
     class Server;
 
+    /**
+     * @brief What the health endpoint reports to load balancers.
+     */
+    enum class HealthState : uint8_t {
+        Ready,      // 200: send traffic
+        Draining,   // 503: shutting down, stop sending new traffic
+        Overloaded  // 503 + Retry-After: shedding load, back off briefly
+    };
+
+    /**
+     * @brief Server-wide settings. Pass to the Server constructor.
+     */
+    struct ServerConfig {
+        // Default time a handler may run before the client gets a 504.
+        // Routes can override it through RouteOptions::timeout. Zero disables it.
+        std::chrono::milliseconds handler_timeout{30000};
+
+        // Number of threads that run route handlers off the io thread, so a
+        // slow handler cannot stall other connections and can be timed out.
+        // Zero runs handlers inline on the io thread (deadlines are then only
+        // checked once the handler returns).
+        std::size_t handler_threads = std::max(1u, std::thread::hardware_concurrency());
+
+        // How queued handler work is ordered across RouteOptions::priority classes,
+        // shared between clients, and shed under overload (CoDel target/interval).
+        SchedulerConfig scheduler;
+
+        // Header identifying the client for fair queuing (e.g., "X-Api-Key").
+        // Requests without it, or all requests if empty, are keyed by remote IP.
+        std::string fair_queue_key_header;
+
+        // Header an upstream caller can send with its remaining time budget in
+        // milliseconds. The tighter of this and the route timeout wins.
+        // Empty disables it.
+        std::string deadline_header = "X-Request-Timeout-Ms";
+
+        // Path answered by the health fast path (e.g., "/healthz"): GET/HEAD
+        // probes are recognized from the request line and answered from a
+        // prebuilt buffer, with no routing, logging or allocation. Empty disables it.
+        std::string health_path;
+
+        // Largest request body accepted (Content-Length); larger requests get a 413.
+        std::size_t max_body_size = 8 * 1024 * 1024;
+
+        // Bodies sent with Content-Encoding gzip or deflate are decompressed
+        // while they are read (needs HAKA_ENABLE_ZLIB), so handlers see plain
+        // bytes; max_body_size applies to the compressed size. Decoding stops
+        // with a 413 once the output passes max_inflated_body_size, or expands
+        // more than max_inflate_ratio times after its first MiB.
+        std::size_t max_inflated_body_size = 32 * 1024 * 1024;
+        std::size_t max_inflate_ratio = 100;
+
+        // Limits on the request head. A longer request line gets a 414; more
+        // header bytes (excluding the request line) or more header fields get a
+        // 431. Both are prebuilt and close the connection. A connection never
+        // buffers more than max_request_line + max_header_bytes + one read
+        // (8 KiB) before its headers are parsed.
+        std::size_t max_request_line = 8 * 1024;
+        std::size_t max_header_bytes = 16 * 1024;
+        std::size_t max_header_count = 100;
+
+        // Allocate Connection objects (including their read buffer) from slabs
+        // in 2 MiB huge-page arenas, which cuts TLB misses with many connections.
+        bool slab_connections = true;
+
+        // Global memory budget (limit derived from the cgroup by default).
+        // Under pressure, connections stop reading and large uploads get a 413.
+        MemoryBudgetConfig memory;
+
+        // Header carrying the request ID. An incoming value is reused (so IDs
+        // follow a request across services), otherwise one is generated; it is
+        // echoed back in the response either way.
+        std::string request_id_header = "X-Request-Id";
+
+        // W3C trace-context propagation and span export (off by default).
+        TracingConfig tracing;
+    };
+
     /**
      * @brief Represents a single client connection.
      * Handles reading the request, processing it, and sending the response.
@@ -46,10 +141,14 @@ namespace Haka
          */
         inline Connection(asio::ip::tcp::socket socket, Server& server)
             : socket_(std::move(socket)), // Take ownership of the socket
-              server_(server)             // Store a reference to the server
+              server_(server),            // Store a reference to the server
+              deadline_timer_(socket_.get_executor()),
+              read_pause_timer_(socket_.get_executor())
         {
             try {
-                 log_message("INFO", fmt::format("New Connection From {}", socket_.remote_endpoint().address().to_string()));
+                 request_.remote_address = socket_.remote_endpoint().address().to_string();
+                 // DEBUG, not INFO: load balancer probes open several connections per second
+                 log_message("DEBUG", fmt::format("New Connection From {}", request_.remote_address));
             } catch (const asio::system_error& e) {
                  log_message("WARN", fmt::format("Could not get remote endpoint address: {}", e.what()));
             }
@@ -59,9 +158,7 @@ namespace Haka
          * @brief Starts the asynchronous process for this connection.
          * Typically begins with reading the request.
          */
-        inline void start() {
-             read_request();
-        }
+        inline void start();
 
     private:
         // Implementation details for read_request, process_request, send_response
@@ -69,7 +166,20 @@ namespace Haka
         // These methods are defined inline below.
         inline void read_request();
         inline void process_request();
-        inline void send_response();
+        inline void run_handler(const Route& route);
+        inline void on_handler_done();
+        inline void on_deadline();
+        inline void on_rejected();
+        inline void send_response(const Response& response);
+        inline void stamp(Response& response) const;
+        inline bool is_health_probe() const;
+        inline void send_health();
+        inline void send_head_limit(int status_code);
+        inline void send_raw(std::string_view response);
+        inline bool check_body_utf8(const char* data, std::size_t size, bool last);
+#if defined(HAKA_ENABLE_ZLIB)
+        inline bool inflate_body();
+#endif
 
         asio::ip::tcp::socket socket_;          // The socket for this connection
         Server& server_;                        // Reference to the parent server
@@ -77,6 +187,26 @@ namespace Haka
         Response response_;                     // Stores the response to be sent
         std::array<char, 8192> buffer_{};       // Buffer for reading incoming data
         std::string request_buffer_;            // Accumulates incoming request data for parsing
+        asio::steady_timer deadline_timer_;     // Fires when the handler overruns its deadline
+        asio::steady_timer read_pause_timer_;   // Retries reading once memory pressure eases
+        MemoryReservation request_reservation_{MemorySubsystem::RequestBuffers};
+        MemoryReservation response_reservation_{MemorySubsystem::ResponseBodies};
+        bool handler_done_ = false;             // Set on the io thread once the handler returned
+        bool timed_out_ = false;                // Set on the io thread once a 504 has been sent
+        RequestTimings timings_;                // Phase timestamps, only taken when tracing is enabled
+        bool headers_parsed_ = false;           // Request line and headers have been read
+        bool health_probe_ = false;             // Request line matched ServerConfig::health_path
+        std::size_t body_start_ = 0;            // Offset of the body in request_buffer_
+        std::size_t content_length_ = 0;        // Body bytes announced by Content-Length
+        RequestParser parser_;                  // Finds and parses the request head (limits set in start())
+        Mirror* mirror_ = nullptr;              // Shadow to copy this request to once answered
+        Route route_;                           // Matched once the headers are in, before the body
+        const CorsPolicy* cors_ = nullptr;      // CORS policy covering the path, owned by the router
+        Utf8Validator body_utf8_;               // Checks the body as it arrives (RouteOptions::validate_utf8)
+        std::size_t body_checked_ = 0;          // Body bytes already fed to body_utf8_ (or the inflater)
+#if defined(HAKA_ENABLE_ZLIB)
+        std::optional<BodyInflater> inflater_;  // Decodes a gzip/deflate body as it arrives
+#endif
     };
 
 
@@ -92,15 +222,69 @@ namespace Haka
          * @brief Constructor for the Server.
          * @param host Host address to bind to (e.g., "127.0.0.1" or "0.0.0.0").
          * @param port Port to listen on.
+         * @param config Server-wide settings (handler threads, timeouts).
          */
-        inline Server(const std::string& host, unsigned short port)
+        inline Server(const std::string& host, unsigned short port, ServerConfig config = {})
             : io_context_(), // Initialize io_context
               // Initialize acceptor with the specified host and port
               acceptor_(io_context_, asio::ip::tcp::endpoint(asio::ip::make_address(host), port)),
               host_(host),
               port_(port),
-              router_() // Initialize the router
+              config_(std::move(config)),
+              router_(), // Initialize the router
+              periodic_(io_context_, config_.handler_threads > 0 ? &scheduler_ : nullptr),
+              scheduler_(config_.handler_threads, config_.scheduler)
         {
+            metrics_.add_collector("scheduler", [this](std::string& out) {
+                scheduler_.collect_metrics(out);
+            });
+            memory_budget().configure(config_.memory);
+            log_message("INFO", fmt::format("Memory budget: {} MiB", memory_budget().limit() >> 20));
+            metrics_.add_collector("memory", [](std::string& out) {
+                memory_budget().collect_metrics(out);
+            });
+            metrics_.add_collector("slabs", [](std::string& out) {
+                slab_pools().collect_metrics(out);
+            });
+            metrics_.add_collector("health", [this](std::string& out) {
+                out += "# TYPE haka_health_state gauge\n";
+                append_metric(out, "haka_health_state", "", static_cast<int>(health_state()));
+                out += "# TYPE haka_health_probes_total counter\n";
+                append_metric(out, "haka_health_probes_total", "", health_probes_.load(std::memory_order_relaxed));
+            });
+            health_responses_[static_cast<std::size_t>(HealthState::Ready)] =
+                "HTTP/1.1 200 OK\r\nContent-Type: text/plain\r\nContent-Length: 5\r\nConnection: close\r\n\r\nready";
+            health_responses_[static_cast<std::size_t>(HealthState::Draining)] =
+                "HTTP/1.1 503 Service Unavailable\r\nContent-Type: text/plain\r\nContent-Length: 8\r\nConnection: close\r\n\r\ndraining";
+            health_responses_[static_cast<std::size_t>(HealthState::Overloaded)] =
+                "HTTP/1.1 503 Service Unavailable\r\nContent-Type: text/plain\r\nRetry-After: 1\r\nContent-Length: 10\r\nConnection: close\r\n\r\noverloaded";
+            metrics_.add_collector("periodic", [this](std::string& out) {
+                periodic_.collect_metrics(out);
+            });
+            metrics_.add_collector("bus", [this](std::string& out) {
+                bus_.collect_metrics(out);
+            });
+            metrics_.add_collector("request_head", [this](std::string& out) {
+                out += "# TYPE haka_request_head_rejected_total counter\n";
+                append_metric(out, "haka_request_head_rejected_total", "status=\"414\"", head_rejections_[0].load(std::memory_order_relaxed));
+                append_metric(out, "haka_request_head_rejected_total", "status=\"431\"", head_rejections_[1].load(std::memory_order_relaxed));
+            });
+#if defined(HAKA_ENABLE_ZLIB)
+            metrics_.add_collector("request_body", [this](std::string& out) {
+                out += "# TYPE haka_request_bodies_decoded_total counter\n";
+                append_metric(out, "haka_request_bodies_decoded_total", "", encoded_bodies_[0].load(std::memory_order_relaxed));
+                out += "# TYPE haka_request_bodies_rejected_total counter\n";
+                append_metric(out, "haka_request_bodies_rejected_total", "status=\"400\"", encoded_bodies_[1].load(std::memory_order_relaxed));
+                append_metric(out, "haka_request_bodies_rejected_total", "status=\"413\"", encoded_bodies_[2].load(std::memory_order_relaxed));
+                append_metric(out, "haka_request_bodies_rejected_total", "status=\"415\"", encoded_bodies_[3].load(std::memory_order_relaxed));
+            });
+#endif
+            if (config_.tracing.enabled) {
+                tracer_ = std::make_unique<Tracer>(config_.tracing);
+                metrics_.add_collector("tracing", [this](std::string& out) {
+                    tracer_->collect_metrics(out);
+                });
+            }
             log_message("INFO", fmt::format("Server initialized on {}:{}", host_, port_));
         }
 
@@ -118,18 +302,20 @@ namespace Haka
          * @brief Registers a handler for GET requests at a specific path.
          * @param path The URL path.
          * @param handler The function to execute for this route.
+         * @param options Per-route settings such as the handler timeout.
          */
-        inline void Get(const std::string& path, RouteHandler handler) {
-            router_.Get(path, handler); // Delegate to the internal router
+        inline void Get(const std::string& path, RouteHandler handler, RouteOptions options = {}) {
+            router_.Get(path, handler, options); // Delegate to the internal router
         }
 
         /**
          * @brief Registers a handler for POST requests at a specific path.
          * @param path The URL path.
          * @param handler The function to execute for this route.
+         * @param options Per-route settings such as the handler timeout.
          */
-        inline void Post(const std::string& path, RouteHandler handler) {
-            router_.Post(path, handler); // Delegate to the internal router
+        inline void Post(const std::string& path, RouteHandler handler, RouteOptions options = {}) {
+            router_.Post(path, handler, options); // Delegate to the internal router
         }
 
         // TODO: Add wrapper methods for other HTTP methods (Put, Delete, etc.)
@@ -152,6 +338,22 @@ namespace Haka
              router_.group(prefix, config_func); // Delegate to the internal router
         }
 
+         /**
+          * @brief Enables CORS on the main router (see Router::cors).
+          * @param config Allowed origins, methods, headers, and preflight max-age.
+          */
+         inline void cors(const CorsConfig& config) {
+             router_.cors(config); // Delegate to the internal router
+         }
+
+         /**
+          * @brief Finds the CORS policy covering a request's path.
+          * @return The policy, or nullptr if CORS is not enabled there.
+          */
+         inline const CorsPolicy* cors_policy(const Request& req) const {
+             return router_.cors_policy(req.path);
+         }
+
          /**
           * @brief Mounts another Router's routes and static paths under a specific prefix
           * into this Server's main router. This is useful for creating modular route definitions.
@@ -163,6 +365,117 @@ namespace Haka
          }
 
 
+        /**
+         * @brief Registers a shadow upstream that routes can mirror traffic to
+         * through RouteOptions::mirror.
+         * @param name The name routes refer to.
+         * @param host Shadow host.
+         * @param port Shadow port.
+         * @param config Connection pool and queue settings.
+         */
+        inline void addMirror(const std::string& name, const std::string& host, unsigned short port, MirrorConfig config = {}) {
+            auto mirror = std::make_unique<Mirror>(name, host, port, config);
+            Mirror* raw = mirror.get();
+            mirrors_[name] = std::move(mirror);
+            metrics_.add_collector("mirror " + name, [raw](std::string& out) {
+                raw->collect_metrics(out);
+            });
+        }
+
+        /**
+         * @brief Finds a shadow upstream registered with addMirror.
+         * @param name The mirror's name.
+         * @return The mirror, or nullptr (with a warning) if there is none.
+         */
+        inline Mirror* find_mirror(const std::string& name) {
+            auto it = mirrors_.find(name);
+            if (it == mirrors_.end()) {
+                log_message("WARN", fmt::format("Route mirrors to unknown upstream '{}'", name));
+                return nullptr;
+            }
+            return it->second.get();
+        }
+
+        /**
+         * @brief Enables sessions: handlers can then call req.session(). The
+         * store's timing wheel is advanced by a periodic task on the io thread
+         * every config.tick.
+         * @param config Cookie, expiry, size and snapshot settings.
+         */
+        inline void sessions(SessionConfig config = {}) {
+            session_store_ = std::make_unique<SessionStore>(std::move(config));
+            SessionStore* store = session_store_.get();
+            metrics_.add_collector("sessions", [store](std::string& out) {
+                store->collect_metrics(out);
+            });
+            every(session_store_->config().tick, [store]() {
+                store->advance();
+            }, {.name = "sessions", .jitter = 0.0});
+        }
+
+#if !defined(_WIN32)
+        /**
+         * @brief Keeps static files open and their lookups (including misses)
+         * cached between requests, like nginx's open_file_cache. Entries
+         * unused for config.inactive are closed by a periodic task on the io
+         * thread.
+         * @param config Size, validity interval and negative caching settings.
+         */
+        inline void open_file_cache(OpenFileCacheConfig config = {}) {
+            auto cache = std::make_shared<OpenFileCache>(config);
+            router_.open_file_cache(cache);
+            metrics_.add_collector("open_files", [cache](std::string& out) {
+                cache->collect_metrics(out);
+            });
+            every(config.inactive, [cache]() {
+                cache->sweep();
+            }, {.name = "open_file_cache", .jitter = 0.0});
+        }
+#endif
+
+#if defined(HAKA_ENABLE_ZSTD)
+        /**
+         * @brief Serves a zstd dictionary at its options().url with the
+         * Use-As-Dictionary header, so clients can fetch it once and then
+         * receive dcz responses from routes whose RouteOptions::dictionary
+         * is this dictionary. Also exports its haka_zstd_* metrics.
+         * @param dictionary The dictionary, e.g., from ZstdDictionary::load.
+         */
+        inline void serve_dictionary(std::shared_ptr<const ZstdDictionary> dictionary) {
+            Get(dictionary->options().url, [dictionary](const Request&, Response& res) {
+                res.headers["Content-Type"] = "application/octet-stream";
+                res.headers["Use-As-Dictionary"] = dictionary->use_as_dictionary();
+                res.headers["Cache-Control"] = "public, max-age=86400";
+                res.body = dictionary->bytes();
+            });
+            if (dictionaries_.empty()) {
+                metrics_.add_collector("zstd", [this](std::string& out) {
+                    ZstdDictionary::collect_metrics(out, dictionaries_);
+                });
+            }
+            dictionaries_.push_back(std::move(dictionary));
+        }
+#endif
+
+        /**
+         * @brief Provides access to the session store.
+         * @return The store, or nullptr if sessions are not enabled.
+         */
+        inline SessionStore* session_store() {
+            return session_store_.get();
+        }
+
+        /**
+         * @brief Serves the server's metrics in Prometheus text format.
+         * @param path The URL path for the scrape endpoint (e.g., "/metrics").
+         */
+        inline void serveMetrics(const std::string& path) {
+            router_.Get(path, [this](const Request&, Response& res) {
+                res.Text(metrics_.render());
+                res.headers["Content-Type"] = "text/plain; version=0.0.4";
+            }, {.priority = PriorityClass::Critical});
+        }
+
         // --- Server control methods ---
 
         /**
@@ -180,6 +493,63 @@ namespace Haka
             log_message("INFO", "Haka server stopped.");
         }
 
+        /**
+         * @brief Stops the event loop; run() returns once it has unwound.
+         * Safe to call from a signal handler registered on the io_context
+         * or from another thread.
+         */
+        inline void stop() {
+            io_context_.stop();
+        }
+
+        /**
+         * @brief Sets the state reported by the health endpoint. Takes effect
+         * for the next probe; safe to call from any thread.
+         * @param state The new state (e.g., Draining before a shutdown).
+         */
+        inline void set_health(HealthState state) {
+            health_state_.store(state, std::memory_order_relaxed);
+        }
+
+        /**
+         * @brief Gets the state the health endpoint reports: the state set
+         * with set_health, or Overloaded while the scheduler is shedding load.
+         * @return The current health state.
+         */
+        inline HealthState health_state() const {
+            HealthState state = health_state_.load(std::memory_order_relaxed);
+            if (state == HealthState::Ready && scheduler_.overloaded()) {
+                return HealthState::Overloaded;
+            }
+            return state;
+        }
+
+        /**
+         * @brief Gets the prebuilt response for the current health state and
+         * counts the probe.
+         * @return The complete HTTP response; owned by the server.
+         */
+        inline const std::string& health_response() {
+            health_probes_.fetch_add(1, std::memory_order_relaxed);
+            return health_responses_[static_cast<std::size_t>(health_state())];
+        }
+
+        /**
+         * @brief Gets the prebuilt response for a request head over the
+         * ServerConfig limits, and counts it.
+         * @param status_code 414 (request line) or 431 (headers).
+         * @return The complete HTTP response; a static string.
+         */
+        inline std::string_view head_limit_response(int status_code) {
+            static constexpr std::string_view uri_too_long =
+                "HTTP/1.1 414 URI Too Long\r\nContent-Type: text/plain\r\nContent-Length: 12\r\nConnection: close\r\n\r\nURI Too Long";
+            static constexpr std::string_view headers_too_large =
+                "HTTP/1.1 431 Request Header Fields Too Large\r\nContent-Type: text/plain\r\nContent-Length: 31\r\n"
+                "Connection: close\r\n\r\nRequest Header Fields Too Large";
+            head_rejections_[status_code == 414 ? 0 : 1].fetch_add(1, std::memory_order_relaxed);
+            return status_code == 414 ? uri_too_long : headers_too_large;
+        }
+
         /**
          * @brief Finds the appropriate handler for a given request.
          * This method is called by the Connection class and delegates
@@ -188,7 +558,164 @@ namespace Haka
          * @return The RouteHandler function to process the request.
          */
         inline RouteHandler get_handler(const Request& req) const {
-            return router_.match(req); // Delegate routing to the Router
+            return router_.match(req).handler; // Delegate routing to the Router
+        }
+
+        /**
+         * @brief Like get_handler, but also returns the matched route's options.
+         * @param req The incoming Request object.
+         * @return The matched Route.
+         */
+        inline Route get_route(const Request& req) const {
+            return router_.match(req);
+        }
+
+        /**
+         * @brief Computes when a request's handler must have finished: the
+         * tighter of the route (or server-wide) timeout and the caller's own
+         * budget from the deadline header.
+         * @param req The parsed request.
+         * @param options The matched route's options.
+         * @param now The time the request was dispatched.
+         * @return The deadline, or time_point::max() if there is none.
+         */
+        inline std::chrono::steady_clock::time_point deadline_for(const Request& req, const RouteOptions& options,
+                                                                  std::chrono::steady_clock::time_point now) const {
+            auto deadline = std::chrono::steady_clock::time_point::max();
+            auto timeout = options.timeout.count() > 0 ? options.timeout : config_.handler_timeout;
+            if (timeout.count() > 0) {
+                deadline = now + timeout;
+            }
+            if (!config_.deadline_header.empty()) {
+                std::string_view value = req.header(config_.deadline_header);
+                long long budget_ms = 0;
+                if (!value.empty() &&
+                    std::from_chars(value.data(), value.data() + value.size(), budget_ms).ec == std::errc()) {
+                    deadline = std::min(deadline, now + std::chrono::milliseconds(std::max(budget_ms, 0LL)));
+                }
+            }
+            return deadline;
+        }
+
+        /**
+         * @brief Identifies the client a request is scheduled for: the
+         * configured fair-queuing header if present, else the remote IP.
+         * @param req The parsed request.
+         * @return A view into the request; valid as long as the request is.
+         */
+        inline std::string_view client_key(const Request& req) const {
+            if (!config_.fair_queue_key_header.empty()) {
+                std::string_view key = req.header(config_.fair_queue_key_header);
+                if (!key.empty()) return key;
+            }
+            return req.remote_address;
+        }
+
+        /**
+         * @brief Advertises an alternative service (e.g., the HTTP/3 listener)
+         * to clients through an Alt-Svc header on every TCP response. Call
+         * before run().
+         * @param value The Alt-Svc value (e.g., "h3=\":8443\"; ma=86400").
+         */
+        inline void advertise_alt_svc(std::string value) {
+            alt_svc_ = std::move(value);
+        }
+
+        /**
+         * @brief Gets the Alt-Svc value advertised on TCP responses.
+         * @return The value, or an empty string if nothing is advertised.
+         */
+        inline const std::string& alt_svc() const {
+            return alt_svc_;
+        }
+
+        /**
+         * @brief Provides access to the server settings.
+         * @return The ServerConfig the server was created with.
+         */
+        inline const ServerConfig& config() const {
+            return config_;
+        }
+
+        /**
+         * @brief The request parser limits from the ServerConfig.
+         */
+        inline ParserLimits parser_limits() const {
+            return {config_.max_request_line, config_.max_header_bytes, config_.max_header_count, config_.max_body_size};
+        }
+
+#if defined(HAKA_ENABLE_ZLIB)
+        /**
+         * @brief The decompression limits for request bodies from the ServerConfig.
+         */
+        inline InflateLimits inflate_limits() const {
+            return {config_.max_inflated_body_size, config_.max_inflate_ratio};
+        }
+#endif
+
+        /**
+         * @brief Counts a compressed request body: decoded (0) or refused (400, 413, 415).
+         */
+        inline void count_encoded_body(int status_code) {
+            std::size_t index = status_code == 0 ? 0 : status_code == 400 ? 1 : status_code == 413 ? 2 : 3;
+            encoded_bodies_[index].fetch_add(1, std::memory_order_relaxed);
+        }
+
+        /**
+         * @brief Provides access to the scheduler that runs route handlers.
+         * @return Reference to the handler scheduler.
+         */
+        inline Scheduler& get_scheduler() {
+            return scheduler_;
+        }
+
+        /**
+         * @brief Provides access to the tracer.
+         * @return The tracer, or nullptr if tracing is disabled.
+         */
+        inline Tracer* tracer() {
+            return tracer_.get();
+        }
+
+        /**
+         * @brief Runs a task periodically, e.g., refreshing reference data or
+         * compacting a cache. All tasks share one timer on the io thread; a
+         * task never overlaps itself (a run that would is skipped and counted).
+         * @param interval Time between runs.
+         * @param task The work. Runs on the io thread unless options.on_workers
+         *        is set, so it must not block there.
+         * @param options Name (metric label), jitter, and where the task runs.
+         * @return An ID for periodic().cancel().
+         */
+        template <typename Rep, typename Period>
+        inline uint64_t every(std::chrono::duration<Rep, Period> interval, std::function<void()> task, PeriodicOptions options = {}) {
+            return periodic_.every(std::chrono::duration_cast<PeriodicScheduler::Clock::duration>(interval), std::move(task), std::move(options));
+        }
+
+        /**
+         * @brief Provides access to the periodic task scheduler (e.g., to cancel a task).
+         * @return Reference to the PeriodicScheduler.
+         */
+        inline PeriodicScheduler& periodic() {
+            return periodic_;
+        }
+
+        /**
+         * @brief Provides access to the in-process pub/sub bus, e.g., for
+         * handlers to notify state owned by the io thread.
+         * @return Reference to the Bus.
+         */
+        inline Bus& bus() {
+            return bus_;
+        }
+
+        /**
+         * @brief Provides access to the metrics registry, so application code
+         * can add its own collectors next to the server's.
+         * @return Reference to the MetricsRegistry.
+         */
+        inline MetricsRegistry& metrics() {
+            return metrics_;
         }
 
         /**
@@ -212,7 +739,9 @@ namespace Haka
             acceptor_.async_accept(
                 [this](asio::error_code ec, asio::ip::tcp::socket socket) {
                     if (!ec) {
-                        auto conn = std::make_shared<Connection>(std::move(socket), *this);
+                        auto conn = config_.slab_connections
+                            ? std::allocate_shared<Connection>(SlabAllocator<Connection>{}, std::move(socket), *this)
+                            : std::make_shared<Connection>(std::move(socket), *this);
                         conn->start(); // Connection is fully defined above
                     } else {
                         if (ec != asio::error::operation_aborted) {
@@ -227,65 +756,209 @@ namespace Haka
         asio::ip::tcp::acceptor acceptor_;    // Listens for incoming connections
         std::string host_;                    // Server host address
         unsigned short port_;                 // Server port
+        ServerConfig config_;                 // Server-wide settings
+        std::string alt_svc_;                 // Alt-Svc header value, empty if none
         Router router_;                       // The router instance to handle route matching
+        MetricsRegistry metrics_;             // Collectors rendered by serveMetrics
+        Bus bus_;                             // In-process pub/sub (destroyed before io_context_)
+        PeriodicScheduler periodic_;          // Timer heap behind every()
+        std::unique_ptr<Tracer> tracer_;      // Null unless ServerConfig::tracing.enabled
+        std::unordered_map<std::string, std::unique_ptr<Mirror>> mirrors_; // Shadow upstreams by name
+        std::unique_ptr<SessionStore> session_store_; // Null unless sessions() was called; saved on destruction
+#if defined(HAKA_ENABLE_ZSTD)
+        std::vector<std::shared_ptr<const ZstdDictionary>> dictionaries_; // Registered by serve_dictionary() before run()
+#endif
+        std::atomic<HealthState> health_state_{HealthState::Ready};
+        std::atomic<uint64_t> health_probes_{0};
+        std::array<std::string, 3> health_responses_; // Prebuilt, indexed by HealthState
+        std::array<std::atomic<uint64_t>, 2> head_rejections_{}; // 414s and 431s sent
+        std::array<std::atomic<uint64_t>, 4> encoded_bodies_{};  // Decoded, then 400s, 413s and 415s
+        Scheduler scheduler_;                 // Runs route handlers (declared last so it is joined first)
     };
 
     // --- Connection Method Definitions (Defined inline in header) ---
 
+    inline void Connection::start() {
+        parser_ = RequestParser(server_.parser_limits());
+        read_request();
+    }
+
     inline void Connection::read_request() {
         auto self = shared_from_this();
+        if (!headers_parsed_ && memory_budget().under_pressure()) {
+            // Backpressure: leave the bytes in the kernel until memory is released.
+            // Only head bytes need new budget; a body was reserved in full once the
+            // headers were parsed, so it keeps being read. Pausing it would hold
+            // its reservation, and the pressure, indefinitely.
+            read_pause_timer_.expires_after(std::chrono::milliseconds(10));
+            read_pause_timer_.async_wait([this, self](asio::error_code ec) {
+                if (!ec) read_request();
+            });
+            return;
+        }
         socket_.async_read_some(asio::buffer(buffer_),
             [this, self](asio::error_code ec, std::size_t bytes_transferred) {
                 if (!ec) {
+                    if (request_buffer_.empty() && server_.tracer()) {
+                        timings_.received = std::chrono::steady_clock::now();
+                        timings_.start_wall = std::chrono::system_clock::now();
+                    }
                     request_buffer_.append(buffer_.data(), bytes_transferred);
-                    size_t header_end_pos = request_buffer_.find("\r\n\r\n");
-
-                    if (header_end_pos != std::string::npos) {
-                        std::istringstream stream(request_buffer_);
-                        std::string line;
-
-                        if (std::getline(stream, line) && !line.empty()) {
-                            std::istringstream request_line_stream(line);
-                            std::string http_version;
-                            request_line_stream >> request_.method >> request_.path >> http_version;
-
-                            if (request_.method.empty() || request_.path.empty()) {
-                                log_message("WARN", fmt::format("Malformed request line: {}", line));
-                                response_.status_code = 400;
-                                response_.Text("Bad Request");
-                                send_response();
-                                return;
-                            }
+                    if (request_buffer_.capacity() > request_reservation_.bytes()) {
+                        request_reservation_.resize(request_buffer_.capacity());
+                    }
 
-                            log_message("INFO", fmt::format("Request: {} {}", request_.method, request_.path));
-
-                            while (std::getline(stream, line) && line != "\r") {
-                                std::size_t colon_pos = line.find(':');
-                                if (colon_pos != std::string::npos) {
-                                    std::string header_name = line.substr(0, colon_pos);
-                                    std::string header_value = line.substr(colon_pos + 1);
-                                    header_value.erase(0, header_value.find_first_not_of(" \t"));
-                                    if (!header_value.empty() && header_value.back() == '\r') {
-                                         header_value.pop_back();
-                                    }
-                                    request_.headers[header_name] = header_value;
-                                } else {
-                                    log_message("WARN", fmt::format("Malformed header line: {}", line));
-                                }
-                            }
-                            // TODO: Read request body
+                    ParseStatus status = ParseStatus::HeadComplete;
+                    if (!headers_parsed_) {
+                        status = parser_.scan(request_buffer_);
+                        if (parse_status_code(status) != 0) {
+                            send_head_limit(parse_status_code(status));
+                            return;
+                        }
+                    }
 
-                            process_request();
+                    // Health probes are answered as soon as the request is complete,
+                    // without parsing headers, routing or logging.
+                    if (!health_probe_ && !headers_parsed_ && is_health_probe()) {
+                        health_probe_ = true;
+                    }
+                    if (health_probe_) {
+                        if (status == ParseStatus::Incomplete) {
+                            read_request();
                         } else {
-                            log_message("WARN", "Received empty or invalid request line after reading.");
+                            send_health();
+                        }
+                        return;
+                    }
+
+                    if (!headers_parsed_) {
+                        if (status == ParseStatus::Incomplete) {
+                            read_request();
+                            return;
+                        }
+
+                        // Request line and headers, parsed in place: the target is normalized inside the receive buffer.
+                        status = parser_.parse_head(request_buffer_, request_);
+                        if (status == ParseStatus::TooManyHeaders) {
+                            send_head_limit(431);
+                            return;
+                        }
+                        if (status == ParseStatus::BadRequestLine) {
+                            log_message("WARN", fmt::format("Malformed request line: {}", std::string_view(request_buffer_.data(), parser_.line_end())));
+                        } else if (status == ParseStatus::BadTarget) {
+                            log_message("WARN", fmt::format("Rejected request target from {}: {}", request_.remote_address, path_status_name(parser_.path_status())));
+                        }
+                        if (status == ParseStatus::BadRequestLine || status == ParseStatus::BadTarget) {
                             response_.status_code = 400;
                             response_.Text("Bad Request");
-                            send_response();
+                            send_response(response_);
+                            return;
+                        }
+                        if (parser_.malformed_lines() > 0) {
+                            log_message("WARN", fmt::format("Skipped {} malformed header line(s) from {}", parser_.malformed_lines(), request_.remote_address));
                         }
+                        headers_parsed_ = true;
+                        body_start_ = parser_.body_start();
+                        content_length_ = parser_.content_length();
 
-                    } else {
+                        if (!request_.id.assign(request_.header(server_.config().request_id_header))) {
+                            request_.id = RequestId::generate();
+                        }
+                        LogContext log_context(request_.id);
+                        log_message("INFO", fmt::format("Request: {} {}", request_.method, request_.path));
+
+                        if (status == ParseStatus::UnsupportedTransferEncoding) {
+                            // Bodies must be sized with Content-Length; chunked decoding is not implemented.
+                            response_.status_code = 501;
+                            response_.Text("Chunked request bodies are not supported");
+                            send_response(response_);
+                            return;
+                        }
+                        if (status == ParseStatus::BadContentLength) {
+                            response_.status_code = 400;
+                            response_.Text("Bad Request");
+                            send_response(response_);
+                            return;
+                        }
+                        if (status == ParseStatus::BodyTooLarge) {
+                            log_message("WARN", fmt::format("Request body of {} bytes exceeds the {} byte limit", content_length_, server_.config().max_body_size));
+                            response_.status_code = 413;
+                            response_.Text("Payload Too Large");
+                            send_response(response_);
+                            return;
+                        }
+#if defined(HAKA_ENABLE_ZLIB)
+                        // Compressed bodies are decoded as they arrive, below.
+                        if (content_length_ > 0) {
+                            std::string_view encoding = request_.header("Content-Encoding");
+                            BodyInflater::Coding coding = BodyInflater::coding(encoding);
+                            if (coding == BodyInflater::Coding::Unsupported) {
+                                log_message("WARN", fmt::format("Unsupported request Content-Encoding: {}", encoding));
+                                server_.count_encoded_body(415);
+                                response_.status_code = 415;
+                                response_.headers["Accept-Encoding"] = "gzip, deflate";
+                                response_.Text("Unsupported Content-Encoding");
+                                send_response(response_);
+                                return;
+                            }
+                            if (coding != BodyInflater::Coding::Identity) {
+                                inflater_.emplace(coding, server_.inflate_limits());
+                            }
+                        }
+#endif
+                        // Reserve the whole body up front, so an upload that doesn't fit is refused
+                        // before it is read rather than after.
+                        std::size_t needed = body_start_ + content_length_;
+                        if (needed > request_reservation_.bytes() &&
+                            !request_reservation_.try_grow(needed - request_reservation_.bytes())) {
+                            log_message("WARN", fmt::format("Rejecting {} byte request body: memory budget exhausted", content_length_));
+                            response_.status_code = 413;
+                            response_.Text("Payload Too Large");
+                            send_response(response_);
+                            return;
+                        }
+                        request_buffer_.reserve(needed);
+
+                        // Preflights are answered from the policy's prebuilt buffers, without routing.
+                        cors_ = server_.cors_policy(request_);
+                        if (cors_ && CorsPolicy::is_preflight(request_.method, request_.header("Access-Control-Request-Method"))) {
+                            send_raw(cors_->preflight(request_.header("Origin")));
+                            return;
+                        }
+                        route_ = server_.get_route(request_);
+                    }
+
+                    // Decode and validate body bytes as each read lands, while they are still in cache.
+                    bool decoded = false;
+#if defined(HAKA_ENABLE_ZLIB)
+                    if (inflater_) {
+                        if (!inflate_body()) return;
+                        decoded = true;
+                    }
+#endif
+                    if (!decoded && route_.options.validate_utf8 && content_length_ > 0) {
+                        std::size_t available = std::min(request_buffer_.size() - body_start_, content_length_);
+                        if (!check_body_utf8(request_buffer_.data() + body_start_ + body_checked_, available - body_checked_,
+                                             available == content_length_)) {
+                            return;
+                        }
+                        body_checked_ = available;
+                    }
+
+                    // Wait for the rest of the body
+                    if (request_buffer_.size() - body_start_ < content_length_) {
                         read_request();
+                        return;
+                    }
+                    if (!decoded) request_.body.assign(request_buffer_, body_start_, content_length_);
+                    std::string().swap(request_buffer_); // Only the body is needed from here on
+                    request_reservation_.resize(request_.body.capacity());
+
+                    LogContext log_context(request_.id);
+                    if (server_.tracer()) {
+                        timings_.parsed = std::chrono::steady_clock::now();
                     }
+                    process_request();
 
                 } else if (ec != asio::error::operation_aborted && ec != asio::error::eof) {
                     log_message("ERROR", fmt::format("Read error: {}", ec.message()));
@@ -293,10 +966,137 @@ namespace Haka
             });
     }
 
+    /**
+     * @brief Feeds the next body bytes to body_utf8_.
+     * @param last The body is complete.
+     * @return false if the body is not valid UTF-8 and a 400 has been sent.
+     */
+    inline bool Connection::check_body_utf8(const char* data, std::size_t size, bool last) {
+        if (body_utf8_.update(data, size) && (!last || body_utf8_.finish())) return true;
+        LogContext log_context(request_.id);
+        log_message("WARN", fmt::format("Rejecting request body that is not valid UTF-8: {} {}", request_.method, request_.path));
+        response_.status_code = 400;
+        response_.Text("Request body is not valid UTF-8");
+        send_response(response_);
+        return false;
+    }
+
+#if defined(HAKA_ENABLE_ZLIB)
+    /**
+     * @brief Decompresses the body bytes that arrived since the last read into
+     * request_.body (checking the output for UTF-8 if the route asks). Once the
+     * body is complete, Content-Encoding is dropped and Content-Length set to
+     * the decoded size, so handlers see a plain body.
+     * @return false if the body was refused and a response has been sent.
+     */
+    inline bool Connection::inflate_body() {
+        std::size_t available = std::min(request_buffer_.size() - body_start_, content_length_);
+        std::size_t decoded = request_.body.size();
+        InflateStatus status = inflater_->update(request_buffer_.data() + body_start_ + body_checked_, available - body_checked_,
+                                                 request_.body, request_reservation_);
+        body_checked_ = available;
+        if (status == InflateStatus::NeedMore && available == content_length_) {
+            status = inflater_->finish();
+        }
+        if (status != InflateStatus::NeedMore && status != InflateStatus::Done) {
+            int status_code = status == InflateStatus::BadData ? 400 : 413;
+            LogContext log_context(request_.id);
+            log_message("WARN", fmt::format("Rejecting {} request body: {} ({} bytes in, {} out)", request_.header("Content-Encoding"),
+                                            inflate_status_name(status), inflater_->consumed(), inflater_->produced()));
+            server_.count_encoded_body(status_code);
+            response_.status_code = status_code;
+            response_.Text(status_code == 400 ? "Malformed compressed request body" : "Decompressed request body too large");
+            send_response(response_);
+            return false;
+        }
+        if (route_.options.validate_utf8 &&
+            !check_body_utf8(request_.body.data() + decoded, request_.body.size() - decoded, status == InflateStatus::Done)) {
+            return false;
+        }
+        if (status == InflateStatus::Done) {
+            log_message("DEBUG", fmt::format("Decoded {} byte {} body to {} bytes", inflater_->consumed(), request_.header("Content-Encoding"), request_.body.size()));
+            server_.count_encoded_body(0);
+            for (auto it = request_.headers.begin(); it != request_.headers.end();) {
+                if (detail::iequals(it->first, "Content-Encoding")) {
+                    it = request_.headers.erase(it);
+                    continue;
+                }
+                if (detail::iequals(it->first, "Content-Length")) it->second = std::to_string(request_.body.size());
+                ++it;
+            }
+            inflater_.reset(); // Returns the zlib state to this thread's pool
+        }
+        return true;
+    }
+#endif
+
     inline void Connection::process_request() {
-        auto handler = server_.get_handler(request_);
+        if (Tracer* tracer = server_.tracer()) {
+            tracer->begin(request_.header("traceparent"), request_.trace);
+        }
+        Route route = std::move(route_);
+        request_.session_store = server_.session_store();
+        stamp(response_); // Before the handler runs, so it may still override these headers
+        if (cors_) {
+            response_.header_block = cors_->response_headers(request_.header("Origin"));
+        }
+        if (!route.options.mirror.empty() && Mirror::sample(route.options.mirror_percent)) {
+            mirror_ = server_.find_mirror(route.options.mirror);
+        }
+        auto now = std::chrono::steady_clock::now();
+        request_.deadline = server_.deadline_for(request_, route.options, now);
+
+        // The caller's budget is already spent: don't start work nobody is waiting for.
+        if (request_.deadline <= now) {
+            on_deadline();
+            return;
+        }
+
+        if (server_.config().handler_threads == 0) {
+            run_handler(route);
+            handler_done_ = true;
+            if (std::chrono::steady_clock::now() > request_.deadline) {
+                on_deadline();
+            } else {
+                send_response(response_);
+            }
+            return;
+        }
+
+        auto self = shared_from_this();
+        if (request_.deadline != std::chrono::steady_clock::time_point::max()) {
+            deadline_timer_.expires_at(request_.deadline);
+            deadline_timer_.async_wait([this, self](asio::error_code ec) {
+                if (!ec && !handler_done_) {
+                    on_deadline();
+                }
+            });
+        }
+
+        // Queue the handler on the scheduler; completion hops back to the io thread,
+        // which is the only place handler_done_ / timed_out_ are touched.
+        PriorityClass priority = route.options.priority; // Read before route is moved into the task
+        server_.get_scheduler().submit(priority, request_.deadline, server_.client_key(request_),
+                                       [this, self, route = std::move(route)]() {
+            run_handler(route);
+            asio::post(socket_.get_executor(), [this, self]() {
+                on_handler_done();
+            });
+        }, [this, self]() {
+            asio::post(socket_.get_executor(), [this, self]() {
+                on_rejected();
+            });
+        });
+    }
+
+    inline void Connection::run_handler(const Route& route) {
+        LogContext log_context(request_.id);
+        bool traced = server_.tracer() != nullptr;
+        if (traced) {
+            timings_.handler_start = std::chrono::steady_clock::now();
+        }
         try {
-            handler(request_, response_);
+            invoke_route(route, request_, response_);
         } catch (const std::exception& e) {
             log_message("ERROR", fmt::format("Handler threw exception for {} {}: {}", request_.method, request_.path, e.what()));
             response_.status_code = 500;
@@ -306,21 +1106,87 @@ namespace Haka
             response_.status_code = 500;
             response_.Text("Internal Server Error");
         }
-        send_response();
+        if (traced) {
+            timings_.handler_end = std::chrono::steady_clock::now();
+        }
     }
 
-    inline void Connection::send_response() {
+    inline void Connection::on_handler_done() {
+        LogContext log_context(request_.id);
+        handler_done_ = true;
+        if (timed_out_) {
+            // The client already got its 504; drop the late result.
+            log_message("DEBUG", fmt::format("Handler for {} {} finished after its deadline", request_.method, request_.path));
+            return;
+        }
+        deadline_timer_.cancel();
+        send_response(response_);
+    }
+
+    inline void Connection::on_rejected() {
+        LogContext log_context(request_.id);
+        handler_done_ = true;
+        if (timed_out_) {
+            return; // Already answered with a 504
+        }
+        deadline_timer_.cancel();
+        log_message("WARN", fmt::format("Shedding {} {}: handler queue is overloaded", request_.method, request_.path));
+
+        Response unavailable_response;
+        unavailable_response.status_code = 503;
+        unavailable_response.headers["Retry-After"] = "1";
+        unavailable_response.Text("Service Unavailable");
+        stamp(unavailable_response);
+        send_response(unavailable_response);
+    }
+
+    inline void Connection::on_deadline() {
+        LogContext log_context(request_.id);
+        timed_out_ = true;
+        request_.cancellation.request_stop();
+        log_message("WARN", fmt::format("Deadline exceeded for {} {}", request_.method, request_.path));
+
+        // response_ may still be written by the handler thread, so reply from a fresh object.
+        Response timeout_response;
+        timeout_response.status_code = 504;
+        timeout_response.Text("Gateway Timeout");
+        stamp(timeout_response);
+        send_response(timeout_response);
+    }
+
+    inline void Connection::send_response(const Response& response) {
         auto self = shared_from_this();
-        auto response_str = std::make_shared<std::string>(response_.to_string());
+        auto response_str = std::make_shared<std::string>(response.to_string());
+        int status_code = response.status_code;
+        response_reservation_.resize(response_str->size());
 
         asio::async_write(socket_, asio::buffer(*response_str),
-            [this, self, response_str](asio::error_code ec, std::size_t bytes_transferred) {
+            [this, self, response_str, status_code](asio::error_code ec, std::size_t bytes_transferred) {
+                LogContext log_context(request_.id);
+                response_reservation_.reset();
                 if (!ec) {
                     log_message("INFO", fmt::format("Sent response ({} bytes) for {} {} with status {}",
                                                     bytes_transferred,
                                                     request_.method,
                                                     request_.path,
-                                                    response_.status_code));
+                                                    status_code));
+                    // Mirror only once the client has its response, so the copy adds no latency.
+                    if (mirror_) {
+                        mirror_->submit(request_);
+                    }
+                    if (Tracer* tracer = server_.tracer(); tracer && timings_.parsed != std::chrono::steady_clock::time_point{}) {
+                        // After a 504 the handler thread may still be writing its timestamps; leave them out.
+                        RequestTimings timings;
+                        timings.start_wall = timings_.start_wall;
+                        timings.received = timings_.received;
+                        timings.parsed = timings_.parsed;
+                        if (handler_done_ && !timed_out_) {
+                            timings.handler_start = timings_.handler_start;
+                            timings.handler_end = timings_.handler_end;
+                        }
+                        timings.sent = std::chrono::steady_clock::now();
+                        tracer->finish(request_.trace, request_.method, request_.path, status_code, timings);
+                    }
                     asio::error_code shutdown_ec;
                     socket_.shutdown(asio::ip::tcp::socket::shutdown_both, shutdown_ec);
                     if (shutdown_ec && shutdown_ec != asio::error::not_connected) {
@@ -337,6 +1203,59 @@ namespace Haka
             });
     }
 
+    // Checks the request line against ServerConfig::health_path: "GET <path> " or "HEAD <path> ".
+    inline bool Connection::is_health_probe() const {
+        const std::string& path = server_.config().health_path;
+        if (path.empty()) return false;
+        std::string_view line(request_buffer_);
+        std::size_t end = line.find("\r\n");
+        if (end == std::string_view::npos) return false; // Request line not complete yet
+        line = line.substr(0, end);
+        if (line.rfind("GET ", 0) == 0) {
+            line.remove_prefix(4);
+        } else if (line.rfind("HEAD ", 0) == 0) {
+            line.remove_prefix(5);
+        } else {
+            return false;
+        }
+        return line.size() > path.size() && line.compare(0, path.size(), path) == 0 && line[path.size()] == ' ';
+    }
+
+    // Writes the prebuilt health response (owned by the Server) and closes.
+    inline void Connection::send_health() {
+        std::string_view response = server_.health_response();
+        if (request_buffer_.rfind("HEAD ", 0) == 0) {
+            response = response.substr(0, response.find("\r\n\r\n") + 4); // Headers only
+        }
+        send_raw(response);
+    }
+
+    inline void Connection::send_head_limit(int status_code) {
+        log_message("WARN", fmt::format("Request head from {} over limit, answering {}", request_.remote_address, status_code));
+        send_raw(server_.head_limit_response(status_code));
+    }
+
+    // Writes a prebuilt response that outlives the connection, then closes.
+    inline void Connection::send_raw(std::string_view response) {
+        auto self = shared_from_this();
+        asio::async_write(socket_, asio::buffer(response.data(), response.size()),
+            [this, self](asio::error_code, std::size_t) {
+                asio::error_code ignored;
+                socket_.shutdown(asio::ip::tcp::socket::shutdown_both, ignored);
+                socket_.close(ignored);
+            });
+    }
+
+    // Adds the server-wide headers every response to this request carries.
+    inline void Connection::stamp(Response& response) const {
+        if (!request_.id.empty() && !server_.config().request_id_header.empty()) {
+            response.headers[server_.config().request_id_header] = request_.id.view();
+        }
+        if (!server_.alt_svc().empty()) {
+            response.headers["Alt-Svc"] = server_.alt_svc();
+        }
+    }
+
 } // namespace Haka
 
 #endif // HAKA_SERVER_HPP
@@ -0,0 +1,564 @@
+#ifndef HAKA_SESSION_HPP
+#define HAKA_SESSION_HPP
+
+// Project includes
+#include "haka/core.hpp"          // For Request, Response, log_message
+#include "haka/metrics.hpp"       // For append_metric
+#include "haka/memory_budget.hpp" // For accounting session memory
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace Haka {
+
+/**
+ * @brief Settings for the session store (Server::sessions).
+ */
+struct SessionConfig {
+    // Cookie carrying the session ID.
+    std::string cookie_name = "haka_sid";
+    std::string cookie_path = "/";
+    bool cookie_secure = false;         // Add "Secure" (HTTPS-only)
+    std::string cookie_same_site = "Lax";
+    // A session expires after this long without a request that uses it.
+    std::chrono::seconds idle_timeout{1800};
+    // Resolution of expiry: the timing wheel advances once per tick.
+    std::chrono::milliseconds tick{1000};
+    // Most sessions kept; the least recently used are evicted beyond this.
+    std::size_t max_sessions = 100000;
+    // Independently locked shards of the store.
+    std::size_t shards = 16;
+    // File the sessions are saved to on shutdown and loaded from on startup,
+    // so a restart does not log everyone out. Empty disables it.
+    std::string snapshot_path{};
+};
+
+/**
+ * @brief One client's session: a small string map shared by every request
+ * that presents its cookie. Safe to use from concurrent handlers.
+ */
+class Session {
+public:
+    inline explicit Session(std::string id) : id_(std::move(id)) {
+        std::size_t bytes = sizeof(Session) + id_.capacity() + kEntryOverhead;
+        bytes_.store(bytes, std::memory_order_relaxed);
+        memory_budget().reserve(MemorySubsystem::Caches, bytes);
+    }
+
+    inline ~Session() {
+        memory_budget().release(MemorySubsystem::Caches, bytes_.load(std::memory_order_relaxed));
+    }
+
+    Session(const Session&) = delete;
+    Session& operator=(const Session&) = delete;
+
+    /**
+     * @brief Gets a value.
+     * @param key The key.
+     * @return A copy of the value, or nullopt if it is not set.
+     */
+    inline std::optional<std::string> get(std::string_view key) const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = values_.find(key);
+        if (it == values_.end()) return std::nullopt;
+        return it->second;
+    }
+
+    /**
+     * @brief Sets a value, replacing any previous one.
+     * @param key The key.
+     * @param value The value.
+     */
+    inline void set(std::string key, std::string value) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = values_.find(key);
+        if (it != values_.end()) {
+            account(value.size(), it->second.size());
+            it->second = std::move(value);
+        } else {
+            account(key.size() + value.size() + kEntryOverhead, 0);
+            values_.emplace(std::move(key), std::move(value));
+        }
+    }
+
+    /**
+     * @brief Removes a value.
+     * @param key The key.
+     */
+    inline void erase(std::string_view key) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = values_.find(key);
+        if (it == values_.end()) return;
+        account(0, it->first.size() + it->second.size() + kEntryOverhead);
+        values_.erase(it);
+    }
+
+    /**
+     * @brief Ends the session: it is removed from the store after the
+     * handler returns and the client is told to drop its cookie.
+     */
+    inline void invalidate() {
+        invalidated_.store(true, std::memory_order_relaxed);
+    }
+
+    inline const std::string& id() const { return id_; }
+
+    // Whether the session was created for the current request.
+    inline bool is_new() const { return is_new_.load(std::memory_order_relaxed); }
+
+    /**
+     * @brief Copies all values, e.g., to save them.
+     */
+    inline std::map<std::string, std::string, std::less<>> values() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return values_;
+    }
+
+private:
+    friend class SessionStore;
+
+    // Rough per-entry cost of map nodes and string headers.
+    static constexpr std::size_t kEntryOverhead = 96;
+
+    // Called with mutex_ held.
+    inline void account(std::size_t added, std::size_t removed) {
+        if (added > removed) {
+            memory_budget().reserve(MemorySubsystem::Caches, added - removed);
+            bytes_.fetch_add(added - removed, std::memory_order_relaxed);
+        } else {
+            memory_budget().release(MemorySubsystem::Caches, removed - added);
+            bytes_.fetch_sub(removed - added, std::memory_order_relaxed);
+        }
+    }
+
+    std::string id_;
+    mutable std::mutex mutex_;
+    std::map<std::string, std::string, std::less<>> values_;
+    std::atomic<std::size_t> bytes_{0}; // Written with mutex_ held; read by the store's shrinker
+    std::atomic<bool> is_new_{false};
+    std::atomic<bool> invalidated_{false};
+};
+
+/**
+ * @brief In-memory session store, sharded with a lock per shard. Sessions
+ * expire after SessionConfig::idle_timeout without use (sliding expiry).
+ * Expiry is driven by a hashed timing wheel per shard: a session sits in the
+ * slot of the tick it is due, touching it only moves its deadline, and when
+ * its slot comes up it is either dropped or re-slotted for the new deadline.
+ * There are no per-session timers and no scans of the whole store. Each shard
+ * also keeps an LRU list to enforce SessionConfig::max_sessions.
+ */
+class SessionStore {
+public:
+    /**
+     * @param config Cookie, expiry and size settings. Loads the snapshot if
+     * config.snapshot_path names an existing file.
+     * @throws std::invalid_argument if tick or idle_timeout is not positive.
+     */
+    inline explicit SessionStore(SessionConfig config)
+        : config_(std::move(config)), start_(std::chrono::steady_clock::now()) {
+        if (config_.tick.count() <= 0 || config_.idle_timeout.count() <= 0) {
+            throw std::invalid_argument("Sessions: tick and idle_timeout must be positive");
+        }
+        config_.shards = std::max<std::size_t>(1, config_.shards);
+        shard_capacity_ = std::max<std::size_t>(1, config_.max_sessions / config_.shards);
+        auto timeout = std::chrono::duration_cast<std::chrono::milliseconds>(config_.idle_timeout);
+        timeout_ticks_ = static_cast<uint64_t>((timeout.count() + config_.tick.count() - 1) / config_.tick.count());
+        // Deadlines further out than the wheel wraps are re-slotted when their slot comes up.
+        wheel_size_ = static_cast<std::size_t>(std::min<uint64_t>(timeout_ticks_ + 1, 4096));
+        shards_ = std::vector<Shard>(config_.shards);
+        for (auto& shard : shards_) {
+            shard.wheel.resize(wheel_size_);
+        }
+        cookie_attributes_ = "; Path=" + config_.cookie_path + "; HttpOnly";
+        if (!config_.cookie_same_site.empty()) cookie_attributes_ += "; SameSite=" + config_.cookie_same_site;
+        if (config_.cookie_secure) cookie_attributes_ += "; Secure";
+        if (!config_.snapshot_path.empty()) {
+            load(config_.snapshot_path);
+        }
+        shrinker_id_ = memory_budget().add_shrinker("sessions", [this](std::size_t target) { return shrink(target); });
+    }
+
+    /**
+     * @brief Saves the snapshot (if configured).
+     */
+    inline ~SessionStore() {
+        memory_budget().remove_shrinker(shrinker_id_);
+        if (!config_.snapshot_path.empty()) {
+            save(config_.snapshot_path);
+        }
+    }
+
+    SessionStore(const SessionStore&) = delete;
+    SessionStore& operator=(const SessionStore&) = delete;
+
+    inline const SessionConfig& config() const { return config_; }
+
+    /**
+     * @brief Finds a live session and extends its expiry, or starts a new one.
+     * Unknown IDs are never adopted; a new session always gets a fresh ID.
+     * @param id The ID from the client's cookie (may be empty).
+     * @return The session.
+     */
+    inline std::shared_ptr<Session> acquire(std::string_view id) {
+        uint64_t now = current_tick();
+        if (!id.empty()) {
+            Shard& shard = shard_for(id);
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            auto it = shard.entries.find(id);
+            if (it != shard.entries.end()) {
+                if (it->second.expires_tick > now) {
+                    it->second.expires_tick = now + timeout_ticks_;
+                    shard.lru.splice(shard.lru.begin(), shard.lru, it->second.lru);
+                    return it->second.session;
+                }
+                erase(shard, it);
+                expired_.fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+        auto session = std::make_shared<Session>(generate_id());
+        session->is_new_.store(true, std::memory_order_relaxed);
+        insert(session, now + timeout_ticks_);
+        created_.fetch_add(1, std::memory_order_relaxed);
+        return session;
+    }
+
+    /**
+     * @brief Removes a session.
+     * @param id The session ID.
+     */
+    inline void remove(std::string_view id) {
+        Shard& shard = shard_for(id);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        auto it = shard.entries.find(id);
+        if (it != shard.entries.end()) erase(shard, it);
+    }
+
+    /**
+     * @brief Advances the timing wheels to the current tick, dropping the
+     * sessions that have expired. The server calls this every
+     * SessionConfig::tick; the work is proportional to the sessions due.
+     */
+    inline void advance() {
+        uint64_t now = current_tick();
+        std::vector<std::string> due;
+        for (auto& shard : shards_) {
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            while (shard.processed_tick < now) {
+                uint64_t tick = ++shard.processed_tick;
+                auto& slot = shard.wheel[tick % wheel_size_];
+                due.swap(slot);
+                for (const auto& id : due) {
+                    auto it = shard.entries.find(id);
+                    if (it == shard.entries.end() || it->second.scheduled_tick != tick) continue; // Evicted or removed
+                    if (it->second.expires_tick <= tick) {
+                        erase(shard, it);
+                        expired_.fetch_add(1, std::memory_order_relaxed);
+                    } else {
+                        schedule(shard, it->first, it->second);
+                    }
+                }
+                due.clear();
+                if (slot.empty()) slot.swap(due); // Keep the slot's capacity for the next lap
+            }
+        }
+    }
+
+    /**
+     * @brief Counts the sessions currently held.
+     */
+    inline std::size_t size() const {
+        std::size_t total = 0;
+        for (auto& shard : shards_) {
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            total += shard.entries.size();
+        }
+        return total;
+    }
+
+    /**
+     * @brief Writes every live session and its remaining lifetime to a file
+     * (via a temporary file and rename, so a crash never leaves it half written).
+     * The format is native-endian and meant for restarts on the same host.
+     * @param path The snapshot file.
+     * @return true on success.
+     */
+    inline bool save(const std::string& path) const {
+        std::string tmp = path + ".tmp";
+        std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+        if (!out) {
+            log_message("ERROR", fmt::format("Sessions: cannot write snapshot {}", tmp));
+            return false;
+        }
+        out.write(kSnapshotMagic, sizeof(kSnapshotMagic));
+        uint64_t now = current_tick();
+        int64_t wall_now = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
+        std::size_t count = 0;
+        for (auto& shard : shards_) {
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            for (const auto& [id, entry] : shard.entries) {
+                if (entry.expires_tick <= now) continue;
+                int64_t expires_ms = wall_now + static_cast<int64_t>(entry.expires_tick - now) * config_.tick.count();
+                auto values = entry.session->values();
+                write_string(out, id);
+                write_pod(out, expires_ms);
+                write_pod(out, static_cast<uint32_t>(values.size()));
+                for (const auto& [key, value] : values) {
+                    write_string(out, key);
+                    write_string(out, value);
+                }
+                ++count;
+            }
+        }
+        out.close();
+        if (!out || std::rename(tmp.c_str(), path.c_str()) != 0) {
+            log_message("ERROR", fmt::format("Sessions: failed to save snapshot {}", path));
+            std::remove(tmp.c_str());
+            return false;
+        }
+        log_message("INFO", fmt::format("Sessions: saved {} sessions to {}", count, path));
+        return true;
+    }
+
+    /**
+     * @brief Restores the sessions saved by save() that have not expired since.
+     * @param path The snapshot file.
+     * @return The number of sessions restored (0 if the file is missing or invalid).
+     */
+    inline std::size_t load(const std::string& path) {
+        std::ifstream in(path, std::ios::binary);
+        if (!in) return 0;
+        char magic[sizeof(kSnapshotMagic)] = {};
+        in.read(magic, sizeof(magic));
+        if (!in || std::memcmp(magic, kSnapshotMagic, sizeof(magic)) != 0) {
+            log_message("WARN", fmt::format("Sessions: ignoring {}, not a session snapshot", path));
+            return 0;
+        }
+        uint64_t now = current_tick();
+        int64_t wall_now = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
+        std::size_t restored = 0;
+        std::string id, key, value;
+        int64_t expires_ms = 0;
+        uint32_t count = 0;
+        while (read_string(in, id) && read_pod(in, expires_ms) && read_pod(in, count)) {
+            auto session = std::make_shared<Session>(id);
+            bool complete = true;
+            for (uint32_t i = 0; i < count && complete; ++i) {
+                complete = read_string(in, key) && read_string(in, value);
+                if (complete) session->set(key, value);
+            }
+            if (!complete) break;
+            if (expires_ms <= wall_now) continue;
+            uint64_t remaining = static_cast<uint64_t>((expires_ms - wall_now + config_.tick.count() - 1) / config_.tick.count());
+            insert(session, now + std::min(remaining, timeout_ticks_));
+            ++restored;
+        }
+        log_message("INFO", fmt::format("Sessions: restored {} sessions from {}", restored, path));
+        return restored;
+    }
+
+    /**
+     * @brief Appends session counters in Prometheus text format.
+     * @param out The buffer to append to.
+     */
+    inline void collect_metrics(std::string& out) const {
+        out += "# TYPE haka_sessions gauge\n";
+        append_metric(out, "haka_sessions", "", size());
+        out += "# TYPE haka_sessions_created_total counter\n";
+        append_metric(out, "haka_sessions_created_total", "", created_.load(std::memory_order_relaxed));
+        out += "# TYPE haka_sessions_expired_total counter\n";
+        append_metric(out, "haka_sessions_expired_total", "", expired_.load(std::memory_order_relaxed));
+        out += "# TYPE haka_sessions_evicted_total counter\n";
+        append_metric(out, "haka_sessions_evicted_total", "", evicted_.load(std::memory_order_relaxed));
+    }
+
+    /**
+     * @brief Finishes a request's use of its session after the handler ran:
+     * sets the cookie for a new session, or removes an invalidated one and
+     * expires its cookie. Does nothing if the handler never used a session.
+     * The cookie is added to `res.cookies`, next to any the handler set.
+     * @param req The request.
+     * @param res The response to add Set-Cookie to.
+     */
+    static inline void commit(Request& req, Response& res) {
+        if (!req.session_ || !req.session_store) return;
+        Session& session = *req.session_;
+        const SessionStore& store = *req.session_store;
+        if (session.invalidated_.load(std::memory_order_relaxed)) {
+            req.session_store->remove(session.id());
+            res.cookies.push_back(store.config_.cookie_name + "=" + store.cookie_attributes_ + "; Max-Age=0");
+        } else if (session.is_new_.exchange(false, std::memory_order_relaxed)) {
+            res.cookies.push_back(store.config_.cookie_name + "=" + session.id() + store.cookie_attributes_);
+        }
+    }
+
+private:
+    struct StringHash {
+        using is_transparent = void;
+        inline std::size_t operator()(std::string_view s) const { return std::hash<std::string_view>{}(s); }
+    };
+
+    struct Entry {
+        std::shared_ptr<Session> session;
+        std::list<const std::string*>::iterator lru; // Points at the map key
+        uint64_t expires_tick = 0;   // Moves forward whenever the session is used
+        uint64_t scheduled_tick = 0; // Wheel slot the session currently sits in
+    };
+
+    struct Shard {
+        mutable std::mutex mutex;
+        std::unordered_map<std::string, Entry, StringHash, std::equal_to<>> entries;
+        std::list<const std::string*> lru; // Most recently used first
+        std::vector<std::vector<std::string>> wheel;
+        uint64_t processed_tick = 0;
+    };
+
+    static constexpr char kSnapshotMagic[8] = {'H', 'A', 'K', 'A', 'S', 'E', 'S', '1'};
+
+    inline uint64_t current_tick() const {
+        return static_cast<uint64_t>((std::chrono::steady_clock::now() - start_) / config_.tick);
+    }
+
+    inline Shard& shard_for(std::string_view id) {
+        return shards_[std::hash<std::string_view>{}(id) % shards_.size()];
+    }
+
+    // 128 random bits from the OS generator, hex encoded.
+    static inline std::string generate_id() {
+        thread_local std::random_device random;
+        static constexpr char digits[] = "0123456789abcdef";
+        std::string id(32, '0');
+        for (std::size_t i = 0; i < 32; i += 8) {
+            uint32_t bits = random();
+            for (std::size_t j = 0; j < 8; ++j, bits >>= 4) {
+                id[i + j] = digits[bits & 0xF];
+            }
+        }
+        return id;
+    }
+
+    inline void insert(const std::shared_ptr<Session>& session, uint64_t expires_tick) {
+        Shard& shard = shard_for(session->id());
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        while (shard.entries.size() >= shard_capacity_ && !shard.lru.empty()) {
+            erase(shard, shard.entries.find(*shard.lru.back()));
+            evicted_.fetch_add(1, std::memory_order_relaxed);
+        }
+        auto [it, inserted] = shard.entries.try_emplace(session->id());
+        if (!inserted) return;
+        shard.lru.push_front(&it->first);
+        it->second.session = session;
+        it->second.lru = shard.lru.begin();
+        it->second.expires_tick = expires_tick;
+        schedule(shard, it->first, it->second);
+    }
+
+    // Memory budget shrinker: evicts least recently used sessions, skipping
+    // shards that are busy (this may run on a thread holding one).
+    inline std::size_t shrink(std::size_t target) {
+        std::size_t freed = 0;
+        bool evicted = true;
+        while (freed < target && evicted) {
+            evicted = false;
+            for (auto& shard : shards_) {
+                std::unique_lock<std::mutex> lock(shard.mutex, std::try_to_lock);
+                if (!lock.owns_lock() || shard.lru.empty()) continue;
+                auto it = shard.entries.find(*shard.lru.back());
+                freed += it->second.session->bytes_.load(std::memory_order_relaxed);
+                erase(shard, it);
+                evicted_.fetch_add(1, std::memory_order_relaxed);
+                evicted = true;
+                if (freed >= target) break;
+            }
+        }
+        return freed;
+    }
+
+    // Puts a session in the wheel slot of its deadline, or of the furthest
+    // slot if the deadline is more than a lap away. Called with the shard locked.
+    inline void schedule(Shard& shard, const std::string& id, Entry& entry) {
+        uint64_t tick = std::min(entry.expires_tick, shard.processed_tick + wheel_size_ - 1);
+        tick = std::max(tick, shard.processed_tick + 1);
+        entry.scheduled_tick = tick;
+        shard.wheel[tick % wheel_size_].push_back(id);
+    }
+
+    // Stale IDs left in the wheel are skipped when their slot comes up.
+    // Called with the shard locked.
+    inline void erase(Shard& shard, std::unordered_map<std::string, Entry, StringHash, std::equal_to<>>::iterator it) {
+        shard.lru.erase(it->second.lru);
+        shard.entries.erase(it);
+    }
+
+    template <typename T>
+    static inline void write_pod(std::ofstream& out, T value) {
+        out.write(reinterpret_cast<const char*>(&value), sizeof(value));
+    }
+
+    static inline void write_string(std::ofstream& out, const std::string& s) {
+        write_pod(out, static_cast<uint32_t>(s.size()));
+        out.write(s.data(), static_cast<std::streamsize>(s.size()));
+    }
+
+    template <typename T>
+    static inline bool read_pod(std::ifstream& in, T& value) {
+        return static_cast<bool>(in.read(reinterpret_cast<char*>(&value), sizeof(value)));
+    }
+
+    static inline bool read_string(std::ifstream& in, std::string& s) {
+        uint32_t size = 0;
+        if (!read_pod(in, size) || size > (64u << 20)) return false;
+        s.resize(size);
+        return static_cast<bool>(in.read(s.data(), size));
+    }
+
+    SessionConfig config_;
+    std::chrono::steady_clock::time_point start_;
+    uint64_t timeout_ticks_ = 1;
+    std::size_t wheel_size_ = 1;
+    std::size_t shard_capacity_ = 1;
+    std::string cookie_attributes_; // "; Path=/; HttpOnly; ..."
+    std::vector<Shard> shards_;
+    std::atomic<uint64_t> created_{0};
+    std::atomic<uint64_t> expired_{0};
+    std::atomic<uint64_t> evicted_{0};
+    uint64_t shrinker_id_ = 0;
+};
+
+/**
+ * @brief The request's session, found from its cookie or created on first use.
+ * A new session's cookie is set on the response after the handler returns.
+ * @throws std::logic_error if sessions are not enabled (Server::sessions).
+ */
+inline Session& Request::session() const {
+    if (!session_) {
+        if (!session_store) {
+            throw std::logic_error("Request::session(): sessions are not enabled (call Server::sessions)");
+        }
+        session_ = session_store->acquire(cookie(session_store->config().cookie_name));
+    }
+    return *session_;
+}
+
+} // namespace Haka
+
+#endif // HAKA_SESSION_HPP
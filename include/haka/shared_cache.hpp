@@ -0,0 +1,510 @@
+#ifndef HAKA_SHARED_CACHE_HPP
+#define HAKA_SHARED_CACHE_HPP
+
+// POSIX shared memory is not available on Windows builds; the cache is
+// simply not provided there.
+#if !defined(_WIN32)
+
+// Project includes
+#include "haka/core.hpp" // For log_message
+#include "haka/memory_budget.hpp" // For accounting the mapped segment
+
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <type_traits>
+
+// POSIX shared memory
+#include <fcntl.h>
+#include <signal.h>   // For kill (owner liveness checks)
+#include <sys/file.h> // For flock
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace Haka {
+
+/**
+ * @brief Converts keys and values to and from the raw bytes stored in a
+ * SharedCache slot. Trivially copyable types are stored as-is; a
+ * specialization below handles std::string. Specialize this for your own
+ * types if they need a custom encoding.
+ */
+template <typename T>
+struct SharedCacheCodec {
+    static_assert(std::is_trivially_copyable_v<T>,
+                  "SharedCache keys/values must be trivially copyable or have a SharedCacheCodec specialization");
+
+    static std::size_t size(const T&) { return sizeof(T); }
+    static void encode(const T& value, char* out) { std::memcpy(out, &value, sizeof(T)); }
+    static bool decode(const char* in, std::size_t size, T& out) {
+        if (size != sizeof(T)) return false;
+        std::memcpy(&out, in, sizeof(T));
+        return true;
+    }
+};
+
+template <>
+struct SharedCacheCodec<std::string> {
+    static std::size_t size(const std::string& value) { return value.size(); }
+    static void encode(const std::string& value, char* out) { std::memcpy(out, value.data(), value.size()); }
+    static bool decode(const char* in, std::size_t size, std::string& out) {
+        out.assign(in, size);
+        return true;
+    }
+};
+
+/**
+ * @brief Counters kept in the shared segment, so they cover every process
+ * attached to the cache.
+ */
+struct SharedCacheStats {
+    std::uint64_t hits = 0;
+    std::uint64_t misses = 0;
+    std::uint64_t inserts = 0;
+    std::uint64_t evictions = 0;
+    std::uint64_t rejected = 0; // Entries refused because they exceeded the size limits
+    std::uint64_t recovered = 0; // Locks taken over from processes that died holding them
+};
+
+/**
+ * @brief A fixed-size hash table living in a POSIX shared-memory segment,
+ * shared by every process on the host that opens the same name.
+ *
+ * Each slot is protected by a seqlock: readers never block and retry if a
+ * writer touched the slot while they were copying it out, writers take the
+ * slot's lock and flip its sequence number to odd. Writers of the same key
+ * are also serialized by a lock on the key's home slot, so two concurrent
+ * puts cannot store it twice. Locks hold the owner's pid, so a process that
+ * dies mid-put (e.g., a killed worker) doesn't wedge the slot: the next
+ * writer finds the owner gone, takes the lock over and discards the
+ * half-written entry. This assumes the processes share a pid namespace.
+ * Segment initialization runs under flock(), which the kernel releases if
+ * the creator dies, so a half-initialized segment is rebuilt by the next
+ * process to open it. Keys hash into a short probe
+ * window; when the window is full a CLOCK sweep over it picks the victim,
+ * so recently read entries get a second chance before being evicted.
+ *
+ * Keys and values are copied in and out of the segment, so their encoded
+ * size is capped by MaxKeyBytes / MaxValueBytes; larger entries are
+ * rejected by put().
+ *
+ * @tparam K Key type (trivially copyable or std::string).
+ * @tparam V Value type (trivially copyable or std::string).
+ * @tparam MaxKeyBytes Maximum encoded key size.
+ * @tparam MaxValueBytes Maximum encoded value size.
+ */
+template <typename K, typename V, std::size_t MaxKeyBytes = 64, std::size_t MaxValueBytes = 1024>
+class SharedCache {
+public:
+    /**
+     * @brief Opens the named segment, creating and initializing it if this
+     * is the first process to ask for it.
+     * @param name Segment name (e.g., "/haka-products"); must start with '/'.
+     * @param capacity Number of slots; rounded up to a power of two.
+     * @throws std::runtime_error if the segment cannot be created or was
+     *         created with a different layout.
+     */
+    inline SharedCache(const std::string& name, std::size_t capacity)
+        : name_(name)
+    {
+        capacity_ = 1;
+        while (capacity_ < capacity || capacity_ < kProbeWindow) capacity_ <<= 1;
+        mapped_size_ = sizeof(Header) + capacity_ * sizeof(Slot);
+
+        int fd = ::shm_open(name_.c_str(), O_RDWR | O_CREAT, 0600);
+        if (fd < 0) {
+            throw std::runtime_error(fmt::format("SharedCache: shm_open('{}') failed: {}", name_, std::strerror(errno)));
+        }
+        // Whoever holds the lock initializes the segment if nobody has
+        // finished doing so; a creator that died released it with its fd.
+        // Where shm descriptors can't be locked, racing creators write the
+        // same header, which is harmless.
+        bool locked = ::flock(fd, LOCK_EX) == 0;
+        auto fail = [&](const std::string& message) {
+            if (locked) ::flock(fd, LOCK_UN);
+            ::close(fd);
+            throw std::runtime_error(message);
+        };
+
+        struct stat st {};
+        if (::fstat(fd, &st) != 0) {
+            fail(fmt::format("SharedCache: fstat('{}') failed: {}", name_, std::strerror(errno)));
+        }
+        bool created = st.st_size == 0;
+        if (created && ::ftruncate(fd, static_cast<off_t>(mapped_size_)) != 0) {
+            fail(fmt::format("SharedCache: ftruncate('{}') failed: {}", name_, std::strerror(errno)));
+        }
+        if (!created && static_cast<std::size_t>(st.st_size) != mapped_size_) {
+            fail(fmt::format("SharedCache: segment '{}' has a different size than expected", name_));
+        }
+
+        void* addr = ::mmap(nullptr, mapped_size_, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (addr == MAP_FAILED) {
+            fail(fmt::format("SharedCache: mmap('{}') failed: {}", name_, std::strerror(errno)));
+        }
+        header_ = static_cast<Header*>(addr);
+        slots_ = reinterpret_cast<Slot*>(static_cast<char*>(addr) + sizeof(Header));
+
+        if (header_->ready.load(std::memory_order_acquire) == 0) {
+            if (!created) {
+                // Sized but never marked ready: its creator died mid-initialization.
+                // No one attached to it, so only the header needs redoing.
+                log_message("WARN", fmt::format("Shared cache '{}' was left half-initialized; rebuilding it", name_));
+            }
+            // ftruncate zero-fills the segment, so every slot starts empty and unlocked.
+            header_->layout = layout_id();
+            header_->capacity = capacity_;
+            header_->ready.store(1, std::memory_order_release);
+            log_message("INFO", fmt::format("Created shared cache '{}' with {} slots ({} bytes)", name_, capacity_, mapped_size_));
+        } else if (header_->layout != layout_id() || header_->capacity != capacity_) {
+            ::munmap(addr, mapped_size_);
+            header_ = nullptr;
+            fail(fmt::format("SharedCache: segment '{}' was created with a different layout", name_));
+        } else {
+            log_message("INFO", fmt::format("Attached to shared cache '{}' ({} slots)", name_, capacity_));
+        }
+        if (locked) ::flock(fd, LOCK_UN);
+        ::close(fd);
+        // The segment is fixed-size, so it is accounted but cannot shrink.
+        memory_budget().reserve(MemorySubsystem::Caches, mapped_size_);
+    }
+
+    inline ~SharedCache() {
+        if (header_) {
+            ::munmap(header_, mapped_size_);
+            memory_budget().release(MemorySubsystem::Caches, mapped_size_);
+        }
+    }
+
+    SharedCache(const SharedCache&) = delete;
+    SharedCache& operator=(const SharedCache&) = delete;
+
+    /**
+     * @brief Removes the named segment from the system. Processes that still
+     * have it mapped keep working; new opens will create a fresh segment.
+     * @param name Segment name passed to the constructor.
+     */
+    static inline void unlink(const std::string& name) {
+        ::shm_unlink(name.c_str());
+    }
+
+    /**
+     * @brief Looks up a key.
+     * @param key The key to find.
+     * @return The cached value, or std::nullopt on a miss.
+     */
+    inline std::optional<V> get(const K& key) {
+        char key_bytes[MaxKeyBytes];
+        std::size_t key_size = 0;
+        if (!encode_key(key, key_bytes, key_size)) {
+            header_->misses.fetch_add(1, std::memory_order_relaxed);
+            return std::nullopt;
+        }
+        std::uint64_t hash = hash_bytes(key_bytes, key_size);
+
+        char value_bytes[MaxValueBytes];
+        for (std::size_t i = 0; i < kProbeWindow; ++i) {
+            Slot& slot = slot_at(hash, i);
+            std::uint32_t value_size = 0;
+            if (read_slot(slot, hash, key_bytes, key_size, value_bytes, value_size)) {
+                V value{};
+                if (!SharedCacheCodec<V>::decode(value_bytes, value_size, value)) break;
+                slot.referenced.store(1, std::memory_order_relaxed);
+                header_->hits.fetch_add(1, std::memory_order_relaxed);
+                return value;
+            }
+        }
+        header_->misses.fetch_add(1, std::memory_order_relaxed);
+        return std::nullopt;
+    }
+
+    /**
+     * @brief Inserts or replaces an entry. Evicts an entry from the key's
+     * probe window if it is full.
+     * @param key The key to store.
+     * @param value The value to store.
+     * @return false if the entry exceeds the size limits or its slot stayed
+     *         locked by another writer.
+     */
+    inline bool put(const K& key, const V& value) {
+        char key_bytes[MaxKeyBytes];
+        std::size_t key_size = 0;
+        std::size_t value_size = SharedCacheCodec<V>::size(value);
+        if (!encode_key(key, key_bytes, key_size) || value_size > MaxValueBytes) {
+            header_->rejected.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        std::uint64_t hash = hash_bytes(key_bytes, key_size);
+
+        // Every put of this key takes the same home-slot writer lock, so the
+        // probe below cannot race another put of the key into a second slot.
+        Slot& home = slot_at(hash, 0);
+        if (!lock_owner(home.writer)) {
+            header_->rejected.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+
+        // Prefer the slot already holding this key, then an empty slot, then a CLOCK victim.
+        Slot* target = nullptr;
+        Slot* empty = nullptr;
+        for (std::size_t i = 0; i < kProbeWindow && !target; ++i) {
+            Slot& slot = slot_at(hash, i);
+            std::uint32_t ignored = 0;
+            if (read_slot(slot, hash, key_bytes, key_size, nullptr, ignored)) {
+                target = &slot;
+            } else if (!empty && slot.hash.load(std::memory_order_relaxed) == 0) {
+                empty = &slot;
+            }
+        }
+        bool evicting = false;
+        if (!target) target = empty;
+        if (!target) {
+            target = clock_victim(hash);
+            evicting = true;
+        }
+
+        std::uint32_t seq = 0;
+        if (!lock_slot(*target, seq)) {
+            home.writer.store(0, std::memory_order_release);
+            header_->rejected.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        target->key_size = static_cast<std::uint16_t>(key_size);
+        target->value_size = static_cast<std::uint32_t>(value_size);
+        std::memcpy(target->key, key_bytes, key_size);
+        SharedCacheCodec<V>::encode(value, target->value);
+        target->hash.store(hash, std::memory_order_relaxed);
+        target->referenced.store(1, std::memory_order_relaxed);
+        unlock_slot(*target, seq);
+        home.writer.store(0, std::memory_order_release);
+
+        header_->inserts.fetch_add(1, std::memory_order_relaxed);
+        if (evicting) header_->evictions.fetch_add(1, std::memory_order_relaxed);
+        return true;
+    }
+
+    /**
+     * @brief Removes a key if present.
+     * @param key The key to remove.
+     * @return true if an entry was removed.
+     */
+    inline bool erase(const K& key) {
+        char key_bytes[MaxKeyBytes];
+        std::size_t key_size = 0;
+        if (!encode_key(key, key_bytes, key_size)) return false;
+        std::uint64_t hash = hash_bytes(key_bytes, key_size);
+
+        bool removed = false;
+        for (std::size_t i = 0; i < kProbeWindow; ++i) {
+            Slot& slot = slot_at(hash, i);
+            std::uint32_t ignored = 0;
+            if (!read_slot(slot, hash, key_bytes, key_size, nullptr, ignored)) continue;
+            std::uint32_t seq = 0;
+            if (!lock_slot(slot, seq)) continue;
+            if (slot.hash.load(std::memory_order_relaxed) == hash) {
+                slot.hash.store(0, std::memory_order_relaxed);
+                removed = true;
+            }
+            unlock_slot(slot, seq);
+        }
+        return removed;
+    }
+
+    /**
+     * @brief Snapshot of the segment-wide counters.
+     */
+    inline SharedCacheStats stats() const {
+        SharedCacheStats s;
+        s.hits = header_->hits.load(std::memory_order_relaxed);
+        s.misses = header_->misses.load(std::memory_order_relaxed);
+        s.inserts = header_->inserts.load(std::memory_order_relaxed);
+        s.evictions = header_->evictions.load(std::memory_order_relaxed);
+        s.rejected = header_->rejected.load(std::memory_order_relaxed);
+        s.recovered = header_->recovered.load(std::memory_order_relaxed);
+        return s;
+    }
+
+    /**
+     * @brief Number of slots in the segment.
+     */
+    inline std::size_t capacity() const { return capacity_; }
+
+private:
+    static constexpr std::size_t kProbeWindow = 8;    // Slots a key may live in
+    static constexpr int kMaxReadRetries = 64;        // Seqlock retries before treating a slot as a miss
+    static constexpr int kMaxLockSpins = 1024;        // Spins before a writer gives up on a busy slot
+    static constexpr int kOwnerCheckSpins = 128;      // Spins between checks that a lock's owner is alive
+    static constexpr std::uint64_t kMagic = 0x48414b4153484d33ULL; // "HAKASHM3"
+
+    struct Header {
+        std::uint64_t layout;
+        std::uint64_t capacity;
+        std::atomic<std::uint32_t> ready;
+        std::atomic<std::uint64_t> clock_hand;
+        std::atomic<std::uint64_t> hits;
+        std::atomic<std::uint64_t> misses;
+        std::atomic<std::uint64_t> inserts;
+        std::atomic<std::uint64_t> evictions;
+        std::atomic<std::uint64_t> rejected;
+        std::atomic<std::uint64_t> recovered;
+    };
+
+    // One cache entry. A hash of 0 marks an empty slot.
+    struct alignas(64) Slot {
+        std::atomic<std::uint32_t> seq;       // Even: stable, odd: being written
+        std::atomic<std::uint8_t> referenced; // CLOCK reference bit
+        std::atomic<std::uint32_t> lock;      // Pid of the process writing the slot, 0 when free
+        std::atomic<std::uint32_t> writer;    // Pid of the put() of a key whose home slot this is, 0 when free
+        std::atomic<std::uint64_t> hash;
+        std::uint16_t key_size;
+        std::uint32_t value_size;
+        char key[MaxKeyBytes];
+        char value[MaxValueBytes];
+    };
+
+    static_assert(std::atomic<std::uint32_t>::is_always_lock_free &&
+                  std::atomic<std::uint64_t>::is_always_lock_free,
+                  "SharedCache requires lock-free atomics to work across processes");
+
+    // Identifies the compiled layout so mismatched binaries refuse to share a segment.
+    static constexpr std::uint64_t layout_id() {
+        return kMagic ^ (static_cast<std::uint64_t>(sizeof(Slot)) << 32) ^ (MaxKeyBytes << 16) ^ MaxValueBytes;
+    }
+
+    static inline std::uint64_t hash_bytes(const char* data, std::size_t size) {
+        // FNV-1a: stable across processes and builds, unlike std::hash.
+        std::uint64_t h = 0xcbf29ce484222325ULL;
+        for (std::size_t i = 0; i < size; ++i) {
+            h ^= static_cast<unsigned char>(data[i]);
+            h *= 0x100000001b3ULL;
+        }
+        return h == 0 ? 1 : h; // 0 is reserved for empty slots
+    }
+
+    static inline bool encode_key(const K& key, char* out, std::size_t& size) {
+        size = SharedCacheCodec<K>::size(key);
+        if (size > MaxKeyBytes) return false;
+        SharedCacheCodec<K>::encode(key, out);
+        return true;
+    }
+
+    inline Slot& slot_at(std::uint64_t hash, std::size_t probe) const {
+        return slots_[(hash + probe) & (capacity_ - 1)];
+    }
+
+    /**
+     * @brief Seqlock read of a slot. Copies the value out if the slot holds
+     * the requested key and value_out is non-null.
+     * @return true if the slot holds the key.
+     */
+    inline bool read_slot(Slot& slot, std::uint64_t hash, const char* key, std::size_t key_size,
+                          char* value_out, std::uint32_t& value_size) const {
+        char key_copy[MaxKeyBytes];
+        for (int attempt = 0; attempt < kMaxReadRetries; ++attempt) {
+            std::uint32_t before = slot.seq.load(std::memory_order_acquire);
+            if (before & 1) {
+                std::this_thread::yield();
+                continue;
+            }
+            if (slot.hash.load(std::memory_order_relaxed) != hash) {
+                if (slot.seq.load(std::memory_order_acquire) == before) return false;
+                continue;
+            }
+            std::size_t stored_key_size = slot.key_size;
+            value_size = slot.value_size;
+            if (stored_key_size != key_size || value_size > MaxValueBytes) {
+                if (slot.seq.load(std::memory_order_acquire) == before) return false;
+                continue;
+            }
+            std::memcpy(key_copy, slot.key, key_size);
+            if (value_out) std::memcpy(value_out, slot.value, value_size);
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (slot.seq.load(std::memory_order_relaxed) != before) continue;
+            return std::memcmp(key_copy, key, key_size) == 0;
+        }
+        return false;
+    }
+
+    /**
+     * @brief Takes a slot for writing.
+     * @param seq Receives the even sequence number to pass to unlock_slot.
+     * @return false if another live writer kept it for kMaxLockSpins.
+     */
+    inline bool lock_slot(Slot& slot, std::uint32_t& seq) {
+        if (!lock_owner(slot.lock)) return false;
+        seq = slot.seq.load(std::memory_order_relaxed);
+        if (seq & 1) {
+            // Taken over from a writer that died mid-write: drop what it left.
+            seq -= 1;
+            slot.hash.store(0, std::memory_order_relaxed);
+        } else {
+            slot.seq.store(seq + 1, std::memory_order_relaxed);
+        }
+        std::atomic_thread_fence(std::memory_order_release); // Odd sequence before the data writes
+        return true;
+    }
+
+    inline void unlock_slot(Slot& slot, std::uint32_t seq) {
+        slot.seq.store(seq + 2, std::memory_order_release);
+        slot.lock.store(0, std::memory_order_release);
+    }
+
+    /**
+     * @brief Takes a lock word by storing this process's pid in it. A lock
+     * whose owner no longer exists is taken over.
+     * @return false if another live process or thread kept it for kMaxLockSpins.
+     */
+    inline bool lock_owner(std::atomic<std::uint32_t>& lock) {
+        // Not cached: a process forked after the first put must lock under its own pid.
+        const std::uint32_t self = static_cast<std::uint32_t>(::getpid());
+        for (int spin = 0; spin < kMaxLockSpins; ++spin) {
+            std::uint32_t owner = 0;
+            if (lock.compare_exchange_weak(owner, self, std::memory_order_acquire, std::memory_order_relaxed)) {
+                return true;
+            }
+            if (owner != 0 && owner != self && spin % kOwnerCheckSpins == kOwnerCheckSpins - 1 &&
+                ::kill(static_cast<pid_t>(owner), 0) != 0 && errno == ESRCH &&
+                lock.compare_exchange_strong(owner, self, std::memory_order_acquire, std::memory_order_relaxed)) {
+                header_->recovered.fetch_add(1, std::memory_order_relaxed);
+                log_message("WARN", fmt::format("Shared cache '{}': took over a lock held by exited process {}", name_, owner));
+                return true;
+            }
+            std::this_thread::yield();
+        }
+        return false;
+    }
+
+    /**
+     * @brief CLOCK sweep over the key's probe window: clear reference bits
+     * until an unreferenced slot comes around under the hand.
+     */
+    inline Slot* clock_victim(std::uint64_t hash) {
+        std::uint64_t hand = header_->clock_hand.fetch_add(1, std::memory_order_relaxed);
+        for (std::size_t step = 0; step < 2 * kProbeWindow; ++step) {
+            Slot& slot = slot_at(hash, (hand + step) % kProbeWindow);
+            if (slot.referenced.exchange(0, std::memory_order_relaxed) == 0) {
+                return &slot;
+            }
+        }
+        return &slot_at(hash, hand % kProbeWindow);
+    }
+
+    std::string name_;
+    std::size_t capacity_ = 0;
+    std::size_t mapped_size_ = 0;
+    Header* header_ = nullptr;
+    Slot* slots_ = nullptr;
+};
+
+} // namespace Haka
+
+#endif // !_WIN32
+
+#endif // HAKA_SHARED_CACHE_HPP
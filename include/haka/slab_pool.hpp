@@ -0,0 +1,277 @@
+#ifndef HAKA_SLAB_POOL_HPP
+#define HAKA_SLAB_POOL_HPP
+
+// Project includes
+#include "haka/core.hpp"    // For log_message
+#include "haka/metrics.hpp" // For append_metric
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <string>
+#include <vector>
+
+#if defined(__linux__)
+#include <sys/mman.h>
+#endif
+
+namespace Haka {
+
+/**
+ * @brief How an arena chunk is backed, best first.
+ */
+enum class ArenaBacking : uint8_t {
+    HugeTlb,     // Explicit 2 MiB huge page (MAP_HUGETLB, needs vm.nr_hugepages)
+    Transparent, // 2 MiB-aligned mapping with MADV_HUGEPAGE (kernel THP)
+    Regular      // Plain memory (non-Linux, or mmap unavailable)
+};
+
+/**
+ * @brief Hands out 2 MiB chunks backed by huge pages where the system
+ * allows it, so objects carved from them share a few TLB entries instead
+ * of spreading over hundreds of 4 KiB pages. Chunks are never returned to
+ * the system; pools recycle their slots.
+ */
+class HugePageArena {
+public:
+    static constexpr std::size_t kChunkSize = std::size_t{2} << 20;
+
+    /**
+     * @brief Maps one chunk, trying MAP_HUGETLB first, then an aligned
+     * mapping advised with MADV_HUGEPAGE, then plain memory.
+     * @return The chunk (kChunkSize bytes, 2 MiB aligned where possible).
+     * @throws std::bad_alloc if no memory could be obtained.
+     */
+    inline void* allocate_chunk() {
+#if defined(__linux__)
+        void* chunk = ::mmap(nullptr, kChunkSize, PROT_READ | PROT_WRITE,
+                             MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (chunk != MAP_FAILED) {
+            count(ArenaBacking::HugeTlb);
+            return chunk;
+        }
+        // Over-map by one chunk so an aligned 2 MiB window can be cut out;
+        // only an aligned range can be backed by a transparent huge page.
+        void* raw = ::mmap(nullptr, 2 * kChunkSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (raw != MAP_FAILED) {
+            auto start = reinterpret_cast<std::uintptr_t>(raw);
+            auto aligned = (start + kChunkSize - 1) & ~(kChunkSize - 1);
+            if (aligned > start) ::munmap(raw, aligned - start);
+            std::uintptr_t tail = start + 2 * kChunkSize - (aligned + kChunkSize);
+            if (tail > 0) ::munmap(reinterpret_cast<void*>(aligned + kChunkSize), tail);
+            ::madvise(reinterpret_cast<void*>(aligned), kChunkSize, MADV_HUGEPAGE);
+            count(ArenaBacking::Transparent);
+            return reinterpret_cast<void*>(aligned);
+        }
+#endif
+        void* chunk_fallback = ::operator new(kChunkSize, std::align_val_t{4096});
+        count(ArenaBacking::Regular);
+        return chunk_fallback;
+    }
+
+    /**
+     * @brief Appends chunk counts per backing in Prometheus text format.
+     * @param out The buffer to append to.
+     */
+    inline void collect_metrics(std::string& out) const {
+        static const char* names[] = {"hugetlb", "transparent", "regular"};
+        out += "# TYPE haka_arena_chunks gauge\n";
+        for (std::size_t i = 0; i < chunks_.size(); ++i) {
+            append_metric(out, "haka_arena_chunks", fmt::format("backing=\"{}\"", names[i]),
+                          chunks_[i].load(std::memory_order_relaxed));
+        }
+    }
+
+private:
+    inline void count(ArenaBacking backing) {
+        auto n = chunks_[static_cast<std::size_t>(backing)].fetch_add(1, std::memory_order_relaxed);
+        if (n == 0) {
+            static const char* names[] = {"MAP_HUGETLB", "MADV_HUGEPAGE", "regular pages"};
+            log_message("DEBUG", fmt::format("Huge-page arena: first chunk backed by {}", names[static_cast<std::size_t>(backing)]));
+        }
+    }
+
+    std::array<std::atomic<uint64_t>, 3> chunks_{};
+};
+
+/**
+ * @brief The process-wide arena shared by all slab pools.
+ */
+inline HugePageArena& hugepage_arena() {
+    static HugePageArena arena;
+    return arena;
+}
+
+/**
+ * @brief Fixed-size slots carved from huge-page arena chunks, recycled
+ * through a free list. Thread-safe: objects may be freed on another thread
+ * than the one that allocated them (e.g., the last reference to a
+ * Connection dropped on a handler worker). Slots larger than a chunk
+ * can't be carved and come from operator new instead.
+ */
+class SlabPool {
+public:
+    /**
+     * @param slot_size Bytes per slot; rounded up to a cache line.
+     */
+    inline explicit SlabPool(std::size_t slot_size)
+        : slot_size_((std::max(slot_size, sizeof(FreeSlot)) + 63) & ~std::size_t{63}) {}
+
+    SlabPool(const SlabPool&) = delete;
+    SlabPool& operator=(const SlabPool&) = delete;
+
+    inline void* allocate() {
+        if (oversized()) {
+            void* p = ::operator new(slot_size_, std::align_val_t{64});
+            std::lock_guard<std::mutex> lock(mutex_);
+            ++total_;
+            ++in_use_;
+            return p;
+        }
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!free_) {
+            carve_chunk();
+        }
+        FreeSlot* slot = free_;
+        free_ = slot->next;
+        ++in_use_;
+        return slot;
+    }
+
+    inline void deallocate(void* p) {
+        if (oversized()) {
+            ::operator delete(p, std::align_val_t{64});
+            std::lock_guard<std::mutex> lock(mutex_);
+            --total_;
+            --in_use_;
+            return;
+        }
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto* slot = static_cast<FreeSlot*>(p);
+        slot->next = free_;
+        free_ = slot;
+        --in_use_;
+    }
+
+    inline std::size_t slot_size() const { return slot_size_; }
+
+    /**
+     * @brief Appends slot counts in Prometheus text format.
+     * @param out The buffer to append to.
+     */
+    inline void collect_metrics(std::string& out) const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        std::string labels = fmt::format("slot_size=\"{}\"", slot_size_);
+        append_metric(out, "haka_slab_slots_total", labels, total_);
+        append_metric(out, "haka_slab_slots_in_use", labels, in_use_);
+    }
+
+private:
+    struct FreeSlot {
+        FreeSlot* next;
+    };
+
+    inline bool oversized() const { return slot_size_ > HugePageArena::kChunkSize; }
+
+    // Called with mutex_ held.
+    inline void carve_chunk() {
+        char* chunk = static_cast<char*>(hugepage_arena().allocate_chunk());
+        std::size_t count = HugePageArena::kChunkSize / slot_size_;
+        // Link in address order so consecutive allocations are adjacent in memory.
+        for (std::size_t i = count; i-- > 0;) {
+            auto* slot = reinterpret_cast<FreeSlot*>(chunk + i * slot_size_);
+            slot->next = free_;
+            free_ = slot;
+        }
+        total_ += count;
+    }
+
+    std::size_t slot_size_;
+    mutable std::mutex mutex_;
+    FreeSlot* free_ = nullptr;
+    std::size_t total_ = 0;
+    std::size_t in_use_ = 0;
+};
+
+/**
+ * @brief Slab pools by slot size, shared across the process.
+ */
+class SlabPools {
+public:
+    /**
+     * @brief Gets the pool for objects of a given size, creating it on first use.
+     * @param size Object size in bytes.
+     * @return The pool; lives for the rest of the process.
+     */
+    inline SlabPool& for_size(std::size_t size) {
+        std::size_t rounded = (size + 63) & ~std::size_t{63};
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (auto& pool : pools_) {
+            if (pool->slot_size() == rounded) return *pool;
+        }
+        pools_.push_back(std::make_unique<SlabPool>(rounded));
+        return *pools_.back();
+    }
+
+    inline void collect_metrics(std::string& out) const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        out += "# TYPE haka_slab_slots_total gauge\n# TYPE haka_slab_slots_in_use gauge\n";
+        for (const auto& pool : pools_) {
+            pool->collect_metrics(out);
+        }
+        hugepage_arena().collect_metrics(out);
+    }
+
+private:
+    mutable std::mutex mutex_;
+    std::vector<std::unique_ptr<SlabPool>> pools_;
+};
+
+inline SlabPools& slab_pools() {
+    static SlabPools pools;
+    return pools;
+}
+
+/**
+ * @brief Standard allocator over the slab pools, for std::allocate_shared
+ * and containers of node-sized objects. Single-object allocations come from
+ * the pool for their size; arrays fall back to operator new.
+ */
+template <typename T>
+struct SlabAllocator {
+    using value_type = T;
+
+    SlabAllocator() = default;
+    template <typename U>
+    SlabAllocator(const SlabAllocator<U>&) noexcept {}
+
+    inline T* allocate(std::size_t n) {
+        if (n == 1 && alignof(T) <= 64) {
+            static SlabPool& pool = slab_pools().for_size(sizeof(T));
+            return static_cast<T*>(pool.allocate());
+        }
+        return static_cast<T*>(::operator new(n * sizeof(T)));
+    }
+
+    inline void deallocate(T* p, std::size_t n) noexcept {
+        if (n == 1 && alignof(T) <= 64) {
+            static SlabPool& pool = slab_pools().for_size(sizeof(T));
+            pool.deallocate(p);
+            return;
+        }
+        ::operator delete(p);
+    }
+
+    template <typename U>
+    bool operator==(const SlabAllocator<U>&) const noexcept { return true; }
+    template <typename U>
+    bool operator!=(const SlabAllocator<U>&) const noexcept { return false; }
+};
+
+} // namespace Haka
+
+#endif // HAKA_SLAB_POOL_HPP
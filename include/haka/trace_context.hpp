@@ -0,0 +1,102 @@
+#ifndef HAKA_TRACE_CONTEXT_HPP
+#define HAKA_TRACE_CONTEXT_HPP
+
+#include <array>
+#include <cstdint>
+#include <string_view>
+
+namespace Haka {
+
+/**
+ * @brief W3C trace context (https://www.w3.org/TR/trace-context/) of one
+ * request. Plain fixed-size data, so every Request can carry one without
+ * allocating.
+ */
+struct TraceContext {
+    std::array<uint8_t, 16> trace_id{};
+    std::array<uint8_t, 8> parent_id{};  // Caller's span, all zero if we started the trace
+    std::array<uint8_t, 8> span_id{};    // This server's span
+    bool sampled = false;                // Head-based decision, propagated downstream
+    bool has_parent = false;
+
+    /**
+     * @brief Parses a version-00 traceparent header value
+     * ("00-<32 hex trace id>-<16 hex parent id>-<2 hex flags>").
+     * @param value The header value.
+     * @return true if the value was valid; the context is unchanged otherwise.
+     */
+    inline bool parse(std::string_view value) {
+        // Later versions may append fields; the first 55 characters keep this layout.
+        if (value.size() < 55 || (value.size() > 55 && value[55] != '-')) return false;
+        if (value[2] != '-' || value[35] != '-' || value[52] != '-') return false;
+        uint8_t version = 0, flags = 0;
+        std::array<uint8_t, 16> trace{};
+        std::array<uint8_t, 8> parent{};
+        if (!decode_hex(value.substr(0, 2), &version, 1) || version == 0xff) return false;
+        if (version == 0 && value.size() != 55) return false;
+        if (!decode_hex(value.substr(3, 32), trace.data(), trace.size()) ||
+            !decode_hex(value.substr(36, 16), parent.data(), parent.size()) ||
+            !decode_hex(value.substr(53, 2), &flags, 1)) {
+            return false;
+        }
+        if (is_zero(trace.data(), trace.size()) || is_zero(parent.data(), parent.size())) return false;
+        trace_id = trace;
+        parent_id = parent;
+        sampled = (flags & 0x01) != 0;
+        has_parent = true;
+        return true;
+    }
+
+    /**
+     * @brief Formats the traceparent header to send to downstream services,
+     * with this server's span as the parent.
+     * @return The 55-character header value in a fixed buffer.
+     */
+    inline std::array<char, 55> traceparent() const {
+        std::array<char, 55> out{};
+        out[0] = '0'; out[1] = '0'; out[2] = '-';
+        encode_hex(trace_id.data(), trace_id.size(), out.data() + 3);
+        out[35] = '-';
+        encode_hex(span_id.data(), span_id.size(), out.data() + 36);
+        out[52] = '-';
+        out[53] = '0';
+        out[54] = sampled ? '1' : '0';
+        return out;
+    }
+
+    static inline void encode_hex(const uint8_t* data, std::size_t size, char* out) {
+        static constexpr char digits[] = "0123456789abcdef";
+        for (std::size_t i = 0; i < size; ++i) {
+            out[2 * i] = digits[data[i] >> 4];
+            out[2 * i + 1] = digits[data[i] & 0x0f];
+        }
+    }
+
+private:
+    static inline int hex_value(char c) {
+        if (c >= '0' && c <= '9') return c - '0';
+        if (c >= 'a' && c <= 'f') return c - 'a' + 10; // The spec only allows lowercase
+        return -1;
+    }
+
+    static inline bool decode_hex(std::string_view hex, uint8_t* out, std::size_t size) {
+        for (std::size_t i = 0; i < size; ++i) {
+            int hi = hex_value(hex[2 * i]);
+            int lo = hex_value(hex[2 * i + 1]);
+            if (hi < 0 || lo < 0) return false;
+            out[i] = static_cast<uint8_t>(hi << 4 | lo);
+        }
+        return true;
+    }
+
+    static inline bool is_zero(const uint8_t* data, std::size_t size) {
+        for (std::size_t i = 0; i < size; ++i) {
+            if (data[i] != 0) return false;
+        }
+        return true;
+    }
+};
+
+} // namespace Haka
+
+#endif // HAKA_TRACE_CONTEXT_HPP
@@ -0,0 +1,351 @@
+#ifndef HAKA_TRACING_HPP
+#define HAKA_TRACING_HPP
+
+// External library includes (Asio for the OTLP/HTTP exporter)
+#define ASIO_STANDALONE
+#include <asio.hpp>
+
+// Project includes
+#include "haka/core.hpp"    // For log_message, fmt
+#include "haka/metrics.hpp" // For append_metric
+#include "haka/trace_context.hpp" // For TraceContext
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <random>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+namespace Haka {
+
+/**
+ * @brief Timestamps of one request's phases, kept inline in the connection
+ * and only turned into a span if the request is sampled.
+ */
+struct RequestTimings {
+    std::chrono::system_clock::time_point start_wall; // Wall clock for the exported start time
+    std::chrono::steady_clock::time_point received;   // First bytes of the request read
+    std::chrono::steady_clock::time_point parsed;     // Request line and headers parsed
+    std::chrono::steady_clock::time_point handler_start;
+    std::chrono::steady_clock::time_point handler_end;
+    std::chrono::steady_clock::time_point sent;       // Response written
+};
+
+/**
+ * @brief Tracing settings. Pass through ServerConfig::tracing.
+ */
+struct TracingConfig {
+    bool enabled = false;
+    // Head sampling: share of new traces (no incoming traceparent) that are
+    // sampled. Requests with a traceparent follow the caller's decision.
+    double sample_ratio = 0.01;
+    // Tail sampling: unsampled requests are still exported if they failed
+    // (5xx) or took at least this long. Zero disables the latency rule.
+    bool tail_errors = true;
+    std::chrono::milliseconds tail_latency{500};
+    // Destinations; either or both may be set. OTLP/HTTP uses the JSON encoding.
+    std::string file_path;                // Appends one OTLP JSON document per batch
+    std::string otlp_host;                // e.g. "127.0.0.1"
+    unsigned short otlp_port = 4318;
+    std::string otlp_path = "/v1/traces";
+    std::string service_name = "haka";
+    std::size_t queue_capacity = 4096;    // Finished spans waiting for export; excess are dropped
+    std::size_t batch_size = 256;
+    std::chrono::milliseconds flush_interval{1000};
+};
+
+/**
+ * @brief Generates trace and span IDs from a per-thread PRNG, so ID
+ * generation needs neither a lock nor a syscall.
+ */
+inline uint64_t next_trace_random() {
+    thread_local uint64_t state = [] {
+        std::random_device rd;
+        return (static_cast<uint64_t>(rd()) << 32 | rd()) ^
+               static_cast<uint64_t>(std::chrono::steady_clock::now().time_since_epoch().count());
+    }();
+    // splitmix64
+    uint64_t z = (state += 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+/**
+ * @brief Decides which requests are traced and exports their spans in
+ * batches from a background thread. Recording a span only takes a short
+ * lock to append to a bounded queue; when the queue is full the span is
+ * dropped rather than making the io thread wait.
+ */
+class Tracer {
+public:
+    /**
+     * @brief Starts the export thread.
+     * @param config Sampling and export settings.
+     */
+    inline explicit Tracer(TracingConfig config)
+        : config_(std::move(config))
+    {
+        double ratio = std::clamp(config_.sample_ratio, 0.0, 1.0);
+        sample_threshold_ = ratio >= 1.0 ? UINT64_MAX : static_cast<uint64_t>(ratio * 18446744073709551616.0);
+        exporter_ = std::thread([this] { export_loop(); });
+        log_message("INFO", fmt::format("Tracing enabled (sample ratio {}, exporting to {}{}{})", ratio,
+                                        config_.file_path,
+                                        !config_.file_path.empty() && !config_.otlp_host.empty() ? " and " : "",
+                                        config_.otlp_host.empty() ? "" : fmt::format("http://{}:{}{}", config_.otlp_host, config_.otlp_port, config_.otlp_path)));
+    }
+
+    /**
+     * @brief Flushes the remaining spans and stops the export thread.
+     */
+    inline ~Tracer() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stopping_ = true;
+        }
+        cv_.notify_one();
+        if (exporter_.joinable()) exporter_.join();
+    }
+
+    Tracer(const Tracer&) = delete;
+    Tracer& operator=(const Tracer&) = delete;
+
+    /**
+     * @brief Sets up a request's trace context: continues the caller's
+     * trace from its traceparent header, or starts a new one, and makes the
+     * head sampling decision. Does not allocate.
+     * @param traceparent The incoming header value, possibly empty.
+     * @param trace The context to fill.
+     */
+    inline void begin(std::string_view traceparent, TraceContext& trace) const {
+        if (!traceparent.empty() && trace.parse(traceparent)) {
+            // Parent-based: follow the caller's decision.
+        } else {
+            trace = TraceContext{};
+            uint64_t hi = next_trace_random();
+            uint64_t lo = next_trace_random();
+            std::memcpy(trace.trace_id.data(), &hi, 8);
+            std::memcpy(trace.trace_id.data() + 8, &lo, 8);
+            // Ratio sampling on the trace ID, so every service sampling this trace agrees.
+            trace.sampled = lo < sample_threshold_ || sample_threshold_ == UINT64_MAX;
+        }
+        uint64_t span = next_trace_random() | 1; // Never all zero
+        std::memcpy(trace.span_id.data(), &span, 8);
+    }
+
+    /**
+     * @brief Records the request's span if it was head-sampled or matches a
+     * tail-sampling rule. Unsampled requests return without allocating.
+     * @param trace The request's trace context.
+     * @param method The request method.
+     * @param path The request path.
+     * @param status The response status code.
+     * @param timings Phase timestamps of the request.
+     */
+    inline void finish(const TraceContext& trace, const std::string& method, const std::string& path,
+                       int status, const RequestTimings& timings) {
+        auto duration = timings.sent - timings.received;
+        bool keep = trace.sampled ||
+                    (config_.tail_errors && status >= 500) ||
+                    (config_.tail_latency.count() > 0 && duration >= config_.tail_latency);
+        if (!keep) return;
+
+        Span span;
+        span.trace = trace;
+        span.name = method;
+        span.name += ' ';
+        span.name += path;
+        span.status = status;
+        span.timings = timings;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (queue_.size() >= config_.queue_capacity) {
+                dropped_.fetch_add(1, std::memory_order_relaxed);
+                return;
+            }
+            queue_.push_back(std::move(span));
+            if (queue_.size() < config_.batch_size) return;
+        }
+        cv_.notify_one();
+    }
+
+    /**
+     * @brief Appends the tracer's counters in Prometheus text format.
+     * @param out The buffer to append to.
+     */
+    inline void collect_metrics(std::string& out) const {
+        out += "# TYPE haka_tracing_spans_exported_total counter\n";
+        append_metric(out, "haka_tracing_spans_exported_total", "", exported_.load(std::memory_order_relaxed));
+        out += "# TYPE haka_tracing_spans_dropped_total counter\n";
+        append_metric(out, "haka_tracing_spans_dropped_total", "", dropped_.load(std::memory_order_relaxed));
+        out += "# TYPE haka_tracing_export_errors_total counter\n";
+        append_metric(out, "haka_tracing_export_errors_total", "", export_errors_.load(std::memory_order_relaxed));
+    }
+
+private:
+    struct Span {
+        TraceContext trace;
+        std::string name;
+        int status = 0;
+        RequestTimings timings;
+    };
+
+    inline void export_loop() {
+        std::vector<Span> batch;
+        for (;;) {
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                cv_.wait_for(lock, config_.flush_interval, [this] {
+                    return stopping_ || queue_.size() >= config_.batch_size;
+                });
+                std::size_t n = std::min(queue_.size(), config_.batch_size);
+                batch.assign(std::make_move_iterator(queue_.begin()), std::make_move_iterator(queue_.begin() + static_cast<std::ptrdiff_t>(n)));
+                queue_.erase(queue_.begin(), queue_.begin() + static_cast<std::ptrdiff_t>(n));
+                if (batch.empty() && stopping_) return;
+            }
+            if (batch.empty()) continue;
+
+            std::string payload = encode_otlp_json(batch);
+            bool ok = true;
+            if (!config_.file_path.empty()) {
+                std::ofstream file(config_.file_path, std::ios::app);
+                file << payload << '\n';
+                ok = ok && static_cast<bool>(file);
+            }
+            if (!config_.otlp_host.empty()) {
+                ok = post_otlp(payload) && ok;
+            }
+            if (ok) {
+                exported_.fetch_add(batch.size(), std::memory_order_relaxed);
+            } else {
+                export_errors_.fetch_add(1, std::memory_order_relaxed);
+                dropped_.fetch_add(batch.size(), std::memory_order_relaxed);
+            }
+            batch.clear();
+        }
+    }
+
+    static inline uint64_t unix_nanos(const RequestTimings& t, std::chrono::steady_clock::time_point at) {
+        auto offset = std::chrono::duration_cast<std::chrono::nanoseconds>(at - t.received);
+        auto wall = std::chrono::duration_cast<std::chrono::nanoseconds>(t.start_wall.time_since_epoch()) + offset;
+        return static_cast<uint64_t>(wall.count());
+    }
+
+    static inline long long micros(std::chrono::steady_clock::time_point from, std::chrono::steady_clock::time_point to) {
+        return std::chrono::duration_cast<std::chrono::microseconds>(to - from).count();
+    }
+
+    // OTLP/JSON (ExportTraceServiceRequest), one resource and scope per batch.
+    inline std::string encode_otlp_json(const std::vector<Span>& batch) const {
+        std::string out;
+        out.reserve(batch.size() * 640);
+        fmt::format_to(std::back_inserter(out),
+            R"({{"resourceSpans":[{{"resource":{{"attributes":[{{"key":"service.name","value":{{"stringValue":"{}"}}}}]}},"scopeSpans":[{{"scope":{{"name":"haka"}},"spans":[)",
+            json_escape(config_.service_name));
+        bool first = true;
+        for (const auto& span : batch) {
+            char trace_id[32], span_id[16], parent_id[16];
+            TraceContext::encode_hex(span.trace.trace_id.data(), 16, trace_id);
+            TraceContext::encode_hex(span.trace.span_id.data(), 8, span_id);
+            TraceContext::encode_hex(span.trace.parent_id.data(), 8, parent_id);
+            const RequestTimings& t = span.timings;
+            bool ran = t.handler_start != std::chrono::steady_clock::time_point{};
+
+            if (!first) out += ',';
+            first = false;
+            fmt::format_to(std::back_inserter(out),
+                R"({{"traceId":"{}","spanId":"{}",)", std::string_view(trace_id, 32), std::string_view(span_id, 16));
+            if (span.trace.has_parent) {
+                fmt::format_to(std::back_inserter(out), R"("parentSpanId":"{}",)", std::string_view(parent_id, 16));
+            }
+            fmt::format_to(std::back_inserter(out),
+                R"("name":"{}","kind":2,"startTimeUnixNano":"{}","endTimeUnixNano":"{}","attributes":[)"
+                R"({{"key":"http.response.status_code","value":{{"intValue":"{}"}}}},)"
+                R"({{"key":"haka.parse_us","value":{{"intValue":"{}"}}}},)"
+                R"({{"key":"haka.queue_us","value":{{"intValue":"{}"}}}},)"
+                R"({{"key":"haka.handler_us","value":{{"intValue":"{}"}}}},)"
+                R"({{"key":"haka.write_us","value":{{"intValue":"{}"}}}}],)"
+                R"("status":{{"code":{}}}}})",
+                json_escape(span.name), unix_nanos(t, t.received), unix_nanos(t, t.sent), span.status,
+                micros(t.received, t.parsed),
+                ran ? micros(t.parsed, t.handler_start) : 0,
+                ran ? micros(t.handler_start, t.handler_end) : 0,
+                ran ? micros(t.handler_end, t.sent) : micros(t.parsed, t.sent),
+                span.status >= 500 ? 2 : 0);
+        }
+        out += "]}]}]}";
+        return out;
+    }
+
+    static inline std::string json_escape(std::string_view in) {
+        std::string out;
+        out.reserve(in.size());
+        for (char c : in) {
+            if (c == '"' || c == '\\') {
+                out += '\\';
+                out += c;
+            } else if (static_cast<unsigned char>(c) < 0x20) {
+                fmt::format_to(std::back_inserter(out), "\\u{:04x}", static_cast<int>(c));
+            } else {
+                out += c;
+            }
+        }
+        return out;
+    }
+
+    // Blocking POST from the export thread; one connection per batch.
+    inline bool post_otlp(const std::string& payload) {
+        try {
+            asio::ip::tcp::socket socket(export_io_);
+            asio::ip::tcp::resolver resolver(export_io_);
+            asio::connect(socket, resolver.resolve(config_.otlp_host, std::to_string(config_.otlp_port)));
+            std::string head = fmt::format("POST {} HTTP/1.1\r\nHost: {}:{}\r\nContent-Type: application/json\r\n"
+                                           "Content-Length: {}\r\nConnection: close\r\n\r\n",
+                                           config_.otlp_path, config_.otlp_host, config_.otlp_port, payload.size());
+            std::array<asio::const_buffer, 2> buffers{asio::buffer(head), asio::buffer(payload)};
+            asio::write(socket, buffers);
+
+            std::string status_line;
+            asio::error_code ec;
+            char chunk[512];
+            while (status_line.find("\r\n") == std::string::npos) {
+                std::size_t n = socket.read_some(asio::buffer(chunk), ec);
+                if (ec) break;
+                status_line.append(chunk, n);
+            }
+            if (status_line.rfind("HTTP/1.1 2", 0) != 0 && status_line.rfind("HTTP/1.0 2", 0) != 0) {
+                log_message("WARN", fmt::format("OTLP export rejected: {}", status_line.substr(0, status_line.find("\r\n"))));
+                return false;
+            }
+            return true;
+        } catch (const std::exception& e) {
+            log_message("WARN", fmt::format("OTLP export to {}:{} failed: {}", config_.otlp_host, config_.otlp_port, e.what()));
+            return false;
+        }
+    }
+
+    TracingConfig config_;
+    uint64_t sample_threshold_ = 0;
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::deque<Span> queue_;
+    bool stopping_ = false;
+    std::atomic<uint64_t> exported_{0};
+    std::atomic<uint64_t> dropped_{0};
+    std::atomic<uint64_t> export_errors_{0};
+    asio::io_context export_io_;   // Only used by the export thread
+    std::thread exporter_;         // Declared last so it starts after the rest is initialized
+};
+
+} // namespace Haka
+
+#endif // HAKA_TRACING_HPP
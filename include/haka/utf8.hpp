@@ -0,0 +1,330 @@
+#ifndef HAKA_UTF8_HPP
+#define HAKA_UTF8_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define HAKA_UTF8_X86 1
+#include <immintrin.h>
+#endif
+
+namespace Haka {
+
+/**
+ * @brief Carry-over between chunks of a streamed UTF-8 check. Each kernel
+ * uses the fields it needs; the kernel is chosen once per process.
+ */
+struct Utf8State {
+    uint8_t prev[32] = {}; // Last 32 bytes seen (SIMD kernels look back up to 3)
+    uint8_t remaining = 0; // Scalar: continuation bytes still expected
+    uint8_t lower = 0x80;  // Scalar: bounds for the next continuation byte
+    uint8_t upper = 0xBF;
+    bool error = false;
+};
+
+// Validates len bytes (a multiple of 32) following whatever `state` has seen.
+using Utf8Kernel = void (*)(Utf8State& state, const uint8_t* data, std::size_t len);
+
+namespace detail {
+
+/**
+ * @brief Byte-at-a-time validator (Unicode table 3-7), for CPUs without
+ * SSSE3 and for non-x86 builds.
+ */
+inline void utf8_kernel_scalar(Utf8State& state, const uint8_t* data, std::size_t len) {
+    uint8_t remaining = state.remaining;
+    uint8_t lower = state.lower;
+    uint8_t upper = state.upper;
+    for (std::size_t i = 0; i < len; ++i) {
+        uint8_t byte = data[i];
+        if (remaining > 0) {
+            if (byte < lower || byte > upper) {
+                state.error = true;
+                return;
+            }
+            --remaining;
+            lower = 0x80;
+            upper = 0xBF;
+        } else if (byte >= 0x80) {
+            if (byte >= 0xC2 && byte <= 0xDF) {
+                remaining = 1;
+            } else if (byte >= 0xE0 && byte <= 0xEF) {
+                remaining = 2;
+                if (byte == 0xE0) lower = 0xA0;      // Overlong
+                else if (byte == 0xED) upper = 0x9F; // Surrogates
+            } else if (byte >= 0xF0 && byte <= 0xF4) {
+                remaining = 3;
+                if (byte == 0xF0) lower = 0x90;      // Overlong
+                else if (byte == 0xF4) upper = 0x8F; // Above U+10FFFF
+            } else {
+                state.error = true;
+                return;
+            }
+        }
+    }
+    state.remaining = remaining;
+    state.lower = lower;
+    state.upper = upper;
+}
+
+#if defined(HAKA_UTF8_X86)
+
+// Lookup tables for the vectorized check (Keiser & Lemire, "Validating
+// UTF-8 In Less Than One Instruction Per Byte", 2021). Each byte pair
+// (previous byte, current byte) is classified by three nibble lookups; any
+// bit left after AND-ing them is an error.
+inline constexpr uint8_t kTooShort = 1 << 0;     // 11______ 0_______ or 11______ 11______
+inline constexpr uint8_t kTooLong = 1 << 1;      // 0_______ 10______
+inline constexpr uint8_t kOverlong3 = 1 << 2;    // 11100000 100_____
+inline constexpr uint8_t kTooLarge = 1 << 3;     // 11110100 1001____ and above
+inline constexpr uint8_t kSurrogate = 1 << 4;    // 11101101 101_____
+inline constexpr uint8_t kOverlong2 = 1 << 5;    // 1100000_ 10______
+inline constexpr uint8_t kTooLarge1000 = 1 << 6; // 11110101 1000____ and above
+inline constexpr uint8_t kOverlong4 = 1 << 6;    // 11110000 1000____
+inline constexpr uint8_t kTwoConts = 1 << 7;     // 10______ 10______
+inline constexpr uint8_t kCarry = kTooShort | kTooLong | kTwoConts;
+
+alignas(16) inline constexpr uint8_t kByte1High[16] = {
+    kTooLong, kTooLong, kTooLong, kTooLong, kTooLong, kTooLong, kTooLong, kTooLong,
+    kTwoConts, kTwoConts, kTwoConts, kTwoConts,
+    kTooShort | kOverlong2,
+    kTooShort,
+    kTooShort | kOverlong3 | kSurrogate,
+    kTooShort | kTooLarge | kTooLarge1000 | kOverlong4};
+
+alignas(16) inline constexpr uint8_t kByte1Low[16] = {
+    kCarry | kOverlong3 | kOverlong2 | kOverlong4,
+    kCarry | kOverlong2,
+    kCarry,
+    kCarry,
+    kCarry | kTooLarge,
+    kCarry | kTooLarge | kTooLarge1000,
+    kCarry | kTooLarge | kTooLarge1000,
+    kCarry | kTooLarge | kTooLarge1000,
+    kCarry | kTooLarge | kTooLarge1000,
+    kCarry | kTooLarge | kTooLarge1000,
+    kCarry | kTooLarge | kTooLarge1000,
+    kCarry | kTooLarge | kTooLarge1000,
+    kCarry | kTooLarge | kTooLarge1000,
+    kCarry | kTooLarge | kTooLarge1000 | kSurrogate,
+    kCarry | kTooLarge | kTooLarge1000,
+    kCarry | kTooLarge | kTooLarge1000};
+
+alignas(16) inline constexpr uint8_t kByte2High[16] = {
+    kTooShort, kTooShort, kTooShort, kTooShort, kTooShort, kTooShort, kTooShort, kTooShort,
+    kTooLong | kOverlong2 | kTwoConts | kOverlong3 | kTooLarge1000 | kOverlong4,
+    kTooLong | kOverlong2 | kTwoConts | kOverlong3 | kTooLarge,
+    kTooLong | kOverlong2 | kTwoConts | kSurrogate | kTooLarge,
+    kTooLong | kOverlong2 | kTwoConts | kSurrogate | kTooLarge,
+    kTooShort, kTooShort, kTooShort, kTooShort};
+
+// A block ending in these (per position from the end) leaves a sequence open.
+alignas(16) inline constexpr uint8_t kIncompleteMax[16] = {
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xEF, 0xDF, 0xBF};
+
+__attribute__((target("ssse3")))
+inline __m128i utf8_block_errors_ssse3(__m128i input, __m128i prev_input) {
+    const __m128i low_nibble = _mm_set1_epi8(0x0F);
+    __m128i prev1 = _mm_alignr_epi8(input, prev_input, 15);
+    __m128i byte_1_high = _mm_shuffle_epi8(_mm_load_si128(reinterpret_cast<const __m128i*>(kByte1High)),
+                                           _mm_and_si128(_mm_srli_epi16(prev1, 4), low_nibble));
+    __m128i byte_1_low = _mm_shuffle_epi8(_mm_load_si128(reinterpret_cast<const __m128i*>(kByte1Low)),
+                                          _mm_and_si128(prev1, low_nibble));
+    __m128i byte_2_high = _mm_shuffle_epi8(_mm_load_si128(reinterpret_cast<const __m128i*>(kByte2High)),
+                                           _mm_and_si128(_mm_srli_epi16(input, 4), low_nibble));
+    __m128i special = _mm_and_si128(_mm_and_si128(byte_1_high, byte_1_low), byte_2_high);
+
+    // Third and fourth bytes of 3- and 4-byte sequences must be continuations.
+    __m128i prev2 = _mm_alignr_epi8(input, prev_input, 14);
+    __m128i prev3 = _mm_alignr_epi8(input, prev_input, 13);
+    __m128i is_third = _mm_subs_epu8(prev2, _mm_set1_epi8(static_cast<char>(0xE0 - 0x80)));
+    __m128i is_fourth = _mm_subs_epu8(prev3, _mm_set1_epi8(static_cast<char>(0xF0 - 0x80)));
+    __m128i must23 = _mm_and_si128(_mm_or_si128(is_third, is_fourth), _mm_set1_epi8(static_cast<char>(0x80)));
+    return _mm_xor_si128(must23, special);
+}
+
+__attribute__((target("ssse3")))
+inline void utf8_kernel_ssse3(Utf8State& state, const uint8_t* data, std::size_t len) {
+    const __m128i incomplete_max = _mm_load_si128(reinterpret_cast<const __m128i*>(kIncompleteMax));
+    __m128i prev = _mm_loadu_si128(reinterpret_cast<const __m128i*>(state.prev + 16));
+    __m128i prev_incomplete = _mm_subs_epu8(prev, incomplete_max);
+    __m128i error = _mm_setzero_si128();
+    for (std::size_t i = 0; i < len; i += 16) {
+        __m128i input = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+        if (_mm_movemask_epi8(input) == 0) {
+            error = _mm_or_si128(error, prev_incomplete); // ASCII: nothing may be left open
+        } else {
+            error = _mm_or_si128(error, utf8_block_errors_ssse3(input, prev));
+            prev_incomplete = _mm_subs_epu8(input, incomplete_max);
+        }
+        prev = input;
+    }
+    if (_mm_movemask_epi8(_mm_cmpeq_epi8(error, _mm_setzero_si128())) != 0xFFFF) state.error = true;
+    std::memcpy(state.prev, data + len - 32, 32);
+}
+
+__attribute__((target("avx2")))
+inline __m256i utf8_prev_avx2(__m256i input, __m256i prev_input, int n) {
+    // Bytes shifted in across the 128-bit lane boundary.
+    __m256i straddle = _mm256_permute2x128_si256(prev_input, input, 0x21);
+    switch (n) {
+        case 1: return _mm256_alignr_epi8(input, straddle, 15);
+        case 2: return _mm256_alignr_epi8(input, straddle, 14);
+        default: return _mm256_alignr_epi8(input, straddle, 13);
+    }
+}
+
+__attribute__((target("avx2")))
+inline __m256i utf8_table_avx2(const uint8_t* table) {
+    return _mm256_broadcastsi128_si256(_mm_load_si128(reinterpret_cast<const __m128i*>(table)));
+}
+
+__attribute__((target("avx2")))
+inline __m256i utf8_block_errors_avx2(__m256i input, __m256i prev_input) {
+    const __m256i low_nibble = _mm256_set1_epi8(0x0F);
+    __m256i prev1 = utf8_prev_avx2(input, prev_input, 1);
+    __m256i byte_1_high = _mm256_shuffle_epi8(utf8_table_avx2(kByte1High), _mm256_and_si256(_mm256_srli_epi16(prev1, 4), low_nibble));
+    __m256i byte_1_low = _mm256_shuffle_epi8(utf8_table_avx2(kByte1Low), _mm256_and_si256(prev1, low_nibble));
+    __m256i byte_2_high = _mm256_shuffle_epi8(utf8_table_avx2(kByte2High), _mm256_and_si256(_mm256_srli_epi16(input, 4), low_nibble));
+    __m256i special = _mm256_and_si256(_mm256_and_si256(byte_1_high, byte_1_low), byte_2_high);
+
+    __m256i prev2 = utf8_prev_avx2(input, prev_input, 2);
+    __m256i prev3 = utf8_prev_avx2(input, prev_input, 3);
+    __m256i is_third = _mm256_subs_epu8(prev2, _mm256_set1_epi8(static_cast<char>(0xE0 - 0x80)));
+    __m256i is_fourth = _mm256_subs_epu8(prev3, _mm256_set1_epi8(static_cast<char>(0xF0 - 0x80)));
+    __m256i must23 = _mm256_and_si256(_mm256_or_si256(is_third, is_fourth), _mm256_set1_epi8(static_cast<char>(0x80)));
+    return _mm256_xor_si256(must23, special);
+}
+
+__attribute__((target("avx2")))
+inline void utf8_kernel_avx2(Utf8State& state, const uint8_t* data, std::size_t len) {
+    const __m256i incomplete_max = _mm256_inserti128_si256(
+        _mm256_set1_epi8(static_cast<char>(0xFF)), _mm_load_si128(reinterpret_cast<const __m128i*>(kIncompleteMax)), 1);
+    __m256i prev = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(state.prev));
+    __m256i prev_incomplete = _mm256_subs_epu8(prev, incomplete_max);
+    __m256i error = _mm256_setzero_si256();
+    for (std::size_t i = 0; i < len; i += 32) {
+        __m256i input = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+        if (_mm256_movemask_epi8(input) == 0) {
+            error = _mm256_or_si256(error, prev_incomplete);
+        } else {
+            error = _mm256_or_si256(error, utf8_block_errors_avx2(input, prev));
+            prev_incomplete = _mm256_subs_epu8(input, incomplete_max);
+        }
+        prev = input;
+    }
+    if (!_mm256_testz_si256(error, error)) state.error = true;
+    std::memcpy(state.prev, data + len - 32, 32);
+}
+
+#endif // HAKA_UTF8_X86
+
+} // namespace detail
+
+/**
+ * @brief The fastest kernel this CPU supports: AVX2, then SSSE3, then
+ * scalar. Chosen once, on first use.
+ */
+inline Utf8Kernel utf8_kernel() {
+    static const Utf8Kernel kernel = [] {
+#if defined(HAKA_UTF8_X86)
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2")) return &detail::utf8_kernel_avx2;
+        if (__builtin_cpu_supports("ssse3")) return &detail::utf8_kernel_ssse3;
+#endif
+        return &detail::utf8_kernel_scalar;
+    }();
+    return kernel;
+}
+
+inline const char* utf8_kernel_name() {
+#if defined(HAKA_UTF8_X86)
+    if (utf8_kernel() == &detail::utf8_kernel_avx2) return "avx2";
+    if (utf8_kernel() == &detail::utf8_kernel_ssse3) return "ssse3";
+#endif
+    return "scalar";
+}
+
+/**
+ * @brief Checks UTF-8 incrementally as data arrives, so a body can be
+ * validated chunk by chunk while it is still in cache. Sequences may be
+ * split across chunks. At most 31 bytes are buffered between calls.
+ */
+class Utf8Validator {
+public:
+    /**
+     * @brief Checks the next chunk.
+     * @return false once any invalid byte has been seen.
+     */
+    inline bool update(const char* data, std::size_t size) {
+        if (state_.error) return false;
+        auto* bytes = reinterpret_cast<const uint8_t*>(data);
+        if (pending_size_ > 0) {
+            std::size_t take = std::min(size, sizeof(pending_) - pending_size_);
+            std::memcpy(pending_ + pending_size_, bytes, take);
+            pending_size_ += take;
+            bytes += take;
+            size -= take;
+            if (pending_size_ < sizeof(pending_)) return true;
+            kernel_(state_, pending_, sizeof(pending_));
+            pending_size_ = 0;
+        }
+        std::size_t blocks = size & ~std::size_t{31};
+        if (blocks > 0) kernel_(state_, bytes, blocks);
+        std::memcpy(pending_, bytes + blocks, size - blocks);
+        pending_size_ = size - blocks;
+        return !state_.error;
+    }
+
+    /**
+     * @brief Checks the buffered tail.
+     * @return true if everything seen was valid and no sequence is left open.
+     */
+    inline bool finish() {
+        if (state_.error) return false;
+        // Zero padding is ASCII, so a sequence cut off at the end shows up as too short.
+        std::memset(pending_ + pending_size_, 0, sizeof(pending_) - pending_size_);
+        kernel_(state_, pending_, sizeof(pending_));
+        pending_size_ = 0;
+        return !state_.error;
+    }
+
+    inline bool valid() const { return !state_.error; }
+
+    inline void reset() {
+        state_ = Utf8State{};
+        pending_size_ = 0;
+    }
+
+private:
+    Utf8Kernel kernel_ = utf8_kernel();
+    Utf8State state_;
+    uint8_t pending_[32];
+    std::size_t pending_size_ = 0;
+};
+
+/**
+ * @brief Checks that a complete buffer is well-formed UTF-8.
+ * @param text The bytes.
+ * @return true if valid (an empty buffer is).
+ */
+inline bool validate_utf8(std::string_view text) {
+    // Short ASCII text (most paths) never reaches a kernel.
+    if (text.size() < 32) {
+        bool ascii = true;
+        for (char c : text) ascii &= static_cast<unsigned char>(c) < 0x80;
+        if (ascii) return true;
+    }
+    Utf8Validator validator;
+    validator.update(text.data(), text.size());
+    return validator.finish();
+}
+
+} // namespace Haka
+
+#endif // HAKA_UTF8_HPP
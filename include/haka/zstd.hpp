@@ -0,0 +1,352 @@
+#ifndef HAKA_ZSTD_HPP
+#define HAKA_ZSTD_HPP
+
+#if defined(HAKA_ENABLE_ZSTD)
+
+// Project includes
+#include "haka/core.hpp"    // For Request, Response, log_message
+#include "haka/metrics.hpp" // For append_metric
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cctype>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <zdict.h>
+#include <zstd.h>
+
+namespace Haka {
+
+namespace detail {
+
+/**
+ * @brief SHA-256 (FIPS 180-4). Only used to name dictionaries, once each, so
+ * it is written for clarity rather than speed.
+ */
+inline std::array<uint8_t, 32> sha256(std::string_view data) {
+    static constexpr uint32_t k[64] = {
+        0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+        0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+        0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+        0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+        0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+        0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+        0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+        0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2};
+    uint32_t h[8] = {0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19};
+    auto rotr = [](uint32_t x, int n) { return (x >> n) | (x << (32 - n)); };
+
+    std::string message(data);
+    uint64_t bits = static_cast<uint64_t>(data.size()) * 8;
+    message += static_cast<char>(0x80);
+    while (message.size() % 64 != 56) message += '\0';
+    for (int i = 7; i >= 0; --i) message += static_cast<char>(bits >> (i * 8));
+
+    for (std::size_t block = 0; block < message.size(); block += 64) {
+        uint32_t w[64];
+        for (int i = 0; i < 16; ++i) {
+            const auto* p = reinterpret_cast<const unsigned char*>(message.data() + block + i * 4);
+            w[i] = (uint32_t(p[0]) << 24) | (uint32_t(p[1]) << 16) | (uint32_t(p[2]) << 8) | p[3];
+        }
+        for (int i = 16; i < 64; ++i) {
+            uint32_t s0 = rotr(w[i - 15], 7) ^ rotr(w[i - 15], 18) ^ (w[i - 15] >> 3);
+            uint32_t s1 = rotr(w[i - 2], 17) ^ rotr(w[i - 2], 19) ^ (w[i - 2] >> 10);
+            w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+        }
+        uint32_t a = h[0], b = h[1], c = h[2], d = h[3], e = h[4], f = h[5], g = h[6], hh = h[7];
+        for (int i = 0; i < 64; ++i) {
+            uint32_t t1 = hh + (rotr(e, 6) ^ rotr(e, 11) ^ rotr(e, 25)) + ((e & f) ^ (~e & g)) + k[i] + w[i];
+            uint32_t t2 = (rotr(a, 2) ^ rotr(a, 13) ^ rotr(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+            hh = g;
+            g = f;
+            f = e;
+            e = d + t1;
+            d = c;
+            c = b;
+            b = a;
+            a = t1 + t2;
+        }
+        h[0] += a;
+        h[1] += b;
+        h[2] += c;
+        h[3] += d;
+        h[4] += e;
+        h[5] += f;
+        h[6] += g;
+        h[7] += hh;
+    }
+    std::array<uint8_t, 32> digest{};
+    for (int i = 0; i < 8; ++i) {
+        for (int j = 0; j < 4; ++j) digest[i * 4 + j] = static_cast<uint8_t>(h[i] >> (24 - j * 8));
+    }
+    return digest;
+}
+
+inline std::string base64_encode(const uint8_t* data, std::size_t size) {
+    static constexpr char alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    std::string out;
+    out.reserve((size + 2) / 3 * 4);
+    for (std::size_t i = 0; i < size; i += 3) {
+        uint32_t n = uint32_t(data[i]) << 16;
+        if (i + 1 < size) n |= uint32_t(data[i + 1]) << 8;
+        if (i + 2 < size) n |= data[i + 2];
+        out += alphabet[(n >> 18) & 63];
+        out += alphabet[(n >> 12) & 63];
+        out += i + 1 < size ? alphabet[(n >> 6) & 63] : '=';
+        out += i + 2 < size ? alphabet[n & 63] : '=';
+    }
+    return out;
+}
+
+/**
+ * @brief Checks whether an Accept-Encoding value allows `coding` (listed
+ * without q=0). "*" is not honoured: dictionary codings must be named.
+ */
+inline bool accepts_coding(std::string_view accept_encoding, std::string_view coding) {
+    auto trim = [](std::string_view s) {
+        while (!s.empty() && (s.front() == ' ' || s.front() == '\t')) s.remove_prefix(1);
+        while (!s.empty() && (s.back() == ' ' || s.back() == '\t')) s.remove_suffix(1);
+        return s;
+    };
+    while (!accept_encoding.empty()) {
+        std::size_t comma = accept_encoding.find(',');
+        std::string_view item = accept_encoding.substr(0, comma);
+        accept_encoding = comma == std::string_view::npos ? std::string_view() : accept_encoding.substr(comma + 1);
+        std::size_t semicolon = item.find(';');
+        std::string_view name = trim(item.substr(0, semicolon));
+        if (name.size() != coding.size() ||
+            !std::equal(name.begin(), name.end(), coding.begin(), [](char a, char b) {
+                return std::tolower(static_cast<unsigned char>(a)) == b;
+            })) {
+            continue;
+        }
+        if (semicolon == std::string_view::npos) return true;
+        std::string_view q = trim(item.substr(semicolon + 1));
+        // "q=0", "q=0.0", "q=0.000" refuse the coding.
+        return !(q.size() >= 3 && (q[0] == 'q' || q[0] == 'Q') && q[1] == '=' &&
+                 q.substr(2).find_first_not_of("0.") == std::string_view::npos);
+    }
+    return false;
+}
+
+struct ZstdContextDeleter {
+    inline void operator()(ZSTD_CCtx* context) const { ZSTD_freeCCtx(context); }
+};
+
+/**
+ * @brief The calling thread's compression context. Contexts keep their
+ * tables between calls, so reusing one avoids setting up about 1 MiB of
+ * state per response.
+ */
+inline ZSTD_CCtx* thread_zstd_context() {
+    thread_local std::unique_ptr<ZSTD_CCtx, ZstdContextDeleter> context(ZSTD_createCCtx());
+    return context.get();
+}
+
+} // namespace detail
+
+/**
+ * @brief Settings for a ZstdDictionary.
+ */
+struct ZstdDictionaryOptions {
+    // Path the dictionary is served at (Server::serve_dictionary) and
+    // advertised with in a Link header, e.g., "/dictionaries/products".
+    std::string url;
+    // URL pattern clients may use the dictionary for, sent as
+    // Use-As-Dictionary: match="..." (e.g., "/json" or "/api/products/*").
+    std::string match;
+    // Optional Dictionary-ID clients echo back.
+    std::string id;
+    // zstd compression level.
+    int level = 3;
+    // Smaller bodies are sent as they are.
+    std::size_t min_size = 32;
+};
+
+/**
+ * @brief A zstd dictionary for compressing a route's responses, negotiated
+ * per request with Compression Dictionary Transport (RFC 9842) headers.
+ *
+ * The dictionary is served at options.url with a Use-As-Dictionary header.
+ * Responses of routes using it carry a Link header pointing there until the
+ * client shows it has the dictionary. A client that fetched it sends
+ * `Available-Dictionary: :<base64 SHA-256>:` with `Accept-Encoding: dcz`,
+ * and the body is compressed against the dictionary (Content-Encoding: dcz).
+ * Clients accepting only `zstd` get plain zstd. Small, repetitive JSON
+ * documents share most of their bytes with a dictionary trained on earlier
+ * ones (see tools/haka_dict.cpp), so they shrink far more than they do
+ * under gzip or plain zstd.
+ *
+ * The dictionary is digested into a zstd CDict once; compression uses a
+ * context reused per thread. It is applied on the handler thread after the
+ * handler returns (see invoke_route).
+ */
+class ZstdDictionary {
+public:
+    /**
+     * @brief Loads a dictionary file (e.g., one written by haka_dict).
+     * @throws std::runtime_error if the file cannot be read or used.
+     */
+    static inline std::shared_ptr<const ZstdDictionary> load(const std::string& path, ZstdDictionaryOptions options) {
+        std::ifstream file(path, std::ios::binary);
+        if (!file) throw std::runtime_error("Cannot open zstd dictionary " + path);
+        std::string bytes{std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>()};
+        return std::make_shared<const ZstdDictionary>(std::move(bytes), std::move(options));
+    }
+
+    /**
+     * @param bytes The dictionary. Used as raw content, as RFC 9842 requires
+     * for dcz: any bytes work, a trained one (haka_dict) works best. A
+     * zstd-format dictionary has its header stripped first.
+     * @param options URL, match pattern and compression level.
+     * @throws std::invalid_argument for an empty dictionary or missing url/match.
+     * @throws std::runtime_error if zstd cannot load it.
+     */
+    inline ZstdDictionary(std::string bytes, ZstdDictionaryOptions options) : bytes_(std::move(bytes)), options_(std::move(options)) {
+        if (bytes_.size() >= 8 && ZDICT_getDictID(bytes_.data(), bytes_.size()) != 0) {
+            // A dictionary straight from `zstd --train`: dcz uses dictionaries as
+            // raw content, so keep only the content after its entropy tables.
+            std::size_t header = ZDICT_getDictHeaderSize(bytes_.data(), bytes_.size());
+            if (ZDICT_isError(header)) throw std::runtime_error("Malformed zstd dictionary header");
+            bytes_.erase(0, header);
+        }
+        if (bytes_.empty()) throw std::invalid_argument("zstd dictionary is empty");
+        if (options_.url.empty() || options_.match.empty()) {
+            throw std::invalid_argument("zstd dictionary needs a url and a match pattern");
+        }
+        std::array<uint8_t, 32> digest = detail::sha256(bytes_);
+        std::memcpy(frame_header_.data() + 8, digest.data(), digest.size());
+        available_ = ":" + detail::base64_encode(digest.data(), digest.size()) + ":";
+        use_as_dictionary_ = "match=\"" + options_.match + "\"";
+        if (!options_.id.empty()) use_as_dictionary_ += ", id=\"" + options_.id + "\"";
+        link_ = "<" + options_.url + ">; rel=\"compression-dictionary\"";
+        labels_ = "dictionary=\"" + (options_.id.empty() ? options_.url : options_.id) + "\"";
+
+        // zstd loads bytes without its dictionary magic as raw content.
+        cdict_ = ZSTD_createCDict(bytes_.data(), bytes_.size(), options_.level);
+        if (!cdict_) throw std::runtime_error("zstd could not load the dictionary");
+        log_message("INFO", fmt::format("zstd dictionary {} loaded: {} bytes, {}", options_.url, bytes_.size(), available_));
+    }
+
+    inline ~ZstdDictionary() { ZSTD_freeCDict(cdict_); }
+
+    ZstdDictionary(const ZstdDictionary&) = delete;
+    ZstdDictionary& operator=(const ZstdDictionary&) = delete;
+
+    inline const std::string& bytes() const { return bytes_; }
+    inline const ZstdDictionaryOptions& options() const { return options_; }
+    // The Available-Dictionary value of clients holding this dictionary.
+    inline const std::string& available_dictionary() const { return available_; }
+    // The Use-As-Dictionary header value the dictionary is served with.
+    inline const std::string& use_as_dictionary() const { return use_as_dictionary_; }
+
+    /**
+     * @brief Compresses a successful response for the client, if it accepts
+     * dcz with this dictionary (or plain zstd), and adds Vary and the Link
+     * advertisement. Leaves the body alone if compression would not shrink it.
+     * @param req The request, for its Accept-Encoding and Available-Dictionary.
+     * @param res The response the handler produced.
+     */
+    inline void encode(const Request& req, Response& res) const {
+        if (res.status_code < 200 || res.status_code >= 300 || res.status_code == 204) return;
+        if (res.headers.count("Content-Encoding")) return; // The handler encoded it itself
+        append_header(res, "Vary", "Accept-Encoding, Available-Dictionary");
+
+        std::string_view accept = req.header("Accept-Encoding");
+        std::string_view available = req.header("Available-Dictionary");
+        while (!available.empty() && available.back() == ' ') available.remove_suffix(1);
+        bool dictionary = available == available_ && detail::accepts_coding(accept, "dcz");
+        if (!dictionary) append_header(res, "Link", link_);
+        if (res.body.size() < options_.min_size) {
+            responses_[2].fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        bool plain = !dictionary && detail::accepts_coding(accept, "zstd");
+        if (!dictionary && !plain) {
+            responses_[2].fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+
+        std::size_t prefix = dictionary ? frame_header_.size() : 0;
+        std::string encoded(prefix + ZSTD_compressBound(res.body.size()), '\0');
+        std::memcpy(encoded.data(), frame_header_.data(), prefix);
+        ZSTD_CCtx* context = detail::thread_zstd_context();
+        std::size_t size = dictionary
+            ? ZSTD_compress_usingCDict(context, encoded.data() + prefix, encoded.size() - prefix, res.body.data(), res.body.size(), cdict_)
+            : ZSTD_compressCCtx(context, encoded.data(), encoded.size(), res.body.data(), res.body.size(), options_.level);
+        if (ZSTD_isError(size)) {
+            log_message("ERROR", fmt::format("zstd compression failed: {}", ZSTD_getErrorName(size)));
+            responses_[2].fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        encoded.resize(prefix + size);
+        if (encoded.size() >= res.body.size()) {
+            responses_[2].fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        responses_[dictionary ? 0 : 1].fetch_add(1, std::memory_order_relaxed);
+        bytes_in_.fetch_add(res.body.size(), std::memory_order_relaxed);
+        bytes_out_.fetch_add(encoded.size(), std::memory_order_relaxed);
+        res.headers["Content-Encoding"] = dictionary ? "dcz" : "zstd";
+        res.body = std::move(encoded);
+    }
+
+    /**
+     * @brief Appends per-dictionary counters in Prometheus text format.
+     * @param out The buffer to append to.
+     * @param dictionaries The dictionaries to report.
+     */
+    static inline void collect_metrics(std::string& out, const std::vector<std::shared_ptr<const ZstdDictionary>>& dictionaries) {
+        if (dictionaries.empty()) return;
+        static constexpr const char* encodings[] = {"dcz", "zstd", "identity"};
+        out += "# TYPE haka_zstd_responses_total counter\n";
+        for (const auto& dictionary : dictionaries) {
+            for (int i = 0; i < 3; ++i) {
+                append_metric(out, "haka_zstd_responses_total", dictionary->labels_ + ",encoding=\"" + encodings[i] + "\"",
+                              dictionary->responses_[i].load(std::memory_order_relaxed));
+            }
+        }
+        out += "# TYPE haka_zstd_uncompressed_bytes_total counter\n";
+        for (const auto& dictionary : dictionaries) {
+            append_metric(out, "haka_zstd_uncompressed_bytes_total", dictionary->labels_, dictionary->bytes_in_.load(std::memory_order_relaxed));
+        }
+        out += "# TYPE haka_zstd_compressed_bytes_total counter\n";
+        for (const auto& dictionary : dictionaries) {
+            append_metric(out, "haka_zstd_compressed_bytes_total", dictionary->labels_, dictionary->bytes_out_.load(std::memory_order_relaxed));
+        }
+    }
+
+private:
+    static inline void append_header(Response& res, const std::string& name, const std::string& value) {
+        std::string& existing = res.headers[name];
+        existing = existing.empty() ? value : existing + ", " + value;
+    }
+
+    std::string bytes_;
+    ZstdDictionaryOptions options_;
+    ZSTD_CDict* cdict_ = nullptr;
+    // dcz bodies start with this magic and the dictionary's SHA-256 (RFC 9842).
+    std::array<char, 40> frame_header_{'\x5e', '\x2a', '\x4d', '\x18', '\x20', '\x00', '\x00', '\x00'};
+    std::string available_;
+    std::string use_as_dictionary_;
+    std::string link_;
+    std::string labels_;
+    mutable std::array<std::atomic<uint64_t>, 3> responses_{}; // dcz, zstd, identity
+    mutable std::atomic<uint64_t> bytes_in_{0};
+    mutable std::atomic<uint64_t> bytes_out_{0};
+};
+
+} // namespace Haka
+
+#endif // HAKA_ENABLE_ZSTD
+
+#endif // HAKA_ZSTD_HPP
@@ -5,6 +5,11 @@
 #include <string> // Needed for string manipulation
 #include <chrono> // Needed for random seed
 #include <cmath> // Needed for std::round
+#include <thread> // Needed for std::this_thread::sleep_for
+#include <csignal> // Needed for SIGINT/SIGTERM
+#include <functional> // Needed for the re-armed signal handler
+#include <fstream> // Needed for reading the JWT public key
+#include <sstream> // Needed for reading the JWT public key
 
 struct Product {
     int id;
@@ -53,10 +58,26 @@ int main(int argc, char* argv[]) { // Added command-line arguments
 
     // Define the host and port for the server to listen on.
     std::string host = "127.0.0.1"; // Listen only on localhost
-    unsigned short port = 8080;     // Listen on port 8080
+    unsigned short port = 8080;     // Listen on port 8080 unless -port is given
+
+    for (int i = 1; i + 1 < argc; ++i) {
+        if (std::string(argv[i]) == "-port") {
+            port = static_cast<unsigned short>(std::stoi(argv[i + 1]));
+        }
+    }
+
+    // -trace <file> exports sampled request spans (OTLP JSON) to a file.
+    Haka::ServerConfig config;
+    config.health_path = "/healthz"; // Answered by the server itself, before routing
+    for (int i = 1; i + 1 < argc; ++i) {
+        if (std::string(argv[i]) == "-trace") {
+            config.tracing.enabled = true;
+            config.tracing.file_path = argv[i + 1];
+        }
+    }
 
     // Create a Haka server instance.
-    Haka::Server server(host, port);
+    Haka::Server server(host, port, config);
 
     // --- Define Basic Routes Directly on the Server ---
 
@@ -129,7 +150,18 @@ int main(int argc, char* argv[]) { // Added command-line arguments
 
 
     // --- New Route: /json ---
-    // GET route returning a vector of 15 Product objects as JSON.
+    // GET route returning a vector of 15 Product objects as JSON. With
+    // -zstd-dict <file> (a dictionary trained by haka_dict), the dictionary is
+    // served at /dictionaries/json and clients that have it get dcz responses.
+    Haka::RouteOptions json_options;
+#if defined(HAKA_ENABLE_ZSTD)
+    for (int i = 1; i + 1 < argc; ++i) {
+        if (std::string(argv[i]) == "-zstd-dict") {
+            json_options.dictionary = Haka::ZstdDictionary::load(argv[i + 1], {.url = "/dictionaries/json", .match = "/json", .id = "json"});
+            server.serve_dictionary(json_options.dictionary);
+        }
+    }
+#endif
     server.Get("/json", [](const Haka::Request& req, Haka::Response& res) {
         std::vector<Product> products;
         products.reserve(15); // Reserve space for 15 products
@@ -144,13 +176,113 @@ int main(int argc, char* argv[]) { // Added command-line arguments
 
         res.status_code = 200; // OK
         res.JSON(products); // Serialize and send the vector as a JSON array
+    }, json_options);
+
+
+    // --- New Route: /echo ---
+    // POST route returning the request body, which must be valid UTF-8. With
+    // -mirror <port>, copies of these requests also go to a second Haka on
+    // that port (shadow testing).
+    Haka::RouteOptions echo_options;
+    echo_options.validate_utf8 = true;
+    for (int i = 1; i + 1 < argc; ++i) {
+        if (std::string(argv[i]) == "-mirror") {
+            server.addMirror("shadow", host, static_cast<unsigned short>(std::stoi(argv[i + 1])));
+            echo_options.mirror = "shadow";
+        }
+    }
+    server.Post("/echo", [](const Haka::Request& req, Haka::Response& res) {
+        res.Text(req.body);
+    }, echo_options);
+
+
+    // --- New Route: /slow ---
+    // GET route that takes longer than its 2 second timeout. The client gets a 504
+    // and the handler notices through the request's stop token and bails out.
+    server.Get("/slow", [](const Haka::Request& req, Haka::Response& res) {
+        for (int i = 0; i < 50 && !req.cancelled(); ++i) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        }
+        res.Text("Finished slow work.");
+    }, {.timeout = std::chrono::seconds(2)});
+
+
+#if defined(HAKA_ENABLE_JWT)
+    // --- Route: /me (JWT protected) ---
+    // With -jwt <public.pem>, GET /me requires "Authorization: Bearer <token>"
+    // signed by that key (RS256 for RSA keys, ES256 for P-256 keys) and
+    // returns the token's subject. Verified tokens are cached until they expire.
+    for (int i = 1; i + 1 < argc; ++i) {
+        if (std::string(argv[i]) == "-jwt") {
+            std::ifstream key_file(argv[i + 1]);
+            std::stringstream pem;
+            pem << key_file.rdbuf();
+            auto verifier = std::make_shared<Haka::JwtVerifier>();
+            verifier->add_key("", pem.str());
+            server.metrics().add_collector("jwt", [verifier](std::string& out) { verifier->collect_metrics(out); });
+            server.Get("/me", [](const Haka::Request& req, Haka::Response& res) {
+                res.Text(fmt::format("Hello, {}!", req.claims->subject()));
+            }, {.filters = {Haka::jwt_bearer(verifier)}});
+        }
+    }
+#endif
+
+
+    // --- New Route: /visits ---
+    // GET route counting the caller's visits in their session (cookie "haka_sid").
+    // With -sessions <file>, sessions are saved there on shutdown and restored
+    // on the next start.
+    Haka::SessionConfig session_config;
+    for (int i = 1; i + 1 < argc; ++i) {
+        if (std::string(argv[i]) == "-sessions") {
+            session_config.snapshot_path = argv[i + 1];
+        }
+    }
+    server.sessions(session_config);
+    server.Get("/visits", [](const Haka::Request& req, Haka::Response& res) {
+        Haka::Session& session = req.session();
+        int visits = std::stoi(session.get("visits").value_or("0")) + 1;
+        session.set("visits", std::to_string(visits));
+        res.Text(fmt::format("Visit {} in session {}", visits, session.is_new() ? "(new)" : "(resumed)"));
+    });
+
+
+    // --- New Route: /announce ---
+    // POST route that publishes its body on the in-process bus. The handler
+    // runs on a worker thread; the subscriber below runs on the io thread.
+    server.bus().subscribe("announcements", server.get_io_context().get_executor(), [](const Haka::BusMessage& message) {
+        Haka::log_message("INFO", fmt::format("Announcement: {}", message.payload));
+    }).release();
+    server.Post("/announce", [&server](const Haka::Request& req, Haka::Response& res) {
+        std::size_t executors = server.bus().publish("announcements", req.body);
+        res.Text(fmt::format("Published to {} executor(s).", executors));
     });
 
 
+    // --- Periodic Tasks ---
+    // Background job on the worker pool every 30 seconds (with up to 10%
+    // jitter). Per-task runtimes show up under haka_periodic_* in /metrics.
+    server.every(std::chrono::seconds(30), [] {
+        Haka::log_message("DEBUG", "Refreshing reference data");
+    }, {.name = "refresh_reference_data", .on_workers = true});
+
+
+    // --- Health and Metrics ---
+    // /healthz is served by the health fast path (ServerConfig::health_path);
+    // it reports 503 while draining or shedding load.
+
+    // Prometheus scrape endpoint with per-priority-class scheduler metrics.
+    server.serveMetrics("/metrics");
+
+
     // --- Mount Modular Router for User API ---
     // Call the function from users.cpp to create and configure the user API router instance.
     Haka::Router user_api_router = createUserApiRouter();
 
+    // Let a browser front end on another origin call the user API. Preflights
+    // are answered from buffers built here.
+    user_api_router.cors({.allow_origins = {"http://localhost:3000"}});
+
     // Mount the user API router under the "/api/users" prefix on the main server's router.
     // Routes defined in user_api_router (like "/list", "/profile") will now be accessible
     // under this prefix (e.g., "/api/users/list", "/api/users/profile").
@@ -167,10 +299,58 @@ int main(int argc, char* argv[]) { // Added command-line arguments
     // and put files like index.html, style.css, etc. inside it.
     // For example, "./public/index.html" will be accessible at "http://127.0.0.1:8080/static/index.html".
     server.serveStatic("/static", "./public");
+#if !defined(_WIN32)
+    // Keep hot files open and remember missing ones, re-checking each path at
+    // most every 10 seconds.
+    server.open_file_cache({.max_entries = 1000, .valid = std::chrono::seconds(10)});
+#endif
+
+
+#if defined(HAKA_ENABLE_HTTP3) && defined(__linux__)
+    // --- Optional HTTP/3 Listener ---
+    // Serves the same routes over QUIC on UDP 8443 when started with
+    // -http3 <cert.pem> <key.pem> (a self-signed pair is fine on localhost).
+    std::unique_ptr<Haka::Http3Listener> http3;
+    for (int i = 1; i + 2 < argc; ++i) {
+        if (std::string(argv[i]) == "-http3") {
+            Haka::Http3Config http3_config;
+            http3_config.cert_file = argv[i + 1];
+            http3_config.key_file = argv[i + 2];
+            http3 = std::make_unique<Haka::Http3Listener>(server, host, http3_config);
+            http3->start();
+        }
+    }
+#endif
 
 
     // --- Start the Server ---
     // This call is blocking and will run the server until interrupted (e.g., Ctrl+C).
+    // Stop cleanly on Ctrl+C / SIGTERM so destructors run (and PGO-instrumented
+    // builds get to write their profiles).
+    // /healthz reports draining first and requests keep being served for a
+    // few probe intervals, so load balancers take the instance out before it
+    // stops. A second signal stops at once.
+    constexpr auto drain_period = std::chrono::seconds(5);
+    asio::signal_set signals(server.get_io_context(), SIGINT, SIGTERM);
+    asio::steady_timer drain_timer(server.get_io_context());
+    std::function<void(const asio::error_code&, int)> on_signal;
+    on_signal = [&](const asio::error_code& ec, int signal_number) {
+        if (ec) return;
+        if (server.health_state() == Haka::HealthState::Draining) {
+            Haka::log_message("INFO", fmt::format("Received signal {} while draining, stopping now.", signal_number));
+            server.stop();
+            return;
+        }
+        Haka::log_message("INFO", fmt::format("Received signal {}, draining for {}s before stopping.", signal_number, drain_period.count()));
+        server.set_health(Haka::HealthState::Draining);
+        drain_timer.expires_after(drain_period);
+        drain_timer.async_wait([&server](const asio::error_code& ec) {
+            if (!ec) server.stop();
+        });
+        signals.async_wait(on_signal);
+    };
+    signals.async_wait(on_signal);
+
     try {
         fmt::print(fg(fmt::color::cyan), "Starting Haka server...\n");
         server.run();
@@ -0,0 +1,109 @@
+// Regression test for request-body backpressure: uploads whose bodies were
+// reserved up front, and whose reservations together sit between the memory
+// budget's high watermark and its limit, must still be read to completion.
+// Pausing their reads under pressure would hold the reservations forever.
+
+#include "Haka.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+constexpr unsigned short kPort = 18412;
+constexpr std::size_t kLimit = 16 * 1024 * 1024;       // High watermark at 14.4 MiB
+constexpr std::size_t kBodySize = 1000 * 1024;          // Below large_reservation
+constexpr std::size_t kUploads = 15;                    // 14.6 MiB reserved in total
+constexpr std::size_t kFirstChunk = 4096;
+
+int fail(const std::string& message) {
+    std::fprintf(stderr, "FAIL: %s\n", message.c_str());
+    std::fflush(stderr);
+    std::_Exit(1);
+}
+
+// Waits until `condition` holds, failing the test after `seconds`.
+template <typename Condition>
+void wait_for(Condition condition, int seconds, const std::string& what) {
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(seconds);
+    while (!condition()) {
+        if (std::chrono::steady_clock::now() > deadline) fail("timed out waiting for " + what);
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+}
+
+} // namespace
+
+int main() {
+    Haka::ServerConfig config;
+    config.handler_threads = 2;
+    config.memory.limit = kLimit;
+    Haka::Server server("127.0.0.1", kPort, config);
+    server.Post("/upload", [](const Haka::Request& req, Haka::Response& res) {
+        res.Text(std::to_string(req.body.size()));
+    });
+    std::thread server_thread([&server] { server.run(); });
+
+    // A stalled server never answers; don't hang the test run.
+    std::thread watchdog([] {
+        std::this_thread::sleep_for(std::chrono::seconds(60));
+        fail("uploads did not complete (reads stalled under memory pressure?)");
+    });
+    watchdog.detach();
+
+    Haka::MemoryBudget& budget = Haka::memory_budget();
+    std::size_t baseline = budget.used();
+    std::string body(kBodySize, 'x');
+    std::string head = "POST /upload HTTP/1.1\r\nHost: localhost\r\nContent-Length: " +
+                       std::to_string(kBodySize) + "\r\n\r\n";
+
+    // Open each upload and let the server reserve its body before the next
+    // one, so every head is read while the budget is still below the watermark.
+    asio::io_context io;
+    std::vector<asio::ip::tcp::socket> sockets;
+    for (std::size_t i = 0; i < kUploads; ++i) {
+        asio::ip::tcp::socket& socket = sockets.emplace_back(io);
+        asio::error_code ec;
+        wait_for([&] {
+            socket.close();
+            socket.connect({asio::ip::make_address("127.0.0.1"), kPort}, ec);
+            return !ec;
+        }, 10, "the server to accept connections");
+        asio::write(socket, asio::buffer(head + body.substr(0, kFirstChunk)));
+        std::size_t reserved = baseline + (i + 1) * kBodySize;
+        wait_for([&] { return budget.used() >= reserved; }, 10, "upload " + std::to_string(i) + " to be reserved");
+    }
+
+    if (!budget.under_pressure()) fail("reservations did not cross the high watermark");
+    if (budget.used() > budget.limit()) fail("reservations exceeded the limit");
+
+    for (auto& socket : sockets) {
+        asio::write(socket, asio::buffer(body.data() + kFirstChunk, kBodySize - kFirstChunk));
+    }
+
+    std::string expected = std::to_string(kBodySize);
+    for (auto& socket : sockets) {
+        std::string response;
+        asio::error_code ec;
+        std::array<char, 1024> buffer;
+        while (response.find(expected) == std::string::npos) {
+            std::size_t n = socket.read_some(asio::buffer(buffer), ec);
+            if (ec) fail("connection closed before a response: " + ec.message());
+            response.append(buffer.data(), n);
+        }
+        if (response.rfind("HTTP/1.1 200", 0) != 0) fail("unexpected response: " + response.substr(0, 64));
+    }
+    sockets.clear();
+
+    // Completed uploads return their reservations.
+    wait_for([&] { return !budget.under_pressure(); }, 10, "the budget to leave pressure");
+
+    server.stop();
+    server_thread.join();
+    std::printf("PASS: %zu reserved uploads completed under memory pressure\n", kUploads);
+    return 0;
+}
@@ -0,0 +1,152 @@
+// Cross-process tests for Haka::SharedCache: entries written by one process
+// are read by another, eviction keeps the table bounded, and neither a
+// creator nor a writer that dies holding a lock wedges the segment.
+
+#include "Haka.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace {
+
+using Cache = Haka::SharedCache<std::string, std::string, 32, 64>;
+
+const std::string kName = "/haka-shared-cache-test-" + std::to_string(::getpid());
+constexpr std::size_t kCapacity = 256;
+
+int fail(const std::string& message) {
+    std::fprintf(stderr, "FAIL: %s\n", message.c_str());
+    Cache::unlink(kName);
+    std::exit(1);
+}
+
+std::string key(int i) { return "key-" + std::to_string(i); }
+std::string value(int i) { return "value-" + std::to_string(i); }
+
+// Runs `body` in a child process; returns its exit status.
+template <typename Body>
+int in_child(Body body) {
+    pid_t pid = ::fork();
+    if (pid < 0) fail("fork failed");
+    if (pid == 0) {
+        int code = 1;
+        try {
+            code = body();
+        } catch (const std::exception& e) {
+            std::fprintf(stderr, "child: %s\n", e.what());
+        }
+        std::_Exit(code);
+    }
+    int status = 0;
+    ::waitpid(pid, &status, 0);
+    return WIFEXITED(status) ? WEXITSTATUS(status) : 128;
+}
+
+// A creator that dies after shm_open, holding the init lock, must not
+// keep later processes from opening the cache.
+void test_dead_creator() {
+    Cache::unlink(kName);
+    in_child([] {
+        int fd = ::shm_open(kName.c_str(), O_RDWR | O_CREAT, 0600);
+        if (fd < 0 || ::flock(fd, LOCK_EX) != 0) return 1;
+        ::raise(SIGKILL);
+        return 1;
+    });
+    Cache cache(kName, kCapacity);
+    if (!cache.put("after", "rebuild") || cache.get("after").value_or("") != "rebuild") {
+        fail("cache left by a dead creator is unusable");
+    }
+}
+
+// Entries written by one process are visible to another, both ways.
+void test_two_processes() {
+    Cache cache(kName, kCapacity);
+    int status = in_child([] {
+        Cache child(kName, kCapacity);
+        for (int i = 0; i < 100; ++i) {
+            if (!child.put(key(i), value(i))) return 2;
+        }
+        return 0;
+    });
+    if (status != 0) fail("child put failed");
+    for (int i = 0; i < 100; ++i) {
+        if (cache.get(key(i)).value_or("") != value(i)) fail("parent misses " + key(i) + " written by the child");
+    }
+
+    cache.put("from-parent", "hello");
+    cache.erase(key(0));
+    status = in_child([] {
+        Cache child(kName, kCapacity);
+        if (child.get("from-parent").value_or("") != "hello") return 2;
+        if (child.get(key(0))) return 3;
+        return 0;
+    });
+    if (status != 0) fail("child did not see the parent's put/erase (status " + std::to_string(status) + ")");
+}
+
+// Writing far more keys than slots evicts, and recent keys survive.
+void test_eviction() {
+    Cache cache(kName, kCapacity);
+    int status = in_child([] {
+        Cache child(kName, kCapacity);
+        for (int i = 0; i < 4000; ++i) {
+            if (!child.put(key(i), value(i))) return 2;
+        }
+        return 0;
+    });
+    if (status != 0) fail("child put failed during eviction");
+    if (cache.stats().evictions == 0) fail("no evictions after overfilling the cache");
+    std::size_t found = 0;
+    for (int i = 0; i < 4000; ++i) {
+        if (auto v = cache.get(key(i))) {
+            if (*v != value(i)) fail("wrong value for " + key(i));
+            ++found;
+        }
+    }
+    if (found == 0 || found > cache.capacity()) fail("unexpected number of surviving entries: " + std::to_string(found));
+    if (cache.get(key(3999)).value_or("") != value(3999)) fail("most recent key was evicted");
+}
+
+// Writers killed at random points, some of them holding slot locks, must
+// not leave slots that later puts can never take.
+void test_killed_writers() {
+    Cache cache(kName, kCapacity);
+    for (int round = 0; round < 40; ++round) {
+        pid_t pid = ::fork();
+        if (pid < 0) fail("fork failed");
+        if (pid == 0) {
+            Cache child(kName, kCapacity);
+            for (int i = 0;; i = (i + 1) % 64) child.put(key(i), value(i));
+        }
+        std::this_thread::sleep_for(std::chrono::microseconds(2000 + 500 * (round % 7)));
+        ::kill(pid, SIGKILL);
+        ::waitpid(pid, nullptr, 0);
+    }
+    for (int i = 0; i < 64; ++i) {
+        if (!cache.put(key(i), value(i))) fail("put of " + key(i) + " failed after killed writers");
+        if (cache.get(key(i)).value_or("") != value(i)) fail("get of " + key(i) + " failed after killed writers");
+    }
+    std::printf("killed writers: %llu locks recovered\n", static_cast<unsigned long long>(cache.stats().recovered));
+}
+
+} // namespace
+
+int main() {
+    test_dead_creator();
+    test_two_processes();
+    test_eviction();
+    test_killed_writers();
+    Cache::unlink(kName);
+    std::printf("PASS: shared cache works across processes\n");
+    return 0;
+}
@@ -0,0 +1,233 @@
+// haka_dict: trains a zstd dictionary for a route's responses (see
+// Haka::ZstdDictionary) and reports how much it saves.
+//
+// Samples are captured responses: one per file, files in directories, or
+// one per line with --lines (e.g., a JSONL log of bodies). --capture fetches
+// them from a running server instead:
+//
+//   haka_dict --capture 127.0.0.1:8080/json --count 2000 -o json.dict
+//   haka_dict --lines responses.jsonl -o products.dict --size 16384
+//
+// The output is a raw-content dictionary, which is what dcz (RFC 9842)
+// uses: zstd's training header is stripped, only the content is kept.
+// Every tenth sample is held out of training. Those are then compressed with
+// gzip (when built with zlib), plain zstd and zstd with the dictionary
+// (including dcz's 40-byte header), and the totals are printed.
+
+#define ASIO_STANDALONE
+#include <asio.hpp>
+
+#define FMT_HEADER_ONLY
+#include <fmt/core.h>
+
+#include <zdict.h>
+#include <zstd.h>
+
+#if defined(HAKA_ENABLE_ZLIB)
+#include <zlib.h>
+#endif
+
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+namespace {
+
+struct Options {
+    std::vector<std::string> inputs;  // Sample files or directories
+    bool lines = false;               // One sample per line
+    std::string capture;              // host:port/path to fetch samples from
+    int count = 1000;                 // Samples to capture
+    std::string output = "haka.dict";
+    std::size_t size = 16 * 1024;     // Dictionary size
+    int level = 3;                    // zstd level for the evaluation
+};
+
+bool parse_args(int argc, char* argv[], Options& opts) {
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        auto next = [&]() -> std::string { return i + 1 < argc ? argv[++i] : std::string(); };
+        if (arg == "--lines") opts.lines = true;
+        else if (arg == "--capture") opts.capture = next();
+        else if (arg == "--count") opts.count = std::max(1, std::stoi(next()));
+        else if (arg == "-o" || arg == "--output") opts.output = next();
+        else if (arg == "--size") opts.size = static_cast<std::size_t>(std::stoul(next()));
+        else if (arg == "--level") opts.level = std::stoi(next());
+        else if (!arg.empty() && arg[0] == '-') {
+            fmt::print(stderr, "Unknown argument: {}\n", arg);
+            return false;
+        } else {
+            opts.inputs.push_back(arg);
+        }
+    }
+    if (opts.inputs.empty() && opts.capture.empty()) {
+        fmt::print(stderr, "usage: haka_dict [--lines] <files or dirs>... | --capture host:port/path [--count N]\n"
+                           "                 [-o out.dict] [--size bytes] [--level n]\n");
+        return false;
+    }
+    return true;
+}
+
+void add_file(const std::filesystem::path& path, bool lines, std::vector<std::string>& samples) {
+    std::ifstream file(path, std::ios::binary);
+    if (!lines) {
+        samples.emplace_back(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+        return;
+    }
+    std::string line;
+    while (std::getline(file, line)) {
+        if (!line.empty()) samples.push_back(std::move(line));
+    }
+}
+
+// GETs host:port/path once (the server closes the connection) and returns the body.
+bool fetch(const std::string& target, std::string& body) {
+    std::size_t colon = target.find(':');
+    std::size_t slash = target.find('/', colon == std::string::npos ? 0 : colon);
+    if (colon == std::string::npos || slash == std::string::npos) return false;
+    std::string host = target.substr(0, colon);
+    std::string port = target.substr(colon + 1, slash - colon - 1);
+    std::string path = target.substr(slash);
+
+    asio::io_context io;
+    asio::ip::tcp::socket socket(io);
+    asio::error_code ec;
+    asio::connect(socket, asio::ip::tcp::resolver(io).resolve(host, port, ec), ec);
+    if (ec) return false;
+    std::string request = "GET " + path + " HTTP/1.1\r\nHost: " + host + "\r\nConnection: close\r\n\r\n";
+    asio::write(socket, asio::buffer(request), ec);
+    if (ec) return false;
+    std::string response;
+    char chunk[16384];
+    for (;;) {
+        std::size_t n = socket.read_some(asio::buffer(chunk), ec);
+        response.append(chunk, n);
+        if (ec) break;
+    }
+    std::size_t header_end = response.find("\r\n\r\n");
+    if (header_end == std::string::npos || response.compare(0, 12, "HTTP/1.1 200") != 0) return false;
+    body = response.substr(header_end + 4);
+    return true;
+}
+
+#if defined(HAKA_ENABLE_ZLIB)
+std::size_t gzip_size(const std::string& data) {
+    z_stream z{};
+    deflateInit2(&z, 6, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY);
+    std::string out(deflateBound(&z, static_cast<uLong>(data.size())), '\0');
+    z.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data.data()));
+    z.avail_in = static_cast<uInt>(data.size());
+    z.next_out = reinterpret_cast<Bytef*>(out.data());
+    z.avail_out = static_cast<uInt>(out.size());
+    deflate(&z, Z_FINISH);
+    std::size_t size = z.total_out;
+    deflateEnd(&z);
+    return size;
+}
+#endif
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    Options opts;
+    if (!parse_args(argc, argv, opts)) return 2;
+
+    std::vector<std::string> samples;
+    for (const auto& input : opts.inputs) {
+        if (std::filesystem::is_directory(input)) {
+            for (const auto& entry : std::filesystem::recursive_directory_iterator(input)) {
+                if (entry.is_regular_file()) add_file(entry.path(), opts.lines, samples);
+            }
+        } else {
+            add_file(input, opts.lines, samples);
+        }
+    }
+    if (!opts.capture.empty()) {
+        int failures = 0;
+        for (int i = 0; i < opts.count; ++i) {
+            std::string body;
+            if (fetch(opts.capture, body)) samples.push_back(std::move(body));
+            else ++failures;
+        }
+        fmt::print("Captured {} responses from {} ({} failed)\n", opts.count - failures, opts.capture, failures);
+    }
+    samples.erase(std::remove_if(samples.begin(), samples.end(), [](const std::string& s) { return s.empty(); }), samples.end());
+    if (samples.size() < 10) {
+        fmt::print(stderr, "Need at least 10 samples (ideally hundreds), got {}\n", samples.size());
+        return 1;
+    }
+
+    std::string joined;
+    std::vector<std::size_t> sizes;
+    std::vector<const std::string*> held_out;
+    for (std::size_t i = 0; i < samples.size(); ++i) {
+        if (i % 10 == 9) {
+            held_out.push_back(&samples[i]);
+            continue;
+        }
+        joined += samples[i];
+        sizes.push_back(samples[i].size());
+    }
+    std::string dictionary(opts.size, '\0');
+    auto start = std::chrono::steady_clock::now();
+    std::size_t trained = ZDICT_trainFromBuffer(dictionary.data(), dictionary.size(), joined.data(), sizes.data(),
+                                                static_cast<unsigned>(sizes.size()));
+    if (ZDICT_isError(trained)) {
+        fmt::print(stderr, "Training failed: {}\n", ZDICT_getErrorName(trained));
+        return 1;
+    }
+    dictionary.resize(trained);
+    // Keep only the content; dcz loads dictionaries as raw content.
+    std::size_t header = ZDICT_getDictHeaderSize(dictionary.data(), dictionary.size());
+    if (!ZDICT_isError(header)) dictionary.erase(0, header);
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::ofstream out(opts.output, std::ios::binary);
+    out.write(dictionary.data(), static_cast<std::streamsize>(dictionary.size()));
+    if (!out) {
+        fmt::print(stderr, "Cannot write {}\n", opts.output);
+        return 1;
+    }
+    fmt::print("Trained {} byte dictionary from {} samples ({} bytes) in {:.2f}s -> {}\n", dictionary.size(), sizes.size(),
+               joined.size(), seconds, opts.output);
+
+    // Evaluate exactly as the server compresses: raw-content CDict, reused context.
+    ZSTD_CCtx* context = ZSTD_createCCtx();
+    ZSTD_CDict* cdict = ZSTD_createCDict(dictionary.data(), dictionary.size(), opts.level);
+    std::size_t total = 0, plain = 0, with_dictionary = 0, gzip = 0;
+    std::string buffer;
+    for (const std::string* held : held_out) {
+        const std::string& sample = *held;
+        buffer.resize(ZSTD_compressBound(sample.size()));
+        total += sample.size();
+        plain += ZSTD_compressCCtx(context, buffer.data(), buffer.size(), sample.data(), sample.size(), opts.level);
+        with_dictionary += 40 + ZSTD_compress_usingCDict(context, buffer.data(), buffer.size(), sample.data(), sample.size(), cdict);
+#if defined(HAKA_ENABLE_ZLIB)
+        gzip += gzip_size(sample);
+#endif
+    }
+    ZSTD_freeCDict(cdict);
+    ZSTD_freeCCtx(context);
+
+    auto row = [&](const char* name, std::size_t bytes) {
+        fmt::print("  {:<16} {:>10} bytes  {:>6.1f}% of original  {:>8.1f} bytes/response\n", name, bytes, 100.0 * bytes / total,
+                   static_cast<double>(bytes) / held_out.size());
+    };
+    fmt::print("Evaluation on {} held-out samples (level {}):\n", held_out.size(), opts.level);
+    row("original", total);
+#if defined(HAKA_ENABLE_ZLIB)
+    row("gzip -6", gzip);
+#endif
+    row("zstd", plain);
+    row("zstd + dict (dcz)", with_dictionary);
+#if defined(HAKA_ENABLE_ZLIB)
+    fmt::print("  dcz is {:.1f}x smaller than gzip\n", static_cast<double>(gzip) / with_dictionary);
+#else
+    (void)gzip;
+#endif
+    return 0;
+}
@@ -0,0 +1,307 @@
+// haka_load: a small closed-loop HTTP load driver for Haka.
+//
+// Drives a fixed, representative request mix (text/HTML/JSON routes, static
+// files, 404s) from several concurrent connections and reports throughput
+// and latency. Used as the training workload and benchmark of the PGO build
+// (see cmake/HakaPGO.cmake), but also handy on its own:
+//
+//   haka_load --port 8080 --connections 16 --duration 10
+//
+// --keep-alive asks for persistent connections and reuses them when the
+// server agrees. Haka currently closes every connection after its response,
+// so against Haka it behaves exactly like the default.
+//
+// With --spawn it starts the server itself, waits for it to accept
+// connections, and stops it with SIGINT afterwards so an instrumented
+// binary gets to write its profile on exit.
+
+#define ASIO_STANDALONE
+#include <asio.hpp>
+
+#define FMT_HEADER_ONLY
+#include <fmt/core.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if !defined(_WIN32)
+#include <csignal>
+#include <fcntl.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+struct Options {
+    std::string host = "127.0.0.1";
+    unsigned short port = 8080;
+    int connections = 16;
+    int duration_seconds = 10;
+    bool keep_alive = false;
+    std::string spawn;               // Server binary to start, if any
+    std::vector<std::string> spawn_args;
+    std::string spawn_cwd;
+    std::string report;              // File to append a result line to
+    std::string label = "run";
+};
+
+// The request mix, weighted roughly like the traffic we see: mostly small
+// API calls, some static assets, and a steady trickle of 404s.
+struct Target {
+    const char* method;
+    const char* path;
+    int weight;
+};
+
+constexpr Target kTargets[] = {
+    {"GET", "/", 3},
+    {"GET", "/hello", 2},
+    {"GET", "/status", 4},
+    {"GET", "/json", 6},
+    {"GET", "/product/1", 2},
+    {"GET", "/api/users/list", 3},
+    {"GET", "/api/users/profile", 2},
+    {"GET", "/static/index.html", 3},
+    {"GET", "/static/css/style.css", 2},
+    {"GET", "/static/js/script.js", 2},
+    {"GET", "/does-not-exist", 2},
+    {"GET", "/static/missing.png", 1},
+};
+
+struct WorkerResult {
+    std::uint64_t requests = 0;
+    std::uint64_t errors = 0;
+    std::vector<std::uint32_t> latencies_us;
+};
+
+bool parse_args(int argc, char* argv[], Options& opts) {
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        auto next = [&]() -> std::string { return i + 1 < argc ? argv[++i] : std::string(); };
+        if (arg == "--host") opts.host = next();
+        else if (arg == "--port") opts.port = static_cast<unsigned short>(std::stoi(next()));
+        else if (arg == "--connections") opts.connections = std::max(1, std::stoi(next()));
+        else if (arg == "--duration") opts.duration_seconds = std::max(1, std::stoi(next()));
+        else if (arg == "--keep-alive") opts.keep_alive = true;
+        else if (arg == "--spawn") opts.spawn = next();
+        else if (arg == "--spawn-arg") opts.spawn_args.push_back(next());
+        else if (arg == "--cwd") opts.spawn_cwd = next();
+        else if (arg == "--report") opts.report = next();
+        else if (arg == "--label") opts.label = next();
+        else {
+            fmt::print(stderr, "Unknown argument: {}\n", arg);
+            return false;
+        }
+    }
+    return true;
+}
+
+// Reads one response (headers + Content-Length body). Returns false if the
+// connection failed or was closed before a full response arrived.
+bool read_response(asio::ip::tcp::socket& socket, std::string& buffer, bool& server_closes) {
+    asio::error_code ec;
+    std::size_t header_end;
+    while ((header_end = buffer.find("\r\n\r\n")) == std::string::npos) {
+        char chunk[16384];
+        std::size_t n = socket.read_some(asio::buffer(chunk), ec);
+        if (ec) return false;
+        buffer.append(chunk, n);
+    }
+
+    std::size_t content_length = 0;
+    std::size_t pos = buffer.find("Content-Length:");
+    if (pos != std::string::npos && pos < header_end) {
+        content_length = std::stoul(buffer.substr(pos + 15));
+    }
+    server_closes = buffer.find("Connection: keep-alive") == std::string::npos ||
+                    buffer.find("Connection: keep-alive") > header_end;
+
+    std::size_t total = header_end + 4 + content_length;
+    while (buffer.size() < total) {
+        char chunk[16384];
+        std::size_t n = socket.read_some(asio::buffer(chunk), ec);
+        if (ec) return false;
+        buffer.append(chunk, n);
+    }
+    buffer.erase(0, total);
+    return true;
+}
+
+void run_worker(const Options& opts, int worker_index, std::chrono::steady_clock::time_point end, WorkerResult& result) {
+    asio::io_context io;
+    asio::ip::tcp::endpoint endpoint(asio::ip::make_address(opts.host), opts.port);
+    asio::ip::tcp::socket socket(io);
+
+    std::vector<const Target*> schedule;
+    for (const auto& target : kTargets) {
+        for (int w = 0; w < target.weight; ++w) schedule.push_back(&target);
+    }
+    // Each worker starts at a different offset so the mix is spread over time.
+    std::size_t next_target = static_cast<std::size_t>(worker_index) * 7 % schedule.size();
+
+    std::string buffer;
+    bool connected = false;
+    while (std::chrono::steady_clock::now() < end) {
+        const Target& target = *schedule[next_target];
+        next_target = (next_target + 1) % schedule.size();
+
+        auto start = std::chrono::steady_clock::now();
+        asio::error_code ec;
+        if (!connected) {
+            socket = asio::ip::tcp::socket(io);
+            socket.connect(endpoint, ec);
+            if (ec) {
+                ++result.errors;
+                std::this_thread::sleep_for(std::chrono::milliseconds(10));
+                continue;
+            }
+            connected = true;
+            buffer.clear();
+        }
+
+        std::string request = fmt::format("{} {} HTTP/1.1\r\nHost: {}:{}\r\nUser-Agent: haka_load\r\nConnection: {}\r\n\r\n",
+                                          target.method, target.path, opts.host, opts.port,
+                                          opts.keep_alive ? "keep-alive" : "close");
+        asio::write(socket, asio::buffer(request), ec);
+
+        bool server_closes = true;
+        if (ec || !read_response(socket, buffer, server_closes)) {
+            ++result.errors;
+            connected = false;
+            continue;
+        }
+        if (!opts.keep_alive || server_closes) {
+            socket.close(ec);
+            connected = false;
+        }
+
+        ++result.requests;
+        result.latencies_us.push_back(static_cast<std::uint32_t>(
+            std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count()));
+    }
+}
+
+#if !defined(_WIN32)
+pid_t spawn_server(const Options& opts) {
+    pid_t pid = ::fork();
+    if (pid == 0) {
+        if (!opts.spawn_cwd.empty() && ::chdir(opts.spawn_cwd.c_str()) != 0) _exit(127);
+        int devnull = ::open("/dev/null", O_WRONLY);
+        if (devnull >= 0) {
+            ::dup2(devnull, STDOUT_FILENO);
+            ::dup2(devnull, STDERR_FILENO);
+        }
+        std::vector<char*> argv;
+        argv.push_back(const_cast<char*>(opts.spawn.c_str()));
+        for (const auto& arg : opts.spawn_args) argv.push_back(const_cast<char*>(arg.c_str()));
+        argv.push_back(nullptr);
+        ::execv(opts.spawn.c_str(), argv.data());
+        _exit(127);
+    }
+    return pid;
+}
+
+void stop_server(pid_t pid) {
+    ::kill(pid, SIGINT);
+    for (int i = 0; i < 100; ++i) {
+        int status = 0;
+        if (::waitpid(pid, &status, WNOHANG) == pid) return;
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    }
+    fmt::print(stderr, "Server did not exit after SIGINT; killing it (profile data may be lost)\n");
+    ::kill(pid, SIGKILL);
+    ::waitpid(pid, nullptr, 0);
+}
+#endif
+
+bool wait_for_server(const Options& opts) {
+    asio::io_context io;
+    asio::ip::tcp::endpoint endpoint(asio::ip::make_address(opts.host), opts.port);
+    for (int i = 0; i < 200; ++i) {
+        asio::ip::tcp::socket probe(io);
+        asio::error_code ec;
+        probe.connect(endpoint, ec);
+        if (!ec) return true;
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    }
+    return false;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    Options opts;
+    if (!parse_args(argc, argv, opts)) return 2;
+
+#if !defined(_WIN32)
+    pid_t server_pid = -1;
+    if (!opts.spawn.empty()) {
+        server_pid = spawn_server(opts);
+        if (server_pid < 0) {
+            fmt::print(stderr, "Failed to start {}\n", opts.spawn);
+            return 1;
+        }
+    }
+#else
+    if (!opts.spawn.empty()) {
+        fmt::print(stderr, "--spawn is not supported on Windows; start the server yourself\n");
+        return 2;
+    }
+#endif
+
+    if (!wait_for_server(opts)) {
+        fmt::print(stderr, "Server at {}:{} is not accepting connections\n", opts.host, opts.port);
+#if !defined(_WIN32)
+        if (server_pid > 0) stop_server(server_pid);
+#endif
+        return 1;
+    }
+
+    fmt::print("[{}] {} connections for {}s against {}:{} ({})\n", opts.label, opts.connections, opts.duration_seconds,
+               opts.host, opts.port, opts.keep_alive ? "keep-alive" : "close");
+
+    auto start = std::chrono::steady_clock::now();
+    auto end = start + std::chrono::seconds(opts.duration_seconds);
+    std::vector<WorkerResult> results(static_cast<std::size_t>(opts.connections));
+    std::vector<std::thread> workers;
+    for (int i = 0; i < opts.connections; ++i) {
+        workers.emplace_back(run_worker, std::cref(opts), i, end, std::ref(results[static_cast<std::size_t>(i)]));
+    }
+    for (auto& worker : workers) worker.join();
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+#if !defined(_WIN32)
+    if (server_pid > 0) stop_server(server_pid);
+#endif
+
+    std::uint64_t requests = 0;
+    std::uint64_t errors = 0;
+    std::vector<std::uint32_t> latencies;
+    for (auto& r : results) {
+        requests += r.requests;
+        errors += r.errors;
+        latencies.insert(latencies.end(), r.latencies_us.begin(), r.latencies_us.end());
+    }
+    std::sort(latencies.begin(), latencies.end());
+    auto percentile = [&](double p) -> std::uint32_t {
+        if (latencies.empty()) return 0;
+        return latencies[std::min(latencies.size() - 1, static_cast<std::size_t>(p * static_cast<double>(latencies.size())))];
+    };
+    double rps = static_cast<double>(requests) / elapsed;
+
+    std::string line = fmt::format("label={} requests={} errors={} seconds={:.2f} rps={:.0f} p50_us={} p99_us={}",
+                                   opts.label, requests, errors, elapsed, rps, percentile(0.50), percentile(0.99));
+    fmt::print("{}\n", line);
+    if (!opts.report.empty()) {
+        std::ofstream report(opts.report, std::ios::app);
+        report << line << "\n";
+    }
+    return requests > 0 ? 0 : 1;
+}